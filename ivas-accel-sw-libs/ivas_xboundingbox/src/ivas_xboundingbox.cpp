@@ -131,7 +131,7 @@ overlay_node_foreach (GNode * node, gpointer kpriv_ptr)
 {
   ivas_xoverlaypriv *kpriv = (ivas_xoverlaypriv *) kpriv_ptr;
   struct overlayframe_info *frameinfo = &(kpriv->frameinfo);
-  LOG_MESSAGE (LOG_LEVEL_DEBUG, "enter");
+  LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level, "enter");
 
   GList *classes;
   GstInferenceClassification *classification;
@@ -178,7 +178,7 @@ overlay_node_foreach (GNode * node, gpointer kpriv_ptr)
       }
     }
 
-    LOG_MESSAGE (LOG_LEVEL_INFO,
+    LOG_MESSAGE (LOG_LEVEL_INFO, log_level,
         "RESULT: (prediction node %ld) %s(%d) %d %d %d %d (%f)",
         prediction->prediction_id,
         label_present ? classification->class_label : NULL,
@@ -189,7 +189,8 @@ overlay_node_foreach (GNode * node, gpointer kpriv_ptr)
 
     /* Check whether the frame is NV12 or BGR and act accordingly */
     if (frameinfo->inframe->props.fmt == IVAS_VFMT_Y_UV8_420) {
-      LOG_MESSAGE (LOG_LEVEL_DEBUG, "Drawing rectangle for NV12 image");
+      LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+          "Drawing rectangle for NV12 image");
       unsigned char yScalar;
       unsigned short uvScalar;
       convert_rgb_to_yuv_clrs (clr, &yScalar, &uvScalar);
@@ -232,7 +233,8 @@ overlay_node_foreach (GNode * node, gpointer kpriv_ptr)
             kpriv->font_size / 2, Scalar (uvScalar), 1, 1);
       }
     } else if (frameinfo->inframe->props.fmt == IVAS_VFMT_BGR8) {
-      LOG_MESSAGE (LOG_LEVEL_DEBUG, "Drawing rectangle for BGR image");
+      LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+          "Drawing rectangle for BGR image");
 
       if (!(!prediction->bbox.x && !prediction->bbox.y)) {
         /* Draw rectangle over the dectected object */
@@ -268,7 +270,7 @@ extern "C"
 {
   int32_t xlnx_kernel_init (IVASKernel * handle)
   {
-    LOG_MESSAGE (LOG_LEVEL_DEBUG, "enter");
+    LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level, "enter");
 
     ivas_xoverlaypriv *kpriv =
         (ivas_xoverlaypriv *) calloc (1, sizeof (ivas_xoverlaypriv));
@@ -323,7 +325,7 @@ extern "C"
       karray = json_object_get (jconfig, "label_color");
     if (!karray)
     {
-      LOG_MESSAGE (LOG_LEVEL_ERROR, "failed to find label_color");
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "failed to find label_color");
       return -1;
     } else
     {
@@ -338,7 +340,8 @@ extern "C"
     karray = json_object_get (jconfig, "label_filter");
 
     if (!json_is_array (karray)) {
-      LOG_MESSAGE (LOG_LEVEL_ERROR, "label_filter not found in the config\n");
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+          "label_filter not found in the config\n");
       return -1;
     }
     kpriv->label_filter_cnt = 0;
@@ -351,30 +354,32 @@ extern "C"
     /* get classes array */
     karray = json_object_get (jconfig, "classes");
     if (!karray) {
-      LOG_MESSAGE (LOG_LEVEL_ERROR, "failed to find key labels");
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "failed to find key labels");
       return -1;
     }
 
     if (!json_is_array (karray)) {
-      LOG_MESSAGE (LOG_LEVEL_ERROR, "labels key is not of array type");
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+          "labels key is not of array type");
       return -1;
     }
     kpriv->classes_count = json_array_size (karray);
     for (unsigned int index = 0; index < kpriv->classes_count; index++) {
       classes = json_array_get (karray, index);
       if (!classes) {
-        LOG_MESSAGE (LOG_LEVEL_ERROR, "failed to get class object");
+        LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "failed to get class object");
         return -1;
       }
 
       val = json_object_get (classes, "name");
       if (!json_is_string (val)) {
-        LOG_MESSAGE (LOG_LEVEL_ERROR, "name is not found for array %d", index);
+        LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+            "name is not found for array %d", index);
         return -1;
       } else {
         strncpy (kpriv->class_list[index].class_name,
             (char *) json_string_value (val), MAX_CLASS_LEN - 1);
-        LOG_MESSAGE (LOG_LEVEL_DEBUG, "name %s",
+        LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level, "name %s",
             kpriv->class_list[index].class_name);
       }
 
@@ -403,7 +408,7 @@ extern "C"
 
   uint32_t xlnx_kernel_deinit (IVASKernel * handle)
   {
-    LOG_MESSAGE (LOG_LEVEL_DEBUG, "enter");
+    LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level, "enter");
     ivas_xoverlaypriv *kpriv = (ivas_xoverlaypriv *) handle->kernel_priv;
 
     if (kpriv)
@@ -416,7 +421,7 @@ extern "C"
   uint32_t xlnx_kernel_start (IVASKernel * handle, int start,
       IVASFrame * input[MAX_NUM_OBJECT], IVASFrame * output[MAX_NUM_OBJECT])
   {
-    LOG_MESSAGE (LOG_LEVEL_DEBUG, "enter");
+    LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level, "enter");
     GstInferenceMeta *infer_meta = NULL;
     char *pstr;
 
@@ -431,15 +436,16 @@ extern "C"
     infer_meta = ((GstInferenceMeta *) gst_buffer_get_meta ((GstBuffer *)
             frameinfo->inframe->app_priv, gst_inference_meta_api_get_type ()));
     if (infer_meta == NULL) {
-      LOG_MESSAGE (LOG_LEVEL_DEBUG,
+      LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
           "ivas meta data is not available for postdpu");
       return false;
     } else {
-      LOG_MESSAGE (LOG_LEVEL_DEBUG, "ivas_mata ptr %p", infer_meta);
+      LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level, "ivas_mata ptr %p", infer_meta);
     }
 
     if (frameinfo->inframe->props.fmt == IVAS_VFMT_Y_UV8_420) {
-      LOG_MESSAGE (LOG_LEVEL_DEBUG, "Input frame is in NV12 format\n");
+      LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+          "Input frame is in NV12 format\n");
       frameinfo->lumaImg.create (input[0]->props.height, input[0]->props.stride,
           CV_8UC1);
       frameinfo->lumaImg.data = (unsigned char *) lumaBuf;
@@ -447,19 +453,20 @@ extern "C"
           input[0]->props.stride / 2, CV_16UC1);
       frameinfo->chromaImg.data = (unsigned char *) chromaBuf;
     } else if (frameinfo->inframe->props.fmt == IVAS_VFMT_BGR8) {
-      LOG_MESSAGE (LOG_LEVEL_DEBUG, "Input frame is in BGR format\n");
+      LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+          "Input frame is in BGR format\n");
       frameinfo->image.create (input[0]->props.height,
           input[0]->props.stride / 3, CV_8UC3);
       frameinfo->image.data = (unsigned char *) indata;
     } else {
-      LOG_MESSAGE (LOG_LEVEL_WARNING, "Unsupported color format\n");
+      LOG_MESSAGE (LOG_LEVEL_WARNING, log_level, "Unsupported color format\n");
       return 0;
     }
 
 
     /* Print the entire prediction tree */
     pstr = gst_inference_prediction_to_string (infer_meta->prediction);
-    LOG_MESSAGE (LOG_LEVEL_DEBUG, "Prediction tree: \n%s", pstr);
+    LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level, "Prediction tree: \n%s", pstr);
     free (pstr);
 
     g_node_traverse (infer_meta->prediction->predictions, G_PRE_ORDER,
@@ -471,7 +478,7 @@ extern "C"
 
   int32_t xlnx_kernel_done (IVASKernel * handle)
   {
-    LOG_MESSAGE (LOG_LEVEL_DEBUG, "enter");
+    LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level, "enter");
     return 0;
   }
 }
@@ -17,32 +17,6 @@
 #ifndef __IVAS_XBOUNDINGBOX_H__
 #define __IVAS_XBOUNDINGBOX_H__
 
-enum
-{
-  LOG_LEVEL_ERROR,
-  LOG_LEVEL_WARNING,
-  LOG_LEVEL_INFO,
-  LOG_LEVEL_DEBUG
-};
-
-#define __FILENAME__ (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
-#define LOG_MESSAGE(level, ...) {\
-  do {\
-    char *str; \
-    if (level == LOG_LEVEL_ERROR)\
-      str = (char*)"ERROR";\
-    else if (level == LOG_LEVEL_WARNING)\
-      str = (char*)"WARNING";\
-    else if (level == LOG_LEVEL_INFO)\
-      str = (char*)"INFO";\
-    else if (level == LOG_LEVEL_DEBUG)\
-      str = (char*)"DEBUG";\
-    if (level <= log_level) {\
-      printf("[%s %s:%d] %s: ",__FILENAME__, __func__, __LINE__, str);\
-      printf(__VA_ARGS__);\
-      printf("\n");\
-    }\
-  } while (0); \
-}
+#include <ivas/ivaslogs.h>
 
 #endif /* __IVAS_XBOUNDINGBOX_H__  */
@@ -20,9 +20,11 @@
 
 #include "gstivasallocator.h"
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <string.h>
 #include <gst/allocators/gstdmabuf.h>
 #include <gst/gstpoll.h>
+#include <ivas/xrt_utils.h>
 
 #define GST_CAT_DEFAULT ivasallocator_debug
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
@@ -30,12 +32,16 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define GST_IVAS_MEMORY_TYPE "IVASMemory"
 #define DEFAULT_DEVICE_INDEX 0
 #define DEFAULT_NEED_DMA FALSE
+#define DEFAULT_MEM_BANK 0
+#define IVAS_MAX_DEVICES 32
+#define IVAS_MAX_MEM_BANKS 32
 
 enum
 {
   PROP_0,
   PROP_DEVICE_INDEX,
   PROP_NEED_DMA,
+  PROP_MEM_BANK,
 };
 
 enum
@@ -48,6 +54,7 @@ struct _GstIvasAllocatorPrivate
 {
   guint dev_idx;
   gboolean need_dma;
+  guint mem_bank;
   xclDeviceHandle handle;
   GstAllocator *dmabuf_alloc;
   gboolean active;
@@ -64,6 +71,8 @@ typedef struct _GstIvasMemory
   gpointer data;                /* used in non-dma mode */
   unsigned int bo;
   gsize size;
+  guint dev_idx;
+  guint mem_bank;
   GstIvasAllocator *alloc;
   GstMapFlags mmapping_flags;
   gint mmap_count;
@@ -71,6 +80,11 @@ typedef struct _GstIvasMemory
   gboolean do_free;
 #ifdef XLNX_PCIe_PLATFORM
   IvasSyncFlags sync_flags;
+  /* byte ranges within the BO, empty when start == end */
+  gsize dirty_start;            /* written by host, pending sync to device */
+  gsize dirty_end;
+  gsize valid_start;            /* already synced from device */
+  gsize valid_end;
 #endif
 } GstIvasMemory;
 
@@ -98,17 +112,34 @@ get_ivas_mem (GstMemory * mem)
   }
 }
 
+/* bytes allocated per device memory bank by all allocators in the process */
+static gsize bank_usage[IVAS_MAX_DEVICES][IVAS_MAX_MEM_BANKS];
+G_LOCK_DEFINE_STATIC (bank_usage);
+
+static gsize
+ivas_bank_usage_add (guint dev_idx, guint bank, gssize size)
+{
+  gsize usage = 0;
+
+  if (dev_idx >= IVAS_MAX_DEVICES || bank >= IVAS_MAX_MEM_BANKS)
+    return 0;
+
+  G_LOCK (bank_usage);
+  bank_usage[dev_idx][bank] += size;
+  usage = bank_usage[dev_idx][bank];
+  G_UNLOCK (bank_usage);
+
+  return usage;
+}
+
+/* allocators only allocate and map BOs, so all of them on a device share
+ * one handle instead of opening the device per pool */
 static xclDeviceHandle
 ivas_open_device (guint dev_idx)
 {
   xclDeviceHandle handle = NULL;
 
-  if (dev_idx >= xclProbe ()) {
-    GST_ERROR ("Cannot find device index specified\n");
-    return NULL;
-  }
-
-  handle = xclOpen (dev_idx, NULL, XCL_INFO);
+  handle = open_shared_xrt_device (dev_idx);
   if (handle == NULL) {
     GST_ERROR ("failed to open device with idx %d. reason : %s", dev_idx,
         strerror (errno));
@@ -137,57 +168,15 @@ ivas_allocator_memory_dispose (GstMiniObject * obj)
   return TRUE;
 }
 
+/* allocates the BO on the configured bank, without initializing it */
 static GstMemory *
-gst_ivas_allocator_alloc (GstAllocator * allocator, gsize size,
+ivas_allocator_new_memory (GstIvasAllocator * ivas_alloc, gsize size,
     GstAllocationParams * params)
 {
-  GstIvasAllocator *ivas_alloc = GST_IVAS_ALLOCATOR (allocator);
   GstIvasAllocatorPrivate *priv = ivas_alloc->priv;
   GstIvasMemory *ivasmem;
   GstMemory *mem;
   gint prime_fd = 0;
-  int iret = 0;
-  void* data = NULL;
-
-  if (priv->free_queue && g_atomic_int_get (&priv->active)) {
-    // TODO: peek memory and check size of popped mem is sufficient or not
-
-pop_now:
-    mem = gst_atomic_queue_pop (priv->free_queue);
-    if (G_LIKELY (mem)) {
-      while (!gst_poll_read_control (priv->poll)) {
-        if (errno == EWOULDBLOCK) {
-          /* We put the buffer into the queue but did not finish writing control
-           * yet, let's wait a bit and retry */
-          g_thread_yield ();
-          continue;
-        } else {
-          /* Critical error but GstPoll already complained */
-          break;
-        }
-      }
-      GST_LOG_OBJECT (ivas_alloc, "popped preallocated memory %p", mem);
-      return mem;
-    } else {
-      /* check we reached maximum buffers */
-      if (priv->max_mem && priv->cur_mem >= priv->max_mem) {
-        if (!gst_poll_read_control (priv->poll)) {
-          if (errno == EWOULDBLOCK) {
-            GST_LOG_OBJECT (ivas_alloc, "waiting for free memory");
-            gst_poll_wait (priv->poll, GST_CLOCK_TIME_NONE);
-          } else {
-            GST_ERROR_OBJECT (ivas_alloc, "critical error");
-            return NULL;
-          }
-        } else {
-          GST_LOG_OBJECT (ivas_alloc, "waiting for free memory");
-          gst_poll_wait (priv->poll, GST_CLOCK_TIME_NONE);
-          gst_poll_write_control (priv->poll);
-        }
-        goto pop_now; // now try popping memory as wait is completed
-      }
-    }
-  }
 
   if (priv->handle == NULL) {
     GST_ERROR_OBJECT (ivas_alloc, "failed get handle from IVAS");
@@ -215,37 +204,33 @@ pop_now:
   ivasmem->sync_flags = IVAS_SYNC_NONE;
 #endif
 
-  ivasmem->bo = xclAllocBO (priv->handle, size, XCL_BO_DEVICE_RAM, 0);
+  /* flags of xclAllocBO carry the memory bank index */
+  ivasmem->bo = xclAllocBO (priv->handle, size, XCL_BO_DEVICE_RAM,
+      priv->mem_bank);
   if (ivasmem->bo == NULLBO) {
-    GST_ERROR_OBJECT (ivas_alloc, "failed to allocate Device BO. reason %s(%d)",
-        strerror (errno), errno);
+    GST_ERROR_OBJECT (ivas_alloc, "failed to allocate Device BO on bank %u. "
+        "reason %s(%d)", priv->mem_bank, strerror (errno), errno);
+    g_mutex_clear (&ivasmem->lock);
+    g_slice_free (GstIvasMemory, ivasmem);
     return NULL;
   }
   ivasmem->size = size;
+  ivasmem->dev_idx = priv->dev_idx;
+  ivasmem->mem_bank = priv->mem_bank;
   ivasmem->do_free = FALSE;
 
-  if (params->flags & GST_IVAS_ALLOCATOR_FLAG_MEM_INIT) {
-    GST_LOG_OBJECT (ivas_alloc, "Doing memset for created buffer");
-    data = xclMapBO(priv->handle, ivasmem->bo, true);
-    if (data) {
-      memset(data, 0, size);
-      iret = xclSyncBO (priv->handle, ivasmem->bo, XCL_BO_SYNC_BO_TO_DEVICE, size, 0);
-      if (iret != 0) {
-        GST_ERROR_OBJECT (ivas_alloc, "failed to sync output buffer. reason : %d, %s",
-            iret, strerror (errno));
-        xclUnmapBO(priv->handle, ivasmem->bo, data);
-        return NULL;
-      }
-      xclUnmapBO(priv->handle, ivasmem->bo, data);
-    }
-  }
+  GST_LOG_OBJECT (ivas_alloc, "bank %u of device %u holds %lu bytes",
+      ivasmem->mem_bank, ivasmem->dev_idx,
+      ivas_bank_usage_add (ivasmem->dev_idx, ivasmem->mem_bank, size));
 
   if (priv->need_dma) {
     prime_fd = xclExportBO (priv->handle, ivasmem->bo);
     if (prime_fd < 0) {
       GST_ERROR_OBJECT (ivas_alloc, "failed to get dmafd...");
+      ivas_bank_usage_add (ivasmem->dev_idx, ivasmem->mem_bank, -size);
       xclFreeBO (priv->handle, ivasmem->bo);
-      ivasmem->bo = 0;
+      g_mutex_clear (&ivasmem->lock);
+      g_slice_free (GstIvasMemory, ivasmem);
       return NULL;
     }
 
@@ -265,19 +250,110 @@ pop_now:
   return mem;
 }
 
+static gboolean
+ivas_allocator_init_memory (GstIvasAllocator * ivas_alloc, GstMemory * mem)
+{
+  GstIvasAllocatorPrivate *priv = ivas_alloc->priv;
+  GstIvasMemory *ivasmem = get_ivas_mem (mem);
+  void *data = NULL;
+  int iret = 0;
+
+  GST_LOG_OBJECT (ivas_alloc, "Doing memset for created buffer");
+  data = xclMapBO (priv->handle, ivasmem->bo, true);
+  if (!data)
+    return TRUE;
+
+  memset (data, 0, ivasmem->size);
+  iret = xclSyncBO (priv->handle, ivasmem->bo, XCL_BO_SYNC_BO_TO_DEVICE,
+      ivasmem->size, 0);
+  xclUnmapBO (priv->handle, ivasmem->bo, data);
+  if (iret != 0) {
+    GST_ERROR_OBJECT (ivas_alloc, "failed to sync output buffer. reason : %d, %s",
+        iret, strerror (errno));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static GstMemory *
+gst_ivas_allocator_alloc (GstAllocator * allocator, gsize size,
+    GstAllocationParams * params)
+{
+  GstIvasAllocator *ivas_alloc = GST_IVAS_ALLOCATOR (allocator);
+  GstIvasAllocatorPrivate *priv = ivas_alloc->priv;
+  GstMemory *mem;
+
+  if (priv->free_queue && g_atomic_int_get (&priv->active)) {
+    // TODO: peek memory and check size of popped mem is sufficient or not
+
+pop_now:
+    mem = gst_atomic_queue_pop (priv->free_queue);
+    if (G_LIKELY (mem)) {
+      while (!gst_poll_read_control (priv->poll)) {
+        if (errno == EWOULDBLOCK) {
+          /* We put the buffer into the queue but did not finish writing control
+           * yet, let's wait a bit and retry */
+          g_thread_yield ();
+          continue;
+        } else {
+          /* Critical error but GstPoll already complained */
+          break;
+        }
+      }
+      GST_LOG_OBJECT (ivas_alloc, "popped preallocated memory %p", mem);
+      return mem;
+    } else {
+      /* check we reached maximum buffers */
+      if (priv->max_mem && priv->cur_mem >= priv->max_mem) {
+        if (!gst_poll_read_control (priv->poll)) {
+          if (errno == EWOULDBLOCK) {
+            GST_LOG_OBJECT (ivas_alloc, "waiting for free memory");
+            gst_poll_wait (priv->poll, GST_CLOCK_TIME_NONE);
+          } else {
+            GST_ERROR_OBJECT (ivas_alloc, "critical error");
+            return NULL;
+          }
+        } else {
+          GST_LOG_OBJECT (ivas_alloc, "waiting for free memory");
+          gst_poll_wait (priv->poll, GST_CLOCK_TIME_NONE);
+          gst_poll_write_control (priv->poll);
+        }
+        goto pop_now; // now try popping memory as wait is completed
+      }
+    }
+  }
+
+  mem = ivas_allocator_new_memory (ivas_alloc, size, params);
+  if (mem && (params->flags & GST_IVAS_ALLOCATOR_FLAG_MEM_INIT)
+      && !ivas_allocator_init_memory (ivas_alloc, mem)) {
+    get_ivas_mem (mem)->do_free = TRUE;
+    gst_memory_unref (mem);
+    return NULL;
+  }
+
+  return mem;
+}
+
 static gpointer
 gst_ivas_mem_map (GstMemory * mem, gsize maxsize, GstMapFlags flags)
 {
   GstIvasMemory *ivasmem = (GstIvasMemory *) mem;
   GstIvasAllocator *alloc = ivasmem->alloc;
+  GstMapFlags access = flags;
   gpointer ret = NULL;
 
+#ifdef XLNX_PCIe_PLATFORM
+  /* NO_SYNC only skips the sync below, it is not an access mode */
+  access = (GstMapFlags) (access & ~GST_IVAS_MAP_FLAG_NO_SYNC);
+#endif
+
   g_mutex_lock (&ivasmem->lock);
 
   if (ivasmem->data) {
     /* only return address if mapping flags are a subset
      * of the previous flags */
-    if ((ivasmem->mmapping_flags & flags) == flags) {
+    if ((ivasmem->mmapping_flags & access) == access) {
       ret = ivasmem->data;
       ivasmem->mmap_count++;
     }
@@ -296,7 +372,7 @@ gst_ivas_mem_map (GstMemory * mem, gsize maxsize, GstMapFlags flags)
       ivasmem->data, maxsize, flags & GST_MAP_WRITE);
 
   if (ivasmem->data) {
-    ivasmem->mmapping_flags = flags;
+    ivasmem->mmapping_flags = access;
     ivasmem->mmap_count++;
     ret = ivasmem->data;
   }
@@ -375,8 +451,10 @@ gst_ivas_allocator_free (GstAllocator * allocator, GstMemory * mem)
   GstIvasMemory *ivasmem = (GstIvasMemory *) mem;
   GstIvasAllocator *alloc = GST_IVAS_ALLOCATOR (allocator);
 
-  if (ivasmem->bo != NULLBO && mem->parent == NULL)
+  if (ivasmem->bo != NULLBO && mem->parent == NULL) {
     xclFreeBO (alloc->priv->handle, ivasmem->bo);
+    ivas_bank_usage_add (ivasmem->dev_idx, ivasmem->mem_bank, -ivasmem->size);
+  }
 
   g_mutex_clear (&ivasmem->lock);
   g_slice_free (GstIvasMemory, ivasmem);
@@ -396,7 +474,7 @@ gst_ivas_allocator_finalize (GObject * obj)
   if (alloc->priv->dmabuf_alloc)
     gst_object_unref (alloc->priv->dmabuf_alloc);
 
-  xclClose (alloc->priv->handle);
+  close_shared_xrt_device (alloc->priv->handle);
   G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
 
@@ -409,11 +487,16 @@ gst_ivas_allocator_set_property (GObject * object, guint prop_id,
   switch (prop_id) {
     case PROP_DEVICE_INDEX:
       alloc->priv->dev_idx = g_value_get_uint (value);
+      if (alloc->priv->handle)
+        close_shared_xrt_device (alloc->priv->handle);
       alloc->priv->handle = ivas_open_device (alloc->priv->dev_idx);
       break;
     case PROP_NEED_DMA:
       alloc->priv->need_dma = g_value_get_boolean (value);
       break;
+    case PROP_MEM_BANK:
+      alloc->priv->mem_bank = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -445,6 +528,12 @@ gst_ivas_allocator_class_init (GstIvasAllocatorClass * klass)
           "Expose as DMABuf Allocator", DEFAULT_NEED_DMA,
           G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_MEM_BANK,
+      g_param_spec_uint ("mem-bank", "Device memory bank",
+          "Device memory bank index to allocate buffers from", 0,
+          IVAS_MAX_MEM_BANKS - 1, DEFAULT_MEM_BANK,
+          G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
+
   gst_ivas_allocator_signals[IVAS_MEM_RELEASED] = g_signal_new ("ivas-mem-released",
       G_TYPE_FROM_CLASS (gobject_class), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
       G_TYPE_NONE, 1, GST_TYPE_MEMORY);
@@ -475,11 +564,20 @@ gst_ivas_allocator_init (GstIvasAllocator * allocator)
 
 GstAllocator *
 gst_ivas_allocator_new (guint dev_idx, gboolean need_dma)
+{
+  return gst_ivas_allocator_new_with_bank (dev_idx, need_dma,
+      DEFAULT_MEM_BANK);
+}
+
+GstAllocator *
+gst_ivas_allocator_new_with_bank (guint dev_idx, gboolean need_dma,
+    guint mem_bank)
 {
   GstAllocator *alloc = NULL;
 
   alloc = (GstAllocator *) g_object_new (GST_TYPE_IVAS_ALLOCATOR,
-      "device-index", dev_idx, "need-dma", need_dma, NULL);
+      "device-index", dev_idx, "need-dma", need_dma, "mem-bank", mem_bank,
+      NULL);
   gst_object_ref_sink (alloc);
   return alloc;
 }
@@ -489,8 +587,8 @@ gst_ivas_allocator_start (GstIvasAllocator * ivas_alloc, guint min_mem,
     guint max_mem, gsize size, GstAllocationParams * params)
 {
   GstIvasAllocatorPrivate *priv = ivas_alloc->priv;
-  GstMemory *mem = NULL;
-  guint i;
+  GstMemory **mems = NULL;
+  guint i, allocated = 0;
 
   g_return_val_if_fail (min_mem != 0, FALSE);
 
@@ -509,23 +607,55 @@ gst_ivas_allocator_start (GstIvasAllocator * ivas_alloc, guint min_mem,
       "going to store %u memories with size %lu in queue %p", min_mem, size,
       priv->free_queue);
 
-  for (i = 0; i < min_mem; i++) {
-    mem = gst_ivas_allocator_alloc (GST_ALLOCATOR (ivas_alloc), size, params);
-    if (!mem) {
-      GST_ERROR_OBJECT (ivas_alloc, "failed allocate memory of size %lu", size);
-      return FALSE;
+  /* allocate all BOs back to back first and initialize them in a second
+   * pass, so pools starting together don't interleave allocation ioctls
+   * with memset and cache maintenance of each buffer */
+  mems = g_new0 (GstMemory *, min_mem);
+  for (allocated = 0; allocated < min_mem; allocated++) {
+    mems[allocated] = ivas_allocator_new_memory (ivas_alloc, size, params);
+    if (!mems[allocated]) {
+      GST_ERROR_OBJECT (ivas_alloc, "failed allocate memory of size %lu on "
+          "bank %u", size, priv->mem_bank);
+      goto error;
+    }
+  }
+
+  if (params->flags & GST_IVAS_ALLOCATOR_FLAG_MEM_INIT) {
+    for (i = 0; i < min_mem; i++) {
+      if (!ivas_allocator_init_memory (ivas_alloc, mems[i]))
+        goto error;
     }
+  }
+
+  for (i = 0; i < min_mem; i++) {
     GST_DEBUG_OBJECT (ivas_alloc,
-        "pushing memory %p to free memory queue at index %u", mem, i);
-    gst_atomic_queue_push (priv->free_queue, mem);
+        "pushing memory %p to free memory queue at index %u", mems[i], i);
+    gst_atomic_queue_push (priv->free_queue, mems[i]);
     gst_poll_write_control (priv->poll);
   }
+  g_free (mems);
 
   gst_poll_write_control (priv->poll);
 
+  GST_INFO_OBJECT (ivas_alloc, "allocated %u memories on bank %u of device "
+      "%u, bank now holds %lu bytes", min_mem, priv->mem_bank, priv->dev_idx,
+      gst_ivas_allocator_get_bank_usage (priv->dev_idx, priv->mem_bank));
+
   g_atomic_int_set (&priv->active, TRUE);
 
   return TRUE;
+
+error:
+  for (i = 0; i < allocated; i++) {
+    get_ivas_mem (mems[i])->do_free = TRUE;
+    gst_memory_unref (mems[i]);
+  }
+  g_free (mems);
+  gst_atomic_queue_unref (priv->free_queue);
+  priv->free_queue = NULL;
+  gst_poll_free (priv->poll);
+  priv->poll = NULL;
+  return FALSE;
 }
 
 gboolean
@@ -579,6 +709,38 @@ error:
   return FALSE;
 }
 
+/* frees up to n_mem idle memories of an active allocator back to the device,
+ * returns how many were freed */
+guint
+gst_ivas_allocator_trim (GstIvasAllocator * ivas_alloc, guint n_mem)
+{
+  GstIvasAllocatorPrivate *priv = ivas_alloc->priv;
+  GstMemory *mem;
+  guint freed = 0;
+
+  if (!g_atomic_int_get (&priv->active))
+    return 0;
+
+  while (freed < n_mem && (mem = gst_atomic_queue_pop (priv->free_queue))) {
+    while (!gst_poll_read_control (priv->poll)) {
+      if (errno == EWOULDBLOCK) {
+        g_thread_yield ();
+        continue;
+      } else {
+        break;
+      }
+    }
+    get_ivas_mem (mem)->do_free = TRUE;
+    gst_memory_unref (mem);
+    freed++;
+  }
+
+  GST_DEBUG_OBJECT (ivas_alloc, "trimmed %u memories, %u left", freed,
+      priv->cur_mem);
+
+  return freed;
+}
+
 gboolean
 gst_is_ivas_memory (GstMemory * mem)
 {
@@ -652,13 +814,307 @@ gst_ivas_allocator_get_device_idx (GstAllocator * allocator)
   return alloc->priv->dev_idx;
 }
 
+gsize
+gst_ivas_allocator_get_bank_usage (guint dev_idx, guint mem_bank)
+{
+  gsize usage;
+
+  g_return_val_if_fail (dev_idx < IVAS_MAX_DEVICES, 0);
+  g_return_val_if_fail (mem_bank < IVAS_MAX_MEM_BANKS, 0);
+
+  G_LOCK (bank_usage);
+  usage = bank_usage[dev_idx][mem_bank];
+  G_UNLOCK (bank_usage);
+
+  return usage;
+}
+
+/* Foreign dmabufs (decoders, v4l2 etc.) are imported once per device handle
+ * and stay imported for as long as a GstMemory wrapping them is alive, so
+ * recycled pool buffers don't pay for xclImportBO/xclGetBOProperties on
+ * every frame. Entries are keyed on the dmabuf inode, which stays unique
+ * while our import holds a reference on the dmabuf */
+typedef struct _GstIvasDmabufImport
+{
+  xclDeviceHandle handle;       /* NULL once the handle is released */
+  dev_t dev;
+  ino_t ino;
+  guint bo;
+  guint64 paddr;
+  gint refcount;                /* import table + each attached memory */
+} GstIvasDmabufImport;
+
+GST_DEBUG_CATEGORY_STATIC (ivas_dmabuf_import_debug);
+static GMutex import_lock;
+static GHashTable *import_table;
+static GQuark import_quark;
+
+static guint
+dmabuf_import_hash (gconstpointer key)
+{
+  const GstIvasDmabufImport *import = (const GstIvasDmabufImport *) key;
+
+  return g_direct_hash (import->handle) ^ (guint) import->ino ^
+      (guint) import->dev;
+}
+
+static gboolean
+dmabuf_import_equal (gconstpointer a, gconstpointer b)
+{
+  const GstIvasDmabufImport *ia = (const GstIvasDmabufImport *) a;
+  const GstIvasDmabufImport *ib = (const GstIvasDmabufImport *) b;
+
+  return ia->handle == ib->handle && ia->ino == ib->ino && ia->dev == ib->dev;
+}
+
+/* must be called with import_lock held */
+static void
+dmabuf_import_unref_locked (GstIvasDmabufImport * import)
+{
+  if (--import->refcount == 1 && import->handle) {
+    /* no memory wraps this dmabuf anymore, drop the import */
+    GST_CAT_DEBUG (ivas_dmabuf_import_debug, "dropping import of inode %lu "
+        ": bo = %u", (gulong) import->ino, import->bo);
+    g_hash_table_remove (import_table, import);
+    xclFreeBO (import->handle, import->bo);
+    import->handle = NULL;
+    import->refcount--;
+  }
+
+  if (!import->refcount)
+    g_slice_free (GstIvasDmabufImport, import);
+}
+
+static void
+dmabuf_import_list_free (gpointer data)
+{
+  GSList *list = (GSList *) data, *l;
+
+  g_mutex_lock (&import_lock);
+  for (l = list; l; l = l->next)
+    dmabuf_import_unref_locked ((GstIvasDmabufImport *) l->data);
+  g_mutex_unlock (&import_lock);
+
+  g_slist_free (list);
+}
+
+static void
+dmabuf_import_init (void)
+{
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init)) {
+    GST_DEBUG_CATEGORY_INIT (ivas_dmabuf_import_debug, "ivasdmabufimport", 0,
+        "IVAS dmabuf import cache");
+    import_quark = g_quark_from_static_string ("GstIvasDmabufImport");
+    import_table = g_hash_table_new (dmabuf_import_hash, dmabuf_import_equal);
+    g_once_init_leave (&init, 1);
+  }
+}
+
+/* returns physical address of a dmabuf not allocated by GstIvasAllocator
+ * on device handle, 0 on failure */
+guint64
+gst_ivas_dmabuf_import_get_paddr (xclDeviceHandle handle, GstMemory * mem)
+{
+  GstIvasDmabufImport key, *import = NULL;
+  struct xclBOProperties p;
+  struct stat st;
+  GSList *list, *l;
+  guint64 paddr = 0;
+  guint bo;
+  gint fd;
+
+  g_return_val_if_fail (handle != NULL, 0);
+  g_return_val_if_fail (gst_is_dmabuf_memory (mem), 0);
+
+  dmabuf_import_init ();
+
+  g_mutex_lock (&import_lock);
+
+  list = (GSList *) gst_mini_object_get_qdata (GST_MINI_OBJECT (mem),
+      import_quark);
+  for (l = list; l; l = l->next) {
+    import = (GstIvasDmabufImport *) l->data;
+    if (import->handle == handle) {
+      paddr = import->paddr;
+      goto exit;
+    }
+  }
+
+  fd = gst_dmabuf_memory_get_fd (mem);
+  if (fd < 0 || fstat (fd, &st) < 0) {
+    GST_CAT_ERROR (ivas_dmabuf_import_debug, "failed to stat DMABUF FD %d",
+        fd);
+    goto exit;
+  }
+
+  key.handle = handle;
+  key.dev = st.st_dev;
+  key.ino = st.st_ino;
+
+  import = (GstIvasDmabufImport *) g_hash_table_lookup (import_table, &key);
+  if (!import) {
+    bo = xclImportBO (handle, fd, 0);
+    if (bo == NULLBO) {
+      GST_CAT_WARNING (ivas_dmabuf_import_debug,
+          "failed to import DMABUF FD %d", fd);
+      goto exit;
+    }
+
+    if (xclGetBOProperties (handle, bo, &p)) {
+      GST_CAT_WARNING (ivas_dmabuf_import_debug,
+          "failed to get physical address of BO %u", bo);
+      xclFreeBO (handle, bo);
+      goto exit;
+    }
+
+    import = g_slice_new0 (GstIvasDmabufImport);
+    import->handle = handle;
+    import->dev = st.st_dev;
+    import->ino = st.st_ino;
+    import->bo = bo;
+    import->paddr = p.paddr;
+    import->refcount = 1;
+    g_hash_table_add (import_table, import);
+
+    GST_CAT_DEBUG (ivas_dmabuf_import_debug, "imported DMABUF FD %d (inode "
+        "%lu) : bo = %u, paddr = 0x%" G_GINT64_MODIFIER "x", fd,
+        (gulong) st.st_ino, bo, import->paddr);
+  }
+
+  import->refcount++;
+  if (list)
+    g_slist_append (list, import);
+  else
+    gst_mini_object_set_qdata (GST_MINI_OBJECT (mem), import_quark,
+        g_slist_append (NULL, import), dmabuf_import_list_free);
+  paddr = import->paddr;
+
+exit:
+  g_mutex_unlock (&import_lock);
+  return paddr;
+}
+
+/* frees every BO imported on handle, must be called before xclClose() */
+void
+gst_ivas_dmabuf_import_release (xclDeviceHandle handle)
+{
+  GstIvasDmabufImport *import;
+  GHashTableIter iter;
+
+  dmabuf_import_init ();
+
+  g_mutex_lock (&import_lock);
+  g_hash_table_iter_init (&iter, import_table);
+  while (g_hash_table_iter_next (&iter, (gpointer *) & import, NULL)) {
+    if (import->handle != handle)
+      continue;
+
+    g_hash_table_iter_remove (&iter);
+    xclFreeBO (import->handle, import->bo);
+    /* memories still holding it only keep the struct alive */
+    import->handle = NULL;
+    if (!--import->refcount)
+      g_slice_free (GstIvasDmabufImport, import);
+  }
+  g_mutex_unlock (&import_lock);
+}
+
 #ifdef XLNX_PCIe_PLATFORM
+/* sync state lives on the memory owning the BO, shared sub-memories and
+ * dmabuf wrappers resolve to it */
+static GstIvasMemory *
+get_ivas_root_mem (GstMemory * mem)
+{
+  GstIvasMemory *ivasmem = get_ivas_mem (mem);
+
+  while (ivasmem && ivasmem->parent.parent)
+    ivasmem = (GstIvasMemory *) ivasmem->parent.parent;
+
+  return ivasmem;
+}
+
+static gboolean
+ivas_memory_sync_from_device (GstIvasMemory * ivasmem, gsize start, gsize end)
+{
+  GstIvasAllocator *alloc = ivasmem->alloc;
+  int iret = 0;
+
+  if (!(ivasmem->sync_flags & IVAS_SYNC_FROM_DEVICE) || start >= end)
+    return TRUE;
+
+  if (start >= ivasmem->valid_start && end <= ivasmem->valid_end)
+    return TRUE;
+
+  GST_LOG_OBJECT (alloc,
+      "sync from device %p : bo = %u, offset = %lu, size = %lu, handle = %p",
+      ivasmem, ivasmem->bo, start, end - start, alloc->priv->handle);
+
+  GST_CAT_LOG_OBJECT (GST_CAT_PERFORMANCE, alloc,
+      "slow copy %lu bytes from device", end - start);
+
+  iret = xclSyncBO (alloc->priv->handle, ivasmem->bo,
+      XCL_BO_SYNC_BO_FROM_DEVICE, end - start, start);
+  if (iret != 0) {
+    GST_ERROR_OBJECT (alloc, "failed to sync output buffer. reason : %d, %s",
+        iret, strerror (errno));
+    return FALSE;
+  }
+
+  /* only a contiguous range can be remembered, keep the bigger one when the
+   * new range does not touch the known one */
+  if (ivasmem->valid_start == ivasmem->valid_end
+      || (start <= ivasmem->valid_end && end >= ivasmem->valid_start)) {
+    if (ivasmem->valid_start != ivasmem->valid_end) {
+      start = MIN (start, ivasmem->valid_start);
+      end = MAX (end, ivasmem->valid_end);
+    }
+    ivasmem->valid_start = start;
+    ivasmem->valid_end = end;
+  } else if (end - start > ivasmem->valid_end - ivasmem->valid_start) {
+    ivasmem->valid_start = start;
+    ivasmem->valid_end = end;
+  }
+
+  if (ivasmem->valid_start == 0 && ivasmem->valid_end >= ivasmem->size) {
+    ivasmem->sync_flags &= ~IVAS_SYNC_FROM_DEVICE;
+    ivasmem->valid_start = ivasmem->valid_end = 0;
+  }
+
+  return TRUE;
+}
+
+static void
+ivas_memory_add_dirty (GstIvasMemory * ivasmem, gsize start, gsize end)
+{
+  if (start >= end)
+    return;
+
+  /* a single bounding range, syncing a gap twice is cheaper than tracking */
+  if (ivasmem->dirty_start != ivasmem->dirty_end) {
+    start = MIN (start, ivasmem->dirty_start);
+    end = MAX (end, ivasmem->dirty_end);
+  }
+  ivasmem->dirty_start = start;
+  ivasmem->dirty_end = MIN (end, ivasmem->size);
+  ivasmem->sync_flags |= IVAS_SYNC_TO_DEVICE;
+}
+
 void
 gst_ivas_memory_set_sync_flag (GstMemory * mem, IvasSyncFlags flag)
 {
   GstIvasMemory *ivasmem;
-  ivasmem = get_ivas_mem (mem);
-  ivasmem->sync_flags |= flag;
+  ivasmem = get_ivas_root_mem (mem);
+
+  if (flag & IVAS_SYNC_TO_DEVICE)
+    ivas_memory_add_dirty (ivasmem, 0, ivasmem->size);
+
+  if (flag & IVAS_SYNC_FROM_DEVICE) {
+    /* device is going to write, nothing on host is valid anymore */
+    ivasmem->sync_flags |= IVAS_SYNC_FROM_DEVICE;
+    ivasmem->valid_start = ivasmem->valid_end = 0;
+  }
 }
 
 gboolean
@@ -666,8 +1122,9 @@ gst_ivas_memory_sync_with_flags (GstMemory * mem, GstMapFlags flags)
 {
   GstIvasMemory *ivasmem;
   GstIvasAllocator *alloc;
+  gsize start, end;
 
-  ivasmem = get_ivas_mem (mem);
+  ivasmem = get_ivas_root_mem (mem);
   if (ivasmem == NULL) {
     GST_ERROR ("failed to get ivas memory");
     return FALSE;
@@ -675,35 +1132,100 @@ gst_ivas_memory_sync_with_flags (GstMemory * mem, GstMapFlags flags)
 
   alloc = ivasmem->alloc;
 
-  if ((flags & GST_MAP_READ) && (ivasmem->sync_flags & IVAS_SYNC_FROM_DEVICE)) {
-    int iret = 0;
-
-    GST_LOG_OBJECT (alloc,
-        "sync to device %p : bo = %u, size = %lu, handle = %p", ivasmem,
-        ivasmem->bo, ivasmem->size, alloc->priv->handle);
+  if (flags & GST_IVAS_MAP_FLAG_NO_SYNC) {
+    /* caller syncs the ranges it touches itself */
+    return TRUE;
+  }
 
-    GST_CAT_LOG_OBJECT (GST_CAT_PERFORMANCE, alloc,
-        "slow copy data from device");
+  start = mem->offset;
+  end = mem->offset + mem->size;
 
-    iret =
-        xclSyncBO (alloc->priv->handle, ivasmem->bo, XCL_BO_SYNC_BO_FROM_DEVICE,
-        ivasmem->size, 0);
-    if (iret != 0) {
-      GST_ERROR_OBJECT (alloc, "failed to sync output buffer. reason : %d, %s",
-          iret, strerror (errno));
-      return FALSE;
-    }
-    ivasmem->sync_flags &= ~IVAS_SYNC_FROM_DEVICE;
-  }
+  if ((flags & GST_MAP_READ)
+      && !ivas_memory_sync_from_device (ivasmem, start, end))
+    return FALSE;
 
   if (flags & GST_MAP_WRITE) {
-    ivasmem->sync_flags |= IVAS_SYNC_TO_DEVICE;
+    ivas_memory_add_dirty (ivasmem, start, end);
     /* ivas plugins does XCL_BO_SYNC_BO_TO_DEVICE to update data, for others dont care */
     GST_LOG_OBJECT (alloc, "enabling sync to device flag for %p", ivasmem);
   }
   return TRUE;
 }
 
+gboolean
+gst_ivas_memory_sync_range (GstMemory * mem, gsize offset, gsize size)
+{
+  GstIvasMemory *ivasmem;
+
+  ivasmem = get_ivas_root_mem (mem);
+  if (ivasmem == NULL) {
+    GST_ERROR ("failed to get ivas memory");
+    return FALSE;
+  }
+
+  g_return_val_if_fail (offset + size <= mem->size, FALSE);
+
+  return ivas_memory_sync_from_device (ivasmem, mem->offset + offset,
+      mem->offset + offset + size);
+}
+
+void
+gst_ivas_memory_set_dirty_range (GstMemory * mem, gsize offset, gsize size)
+{
+  GstIvasMemory *ivasmem;
+
+  ivasmem = get_ivas_root_mem (mem);
+  if (ivasmem == NULL) {
+    GST_ERROR ("failed to get ivas memory");
+    return;
+  }
+
+  g_return_if_fail (offset + size <= mem->size);
+
+  ivas_memory_add_dirty (ivasmem, mem->offset + offset,
+      mem->offset + offset + size);
+}
+
+gboolean
+gst_ivas_memory_sync_video_region (GstMemory * mem, GstVideoMeta * vmeta,
+    const GstVideoRectangle * rect)
+{
+  const GstVideoFormatInfo *finfo;
+  guint plane;
+
+  g_return_val_if_fail (vmeta != NULL && rect != NULL, FALSE);
+
+  finfo = gst_video_format_get_info (vmeta->format);
+  if (!finfo || GST_VIDEO_FORMAT_INFO_HAS_PALETTE (finfo)) {
+    /* no per-row layout to rely on, sync the whole memory */
+    return gst_ivas_memory_sync_with_flags (mem, GST_MAP_READ);
+  }
+
+  for (plane = 0; plane < vmeta->n_planes; plane++) {
+    guint comp, y, h;
+    gsize offset;
+
+    /* vertical subsampling of the first component stored in this plane */
+    for (comp = 0; comp < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); comp++)
+      if (GST_VIDEO_FORMAT_INFO_PLANE (finfo, comp) == plane)
+        break;
+    if (comp == GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo))
+      continue;
+
+    y = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, comp, rect->y);
+    h = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, comp,
+        rect->y + rect->h) - y;
+
+    /* rows are synced whole, columns of a ROI are not contiguous anyway */
+    offset = vmeta->offset[plane] + (gsize) y * vmeta->stride[plane];
+    if (!gst_ivas_memory_sync_range (mem, offset,
+            (gsize) h * vmeta->stride[plane]))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
 gboolean
 gst_ivas_memory_sync_bo (GstMemory * mem)
 {
@@ -711,7 +1233,7 @@ gst_ivas_memory_sync_bo (GstMemory * mem)
   GstIvasAllocator *alloc;
   int iret = 0;
 
-  ivasmem = get_ivas_mem (mem);
+  ivasmem = get_ivas_root_mem (mem);
   if (ivasmem == NULL) {
     GST_ERROR ("failed to get ivas memory");
     return 0;
@@ -729,11 +1251,15 @@ gst_ivas_memory_sync_bo (GstMemory * mem)
   }
 
   if (ivasmem->sync_flags & IVAS_SYNC_TO_DEVICE) {
-    GST_CAT_LOG_OBJECT (GST_CAT_PERFORMANCE, alloc, "slow copy data to device");
+    gsize size = ivasmem->dirty_end - ivasmem->dirty_start;
+
+    GST_CAT_LOG_OBJECT (GST_CAT_PERFORMANCE, alloc,
+        "slow copy %lu bytes at offset %lu to device", size,
+        ivasmem->dirty_start);
 
     iret =
         xclSyncBO (alloc->priv->handle, ivasmem->bo, XCL_BO_SYNC_BO_TO_DEVICE,
-        ivasmem->size, 0);
+        size, ivasmem->dirty_start);
     if (iret != 0) {
       GST_ERROR_OBJECT (alloc,
           "failed to sync output buffer to device. reason : %d, %s", iret,
@@ -741,6 +1267,7 @@ gst_ivas_memory_sync_bo (GstMemory * mem)
       return FALSE;
     }
     ivasmem->sync_flags &= ~IVAS_SYNC_TO_DEVICE;
+    ivasmem->dirty_start = ivasmem->dirty_end = 0;
   }
 
   return TRUE;
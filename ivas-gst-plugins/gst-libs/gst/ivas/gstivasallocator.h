@@ -64,11 +64,16 @@ GType gst_ivas_allocator_get_type (void) G_GNUC_CONST;
 GST_EXPORT
 GstAllocator* gst_ivas_allocator_new (guint dev_idx, gboolean need_dma);
 GST_EXPORT
+GstAllocator* gst_ivas_allocator_new_with_bank (guint dev_idx,
+    gboolean need_dma, guint mem_bank);
+GST_EXPORT
 gboolean gst_ivas_allocator_start (GstIvasAllocator * allocator, guint min_mem,
     guint max_mem, gsize size, GstAllocationParams * params);
 GST_EXPORT
 gboolean gst_ivas_allocator_stop (GstIvasAllocator * allocator);
 GST_EXPORT
+guint gst_ivas_allocator_trim (GstIvasAllocator * allocator, guint n_mem);
+GST_EXPORT
 gboolean gst_is_ivas_memory (GstMemory *mem);
 GST_EXPORT
 guint64  gst_ivas_allocator_get_paddr (GstMemory *mem);
@@ -78,6 +83,14 @@ GST_EXPORT
 gboolean gst_ivas_memory_can_avoid_copy (GstMemory *mem, guint cur_devid);
 GST_EXPORT
 guint gst_ivas_allocator_get_device_idx (GstAllocator * allocator);
+/* bytes currently allocated on a device memory bank by all IVAS allocators */
+GST_EXPORT
+gsize gst_ivas_allocator_get_bank_usage (guint dev_idx, guint mem_bank);
+GST_EXPORT
+guint64 gst_ivas_dmabuf_import_get_paddr (xclDeviceHandle handle,
+    GstMemory * mem);
+GST_EXPORT
+void gst_ivas_dmabuf_import_release (xclDeviceHandle handle);
 
 #ifdef XLNX_PCIe_PLATFORM
 typedef enum {
@@ -86,12 +99,28 @@ typedef enum {
   IVAS_SYNC_FROM_DEVICE = 1 << 1, /* sync data to device using DMA transfer */
 } IvasSyncFlags;
 
+/* map flag to skip the implicit full sync, for users that sync only the
+ * ranges they touch with gst_ivas_memory_sync_range() and
+ * gst_ivas_memory_set_dirty_range(). Placed after the video frame flags
+ * since gst_video_frame_map() hands those down to the memory map */
+#define GST_IVAS_MAP_FLAG_NO_SYNC (GST_VIDEO_FRAME_MAP_FLAG_LAST << 0)
+
 GST_EXPORT
 void gst_ivas_memory_set_sync_flag (GstMemory *mem, IvasSyncFlags flag);
 GST_EXPORT
 gboolean gst_ivas_memory_sync_bo (GstMemory *mem);
 GST_EXPORT
 gboolean gst_ivas_memory_sync_with_flags (GstMemory *mem, GstMapFlags flags);
+/* makes [offset, offset + size) of mem coherent for reading on host */
+GST_EXPORT
+gboolean gst_ivas_memory_sync_range (GstMemory *mem, gsize offset, gsize size);
+/* records [offset, offset + size) of mem as written on host */
+GST_EXPORT
+void gst_ivas_memory_set_dirty_range (GstMemory *mem, gsize offset, gsize size);
+/* syncs only the rows of each plane covered by rect */
+GST_EXPORT
+gboolean gst_ivas_memory_sync_video_region (GstMemory *mem,
+    GstVideoMeta *vmeta, const GstVideoRectangle *rect);
 #endif
 
 G_END_DECLS
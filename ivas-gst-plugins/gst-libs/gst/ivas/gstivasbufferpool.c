@@ -18,22 +18,54 @@
 #include "config.h"
 #endif
 
+#include <string.h>
 #include <gst/video/gstvideometa.h>
 #include <gst/ivas/gstivasallocator.h>
+#include <gst/ivas/gstivasvideoformat.h>
 #include "gstivasbufferpool.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_ivas_buffer_pool_debug);
 #define GST_CAT_DEFAULT gst_ivas_buffer_pool_debug
+GST_DEBUG_CATEGORY_STATIC (gst_ivas_buffer_pool_stats_debug);
 
-#define ALIGN(size,align) (((size) + (align) - 1) & ~((align) - 1))
+#define IVAS_ALIGN_STRUCT_NAME "GstIvasBufferPoolAlign"
+#define IVAS_STATS_STRUCT_NAME "GstIvasBufferPoolStats"
+
+/* IVAS_POOL_STATS_INTERVAL=<ms> turns on the periodic dump for all pools */
+#define IVAS_STATS_INTERVAL_ENV "IVAS_POOL_STATS_INTERVAL"
+/* IVAS_POOL_ADAPTIVE=1 turns on adaptive sizing for all pools */
+#define IVAS_ADAPTIVE_ENV "IVAS_POOL_ADAPTIVE"
+
+#define DEFAULT_GROW_THRESHOLD 10       /* ms */
+#define DEFAULT_SHRINK_PERIOD 2000      /* ms */
 
 enum
 {
   PROP_0,
   PROP_STRIDE_ALIGN,
   PROP_ELEVATION_ALIGN,
+  PROP_STATS_INTERVAL,
+  PROP_STATS,
+  PROP_ADAPTIVE,
+  PROP_GROW_THRESHOLD,
+  PROP_SHRINK_PERIOD,
 };
 
+/* all times in nanoseconds, counters are since the last pool start */
+typedef struct
+{
+  guint outstanding;
+  guint high_water;
+  guint64 n_acquired;
+  guint64 n_prealloc;
+  guint64 n_alloc;
+  GstClockTime wait_total;
+  GstClockTime wait_max;
+  guint64 n_released;
+  GstClockTime age_total;
+  GstClockTime age_max;
+} IvasPoolStats;
+
 struct _GstIvasBufferPoolPrivate
 {
   GstVideoInfo vinfo;
@@ -42,129 +74,39 @@ struct _GstIvasBufferPoolPrivate
   GstAllocationParams params;
   guint stride_align;
   guint elevation_align;
+
+  GMutex stats_lock;
+  IvasPoolStats stats;
+  /* outstanding buffer -> acquire timestamp */
+  GHashTable *acquired;
+  gboolean starting;
+  GstClockTime stats_interval;
+  GstClockTime last_dump;
+
+  /* adaptive sizing, all protected by stats_lock. Acquire waits on
+   * slot_cond while outstanding buffers reach cur_limit, the limit moves
+   * between min_buffers and max_buffers (0 = unbounded) */
+  gboolean adaptive;
+  GstClockTime grow_threshold;
+  GstClockTime shrink_period;
+  guint min_buffers;
+  guint max_buffers;
+  guint cur_limit;
+  guint n_alive;
+  GCond slot_cond;
+  gboolean flushing;
+  gboolean trimming;
+  GstClockTime window_start;
+  guint window_peak;
 };
 
 #define parent_class gst_ivas_buffer_pool_parent_class
 G_DEFINE_TYPE_WITH_CODE (GstIvasBufferPool, gst_ivas_buffer_pool,
     GST_TYPE_VIDEO_BUFFER_POOL, G_ADD_PRIVATE (GstIvasBufferPool);
     GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "ivasbufferpool", 0,
-        "IVAS buffer pool"));
-
-typedef struct {
-  gint align_stride0;
-  gint align_elevation;
-  gint align_size;
-  gsize offset[GST_VIDEO_MAX_PLANES];
-  gint stride[GST_VIDEO_MAX_PLANES];
-} planes_vals;
-
-/* size is calculated as per fill_planes() in video-info.c */
-static gboolean
-fill_planes_vals (GstVideoInfo * info, GstBufferPool * pool, planes_vals *plane)
-{
-  GstIvasBufferPool *xpool = GST_IVAS_BUFFER_POOL_CAST (pool);
-
-  plane->align_stride0 =
-      ALIGN (GST_VIDEO_INFO_PLANE_STRIDE (info, 0),
-      xpool->priv->stride_align);
-  plane->align_elevation =
-      ALIGN (GST_VIDEO_INFO_HEIGHT (info), xpool->priv->elevation_align);
-
-  switch (GST_VIDEO_INFO_FORMAT (info)) {
-    case GST_VIDEO_FORMAT_NV12:
-      plane->stride[0] = plane->stride[1] = plane->align_stride0;
-      plane->offset[0] = 0;
-      plane->offset[1] = plane->offset[0] + plane->stride[0] * plane->align_elevation;
-      plane->align_size = (plane->align_stride0 * plane->align_elevation * 3) >> 1;
-      break;
-    case GST_VIDEO_FORMAT_RGBx:
-    case GST_VIDEO_FORMAT_r210:
-    case GST_VIDEO_FORMAT_Y410:
-    case GST_VIDEO_FORMAT_BGRx:
-    case GST_VIDEO_FORMAT_BGRA:
-    case GST_VIDEO_FORMAT_RGBA:
-      plane->stride[0] = plane->align_stride0;
-      plane->offset[0] = 0;
-      plane->align_size = plane->stride[0] * plane->align_elevation;
-      break;
-    case GST_VIDEO_FORMAT_YUY2:
-      plane->stride[0] = plane->align_stride0;
-      plane->offset[0] = 0;
-      plane->align_size = plane->stride[0] * plane->align_elevation;
-      break;
-    case GST_VIDEO_FORMAT_NV16:
-      plane->stride[0] = plane->align_stride0;
-      plane->stride[1] = plane->stride[0];
-      plane->offset[0] = 0;
-      plane->offset[1] = plane->stride[0] * plane->align_elevation;
-      plane->align_size = plane->stride[0] * plane->align_elevation * 2;
-      break;
-    case GST_VIDEO_FORMAT_RGB:
-    case GST_VIDEO_FORMAT_v308:
-    case GST_VIDEO_FORMAT_BGR:
-      plane->stride[0] = plane->align_stride0;
-      plane->offset[0] = 0;
-      plane->align_size = plane->stride[0] * plane->align_elevation;
-      break;
-    case GST_VIDEO_FORMAT_I422_10LE:
-      plane->stride[0] = plane->align_stride0;
-      plane->stride[1] = ALIGN (GST_VIDEO_INFO_PLANE_STRIDE (info, 1),
-		      xpool->priv->stride_align);
-      plane->stride[2] = plane->stride[1];
-      plane->offset[0] = 0;
-      plane->offset[1] = plane->stride[0] * plane->align_elevation;
-      plane->offset[2] = plane->offset[1] + plane->stride[1] * plane->align_elevation;
-      plane->align_size = plane->offset[2] + plane->stride[2] * plane->align_elevation;
-      break;
-    case GST_VIDEO_FORMAT_NV12_10LE32:
-      plane->stride[0] = plane->stride[1] = plane->align_stride0;
-      plane->offset[0] = 0;
-      plane->offset[1] = plane->offset[0] + plane->stride[0] * plane->align_elevation;
-      plane->align_size = (plane->align_stride0 * plane->align_elevation * 3) >> 1;
-      break;
-    case GST_VIDEO_FORMAT_GRAY8:
-      plane->stride[0] = plane->align_stride0;
-      plane->offset[0] = 0;
-      plane->align_size = plane->stride[0] * plane->align_elevation;
-      break;
-    case GST_VIDEO_FORMAT_GRAY10_LE32:
-      plane->stride[0] = plane->align_stride0;
-      plane->offset[0] = 0;
-      plane->align_size = plane->stride[0] * GST_ROUND_UP_2(plane->align_elevation);
-      break;
-    case GST_VIDEO_FORMAT_UYVY:
-      plane->stride[0] = plane->align_stride0;
-      plane->offset[0] = 0;
-      plane->align_size = plane->stride[0] * plane->align_elevation;
-      break;
-    case GST_VIDEO_FORMAT_I420:
-      plane->stride[0] = plane->align_stride0;
-      plane->stride[1] = ALIGN (GST_VIDEO_INFO_PLANE_STRIDE (info, 1),
-		             xpool->priv->stride_align);
-      plane->stride[2] = plane->stride[1];
-      plane->offset[0] = 0;
-      plane->offset[1] = plane->stride[0] * plane->align_elevation;
-      plane->offset[2] = plane->offset[1] + plane->stride[1] * (plane->align_elevation / 2);
-      plane->align_size = plane->offset[2] + plane->stride[2] * (plane->align_elevation / 2);
-      break;
-    case GST_VIDEO_FORMAT_I420_10LE:
-      plane->stride[0] = plane->align_stride0;
-      plane->stride[1] = ALIGN (GST_VIDEO_INFO_PLANE_STRIDE (info, 1),
-		             xpool->priv->stride_align);
-      plane->stride[2] = plane->stride[1];
-      plane->offset[0] = 0;
-      plane->offset[1] = plane->stride[0] * (plane->align_elevation);
-      plane->offset[2] = plane->offset[1] + plane->stride[1] * (plane->align_elevation / 2);
-      plane->align_size = plane->offset[2] + plane->stride[2] * (plane->align_elevation / 2);
-      break;
-    default:
-      GST_ERROR_OBJECT (pool, "not yet supporting format %d", GST_VIDEO_INFO_FORMAT (info));
-      return FALSE;
-  }
-
- return TRUE;
-
-}
+        "IVAS buffer pool");
+    GST_DEBUG_CATEGORY_INIT (gst_ivas_buffer_pool_stats_debug,
+        "ivaspoolstats", 0, "IVAS buffer pool statistics"));
 
 static gboolean
 gst_ivas_buffer_pool_set_config (GstBufferPool * pool, GstStructure * config)
@@ -176,7 +118,7 @@ gst_ivas_buffer_pool_set_config (GstBufferPool * pool, GstStructure * config)
   GstAllocator *allocator;
   GstAllocationParams params;
   guint size, min_buffers, max_buffers;
-  planes_vals plane;
+  GstIvasVideoLayout layout;
 
   xpool = GST_IVAS_BUFFER_POOL_CAST (pool);
   priv = xpool->priv;
@@ -210,23 +152,37 @@ gst_ivas_buffer_pool_set_config (GstBufferPool * pool, GstStructure * config)
   priv->add_videometa = gst_buffer_pool_config_has_option (config,
       GST_BUFFER_POOL_OPTION_VIDEO_META);
 
+  if (!priv->add_videometa
+      && (priv->stride_align > 1 || priv->elevation_align > 1)) {
+    /* the alignment is what the hardware needs, so describe the padding
+     * with video meta instead of giving it up */
+    GST_DEBUG_OBJECT (pool, "stride align %u, elevation align %u, forcing "
+        "video meta", priv->stride_align, priv->elevation_align);
+    gst_buffer_pool_config_add_option (config,
+        GST_BUFFER_POOL_OPTION_VIDEO_META);
+    priv->add_videometa = TRUE;
+  }
+
   vinfo.size = MAX (size, vinfo.size);
 
-  if (fill_planes_vals (&vinfo, pool, &plane) != TRUE)
-    return FALSE;
+  if (!gst_ivas_video_layout_compute (&vinfo, priv->stride_align,
+          priv->elevation_align, &layout))
+    goto unsupported_format;
 
-  vinfo.size = MAX (plane.align_size, vinfo.size);
+  vinfo.size = MAX (layout.size, vinfo.size);
 
   GST_LOG_OBJECT (pool,
-      "fmt = %d, stride = %d, align_elevation = %d, align_size = %d",
-      GST_VIDEO_INFO_FORMAT (&vinfo), plane.stride[0],
-      plane.align_elevation, plane.align_size);
+      "fmt = %d, stride = %d, align_elevation = %u, align_size = %lu",
+      GST_VIDEO_INFO_FORMAT (&vinfo), layout.stride[0],
+      layout.elevation, layout.size);
   GST_LOG_OBJECT (pool, "max buffer size %lu", vinfo.size);
 
   gst_buffer_pool_config_set_params (config, caps, vinfo.size, min_buffers,
       max_buffers);
 
   priv->vinfo = vinfo;
+  priv->min_buffers = min_buffers;
+  priv->max_buffers = max_buffers;
 
   return GST_BUFFER_POOL_CLASS (parent_class)->set_config (pool, config);
 
@@ -252,6 +208,12 @@ no_allocator:
     GST_WARNING_OBJECT (pool, "no valid allocator in pool");
     return FALSE;
   }
+unsupported_format:
+  {
+    GST_ERROR_OBJECT (pool, "not yet supporting format %s",
+        gst_video_format_to_string (GST_VIDEO_INFO_FORMAT (&vinfo)));
+    return FALSE;
+  }
 }
 
 static GstFlowReturn
@@ -261,18 +223,19 @@ gst_ivas_buffer_pool_alloc_buffer (GstBufferPool * pool, GstBuffer ** buffer,
   GstIvasBufferPool *xpool;
   GstIvasBufferPoolPrivate *priv;
   GstVideoInfo *info;
-  planes_vals plane;
+  GstIvasVideoLayout layout;
 
   xpool = GST_IVAS_BUFFER_POOL_CAST (pool);
   priv = xpool->priv;
   info = &priv->vinfo;
 
-  if (fill_planes_vals (info, pool, &plane) != TRUE)
+  if (!gst_ivas_video_layout_compute (info, priv->stride_align,
+          priv->elevation_align, &layout))
     g_assert_not_reached ();
 
   GST_LOG_OBJECT (pool,
       "fmt = %d, stride = %d, align_elevation = %d, size = %lu",
-      GST_VIDEO_INFO_FORMAT (info), plane.stride[0], plane.align_elevation, info->size);
+      GST_VIDEO_INFO_FORMAT (info), layout.stride[0], layout.elevation, info->size);
   GST_DEBUG_OBJECT (pool, "alloc %lu", info->size);
 
   *buffer =
@@ -280,13 +243,21 @@ gst_ivas_buffer_pool_alloc_buffer (GstBufferPool * pool, GstBuffer ** buffer,
   if (*buffer == NULL)
     goto no_memory;
 
+  g_mutex_lock (&priv->stats_lock);
+  if (priv->starting)
+    priv->stats.n_prealloc++;
+  else
+    priv->stats.n_alloc++;
+  priv->n_alive++;
+  g_mutex_unlock (&priv->stats_lock);
+
   if (priv->add_videometa) {
     GST_DEBUG_OBJECT (pool, "adding GstVideoMeta");
 
     gst_buffer_add_video_meta_full (*buffer, GST_VIDEO_FRAME_FLAG_NONE,
         GST_VIDEO_INFO_FORMAT (info),
         GST_VIDEO_INFO_WIDTH (info), GST_VIDEO_INFO_HEIGHT (info),
-        GST_VIDEO_INFO_N_PLANES (info), plane.offset, plane.stride);
+        GST_VIDEO_INFO_N_PLANES (info), layout.offset, layout.stride);
   }
   return GST_FLOW_OK;
 
@@ -298,10 +269,246 @@ no_memory:
   }
 }
 
+static GstStructure *
+ivas_pool_stats_to_structure (GstIvasBufferPoolPrivate * priv, GstClockTime now)
+{
+  IvasPoolStats *st = &priv->stats;
+  GstClockTime oldest = 0;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, priv->acquired);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    GstClockTime ts = *(GstClockTime *) value;
+    if (now > ts && now - ts > oldest)
+      oldest = now - ts;
+  }
+
+  return gst_structure_new (IVAS_STATS_STRUCT_NAME,
+      "outstanding", G_TYPE_UINT, st->outstanding,
+      "high-water", G_TYPE_UINT, st->high_water,
+      "acquired", G_TYPE_UINT64, st->n_acquired,
+      "preallocated", G_TYPE_UINT64, st->n_prealloc,
+      "allocated", G_TYPE_UINT64, st->n_alloc,
+      "reused", G_TYPE_UINT64,
+      st->n_acquired > st->n_alloc ? st->n_acquired - st->n_alloc : 0,
+      "acquire-wait-total", G_TYPE_UINT64, st->wait_total,
+      "acquire-wait-max", G_TYPE_UINT64, st->wait_max,
+      "age-avg", G_TYPE_UINT64,
+      st->n_released ? st->age_total / st->n_released : 0,
+      "age-max", G_TYPE_UINT64, st->age_max,
+      "oldest-outstanding", G_TYPE_UINT64, oldest,
+      "allocated-buffers", G_TYPE_UINT, priv->n_alive,
+      "limit", G_TYPE_UINT, priv->adaptive ? priv->cur_limit : priv->max_buffers,
+      NULL);
+}
+
+/* called with stats_lock */
+static void
+ivas_pool_stats_dump (GstBufferPool * pool, GstClockTime now)
+{
+  GstIvasBufferPoolPrivate *priv = GST_IVAS_BUFFER_POOL_CAST (pool)->priv;
+  GstStructure *st;
+
+  if (gst_debug_category_get_threshold (gst_ivas_buffer_pool_stats_debug) <
+      GST_LEVEL_INFO)
+    return;
+
+  st = ivas_pool_stats_to_structure (priv, now);
+  GST_CAT_INFO_OBJECT (gst_ivas_buffer_pool_stats_debug, pool,
+      "%" GST_PTR_FORMAT, st);
+  gst_structure_free (st);
+}
+
+/* called with stats_lock. Waits until a buffer may be handed out under the
+ * adaptive limit, raising the limit when the wait exceeds grow_threshold */
+static gboolean
+ivas_pool_wait_slot (GstBufferPool * pool)
+{
+  GstIvasBufferPoolPrivate *priv = GST_IVAS_BUFFER_POOL_CAST (pool)->priv;
+  gint64 deadline;
+
+  deadline = g_get_monotonic_time () + priv->grow_threshold / GST_USECOND;
+
+  while (priv->stats.outstanding >= priv->cur_limit) {
+    if (priv->flushing)
+      return FALSE;
+
+    /* at the hard limit the parent pool does the blocking */
+    if (priv->max_buffers && priv->cur_limit >= priv->max_buffers)
+      return TRUE;
+
+    if (!g_cond_wait_until (&priv->slot_cond, &priv->stats_lock, deadline)) {
+      priv->cur_limit++;
+      GST_INFO_OBJECT (pool, "acquire blocked for more than %" GST_TIME_FORMAT
+          ", growing pool to %u buffers", GST_TIME_ARGS (priv->grow_threshold),
+          priv->cur_limit);
+      deadline = g_get_monotonic_time () + priv->grow_threshold / GST_USECOND;
+    }
+  }
+
+  return TRUE;
+}
+
+/* called with stats_lock. Lowers the limit when the peak occupancy of the
+ * last shrink_period left more than one buffer unused and returns how many
+ * idle buffers should be freed */
+static guint
+ivas_pool_check_shrink (GstBufferPool * pool, GstClockTime now)
+{
+  GstIvasBufferPoolPrivate *priv = GST_IVAS_BUFFER_POOL_CAST (pool)->priv;
+  guint target, n_trim = 0;
+
+  if (now - priv->window_start < priv->shrink_period)
+    return 0;
+
+  target = MAX (priv->window_peak + 1, MAX (priv->min_buffers, 1));
+  if (target < priv->cur_limit) {
+    GST_INFO_OBJECT (pool, "peak occupancy %u over the last %" GST_TIME_FORMAT
+        ", shrinking pool from %u to %u buffers", priv->window_peak,
+        GST_TIME_ARGS (priv->shrink_period), priv->cur_limit, target);
+    priv->cur_limit = target;
+  }
+
+  if (priv->n_alive > priv->cur_limit && !priv->trimming) {
+    n_trim = priv->n_alive - priv->cur_limit;
+    priv->trimming = TRUE;
+  }
+
+  priv->window_start = now;
+  priv->window_peak = priv->stats.outstanding;
+
+  return n_trim;
+}
+
+/* frees idle buffers held by the parent pool and hands their device memory
+ * back, must be called without stats_lock as the parent calls into
+ * alloc_buffer/free_buffer */
+static void
+ivas_pool_trim (GstBufferPool * pool, guint n_trim)
+{
+  GstIvasBufferPoolPrivate *priv = GST_IVAS_BUFFER_POOL_CAST (pool)->priv;
+  GstBufferPoolClass *pclass = GST_BUFFER_POOL_CLASS (parent_class);
+  GstBufferPoolAcquireParams params = { GST_FORMAT_UNDEFINED, 0, 0,
+    GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT
+  };
+  GstBuffer *buffer;
+  guint freed = 0, trimmed = 0;
+  gboolean idle;
+
+  while (freed < n_trim) {
+    g_mutex_lock (&priv->stats_lock);
+    idle = priv->n_alive > priv->stats.outstanding;
+    g_mutex_unlock (&priv->stats_lock);
+    if (!idle)
+      break;
+
+    if (pclass->acquire_buffer (pool, &buffer, &params) != GST_FLOW_OK)
+      break;
+
+    /* tagged memory makes the parent free the buffer instead of queuing */
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_TAG_MEMORY);
+    pclass->release_buffer (pool, buffer);
+    freed++;
+  }
+
+  if (freed)
+    trimmed = gst_ivas_allocator_trim (GST_IVAS_ALLOCATOR (priv->allocator),
+        freed);
+
+  GST_DEBUG_OBJECT (pool, "freed %u idle buffers, %u memories back to device",
+      freed, trimmed);
+
+  g_mutex_lock (&priv->stats_lock);
+  priv->trimming = FALSE;
+  g_mutex_unlock (&priv->stats_lock);
+}
+
+static GstFlowReturn
+gst_ivas_buffer_pool_acquire_buffer (GstBufferPool * pool,
+    GstBuffer ** buffer, GstBufferPoolAcquireParams * params)
+{
+  GstIvasBufferPoolPrivate *priv = GST_IVAS_BUFFER_POOL_CAST (pool)->priv;
+  GstClockTime start, now, wait;
+  GstClockTime *ts;
+  GstFlowReturn fret;
+  guint n_trim = 0;
+
+  start = gst_util_get_timestamp ();
+
+  /* reserve the slot first so concurrent acquires see it in the limit */
+  g_mutex_lock (&priv->stats_lock);
+  if (priv->adaptive && !(params
+          && (params->flags & GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT))
+      && !ivas_pool_wait_slot (pool)) {
+    g_mutex_unlock (&priv->stats_lock);
+    return GST_FLOW_FLUSHING;
+  }
+  priv->stats.outstanding++;
+  g_mutex_unlock (&priv->stats_lock);
+
+  fret = GST_BUFFER_POOL_CLASS (parent_class)->acquire_buffer (pool, buffer,
+      params);
+
+  now = gst_util_get_timestamp ();
+  wait = now - start;
+
+  g_mutex_lock (&priv->stats_lock);
+  if (fret != GST_FLOW_OK) {
+    priv->stats.outstanding--;
+    g_cond_signal (&priv->slot_cond);
+    g_mutex_unlock (&priv->stats_lock);
+    return fret;
+  }
+
+  ts = g_slice_new (GstClockTime);
+  *ts = now;
+  g_hash_table_insert (priv->acquired, *buffer, ts);
+
+  priv->stats.high_water =
+      MAX (priv->stats.high_water, priv->stats.outstanding);
+  priv->stats.n_acquired++;
+  priv->stats.wait_total += wait;
+  priv->stats.wait_max = MAX (priv->stats.wait_max, wait);
+
+  if (priv->adaptive) {
+    priv->window_peak = MAX (priv->window_peak, priv->stats.outstanding);
+    n_trim = ivas_pool_check_shrink (pool, now);
+  }
+
+  if (priv->stats_interval && now - priv->last_dump >= priv->stats_interval) {
+    priv->last_dump = now;
+    ivas_pool_stats_dump (pool, now);
+  }
+  g_mutex_unlock (&priv->stats_lock);
+
+  if (n_trim)
+    ivas_pool_trim (pool, n_trim);
+
+  return fret;
+}
+
 static void
 gst_ivas_buffer_pool_release_buffer (GstBufferPool * pool, GstBuffer * buffer)
 {
   GstIvasBufferPool *xpool = GST_IVAS_BUFFER_POOL_CAST (pool);
+  GstIvasBufferPoolPrivate *priv = xpool->priv;
+  GstClockTime *ts;
+
+  /* preallocated buffers are released by start() without being acquired */
+  g_mutex_lock (&priv->stats_lock);
+  ts = g_hash_table_lookup (priv->acquired, buffer);
+  if (ts) {
+    GstClockTime age = gst_util_get_timestamp () - *ts;
+
+    priv->stats.outstanding--;
+    priv->stats.n_released++;
+    priv->stats.age_total += age;
+    priv->stats.age_max = MAX (priv->stats.age_max, age);
+    g_hash_table_remove (priv->acquired, buffer);
+    g_cond_signal (&priv->slot_cond);
+  }
+  g_mutex_unlock (&priv->stats_lock);
 
   if (xpool->pre_release_cb)
     xpool->pre_release_cb (buffer, xpool->pre_cb_user_data);
@@ -313,6 +520,45 @@ gst_ivas_buffer_pool_release_buffer (GstBufferPool * pool, GstBuffer * buffer)
 
 }
 
+static void
+gst_ivas_buffer_pool_free_buffer (GstBufferPool * pool, GstBuffer * buffer)
+{
+  GstIvasBufferPoolPrivate *priv = GST_IVAS_BUFFER_POOL_CAST (pool)->priv;
+
+  g_mutex_lock (&priv->stats_lock);
+  priv->n_alive--;
+  g_mutex_unlock (&priv->stats_lock);
+
+  GST_BUFFER_POOL_CLASS (parent_class)->free_buffer (pool, buffer);
+}
+
+static void
+gst_ivas_buffer_pool_flush_start (GstBufferPool * pool)
+{
+  GstIvasBufferPoolPrivate *priv = GST_IVAS_BUFFER_POOL_CAST (pool)->priv;
+
+  g_mutex_lock (&priv->stats_lock);
+  priv->flushing = TRUE;
+  g_cond_broadcast (&priv->slot_cond);
+  g_mutex_unlock (&priv->stats_lock);
+
+  if (GST_BUFFER_POOL_CLASS (parent_class)->flush_start)
+    GST_BUFFER_POOL_CLASS (parent_class)->flush_start (pool);
+}
+
+static void
+gst_ivas_buffer_pool_flush_stop (GstBufferPool * pool)
+{
+  GstIvasBufferPoolPrivate *priv = GST_IVAS_BUFFER_POOL_CAST (pool)->priv;
+
+  g_mutex_lock (&priv->stats_lock);
+  priv->flushing = FALSE;
+  g_mutex_unlock (&priv->stats_lock);
+
+  if (GST_BUFFER_POOL_CLASS (parent_class)->flush_stop)
+    GST_BUFFER_POOL_CLASS (parent_class)->flush_stop (pool);
+}
+
 static void
 gst_ivas_buffer_pool_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -326,6 +572,47 @@ gst_ivas_buffer_pool_set_property (GObject * object, guint prop_id,
     case PROP_ELEVATION_ALIGN:
       xpool->priv->elevation_align = g_value_get_uint (value);
       break;
+    case PROP_STATS_INTERVAL:
+      xpool->priv->stats_interval =
+          g_value_get_uint (value) * GST_MSECOND;
+      break;
+    case PROP_ADAPTIVE:
+      xpool->priv->adaptive = g_value_get_boolean (value);
+      break;
+    case PROP_GROW_THRESHOLD:
+      xpool->priv->grow_threshold = g_value_get_uint (value) * GST_MSECOND;
+      break;
+    case PROP_SHRINK_PERIOD:
+      xpool->priv->shrink_period = g_value_get_uint (value) * GST_MSECOND;
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_ivas_buffer_pool_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstIvasBufferPool *xpool = GST_IVAS_BUFFER_POOL (object);
+
+  switch (prop_id) {
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, xpool->priv->stats_interval / GST_MSECOND);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_ivas_buffer_pool_get_stats (xpool));
+      break;
+    case PROP_ADAPTIVE:
+      g_value_set_boolean (value, xpool->priv->adaptive);
+      break;
+    case PROP_GROW_THRESHOLD:
+      g_value_set_uint (value, xpool->priv->grow_threshold / GST_MSECOND);
+      break;
+    case PROP_SHRINK_PERIOD:
+      g_value_set_uint (value, xpool->priv->shrink_period / GST_MSECOND);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -354,14 +641,29 @@ gst_ivas_buffer_pool_start (GstBufferPool * bpool)
   ivas_alloc = (GstIvasAllocator *) ivas_pool->priv->allocator;
   params = &ivas_pool->priv->params;
 
+  g_mutex_lock (&ivas_pool->priv->stats_lock);
+  memset (&ivas_pool->priv->stats, 0, sizeof (IvasPoolStats));
+  g_hash_table_remove_all (ivas_pool->priv->acquired);
+  ivas_pool->priv->last_dump = gst_util_get_timestamp ();
+  ivas_pool->priv->window_start = ivas_pool->priv->last_dump;
+  ivas_pool->priv->window_peak = 0;
+  ivas_pool->priv->cur_limit = MAX (min_buffers, 1);
+  ivas_pool->priv->flushing = FALSE;
+  g_mutex_unlock (&ivas_pool->priv->stats_lock);
+
   if (!gst_ivas_allocator_start (ivas_alloc, min_buffers, max_buffers, size,
           params)) {
     GST_ERROR_OBJECT (bpool, "failed to start buffer pool");
     goto error;
   }
 
-  if (!pclass->start (bpool))
+  /* parent start preallocates min_buffers, account them separately */
+  ivas_pool->priv->starting = TRUE;
+  if (!pclass->start (bpool)) {
+    ivas_pool->priv->starting = FALSE;
     goto error;
+  }
+  ivas_pool->priv->starting = FALSE;
 
   GST_DEBUG_OBJECT (bpool, "successfully started pool %" GST_PTR_FORMAT, bpool);
   gst_structure_free (config);
@@ -383,6 +685,10 @@ gst_ivas_buffer_pool_stop (GstBufferPool * bpool)
 
   GST_DEBUG_OBJECT (bpool, "stopping pool");
 
+  g_mutex_lock (&ivas_pool->priv->stats_lock);
+  ivas_pool_stats_dump (bpool, gst_util_get_timestamp ());
+  g_mutex_unlock (&ivas_pool->priv->stats_lock);
+
   bret = pclass->stop (bpool);
   if (bret && ivas_pool->priv->allocator) {
     bret =
@@ -393,10 +699,31 @@ gst_ivas_buffer_pool_stop (GstBufferPool * bpool)
   return bret;
 }
 
+static void
+ivas_pool_free_timestamp (gpointer data)
+{
+  g_slice_free (GstClockTime, data);
+}
+
 static void
 gst_ivas_buffer_pool_init (GstIvasBufferPool * pool)
 {
+  const gchar *interval;
+
   pool->priv = gst_ivas_buffer_pool_get_instance_private (pool);
+
+  g_mutex_init (&pool->priv->stats_lock);
+  g_cond_init (&pool->priv->slot_cond);
+  pool->priv->grow_threshold = DEFAULT_GROW_THRESHOLD * GST_MSECOND;
+  pool->priv->shrink_period = DEFAULT_SHRINK_PERIOD * GST_MSECOND;
+  pool->priv->adaptive = g_strcmp0 (g_getenv (IVAS_ADAPTIVE_ENV), "1") == 0;
+  pool->priv->acquired = g_hash_table_new_full (NULL, NULL, NULL,
+      ivas_pool_free_timestamp);
+
+  interval = g_getenv (IVAS_STATS_INTERVAL_ENV);
+  if (interval)
+    pool->priv->stats_interval =
+        g_ascii_strtoull (interval, NULL, 10) * GST_MSECOND;
 }
 
 static void
@@ -409,6 +736,10 @@ gst_ivas_buffer_pool_finalize (GObject * object)
   if (pool->priv->allocator)
     gst_object_unref (pool->priv->allocator);
 
+  g_hash_table_unref (pool->priv->acquired);
+  g_cond_clear (&pool->priv->slot_cond);
+  g_mutex_clear (&pool->priv->stats_lock);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -420,11 +751,16 @@ gst_ivas_buffer_pool_class_init (GstIvasBufferPoolClass * klass)
 
   gobject_class = G_OBJECT_CLASS (klass);
   gobject_class->set_property = gst_ivas_buffer_pool_set_property;
+  gobject_class->get_property = gst_ivas_buffer_pool_get_property;
   gobject_class->finalize = gst_ivas_buffer_pool_finalize;
 
   gstbufferpool_class = (GstBufferPoolClass *) klass;
   gstbufferpool_class->set_config = gst_ivas_buffer_pool_set_config;
   gstbufferpool_class->alloc_buffer = gst_ivas_buffer_pool_alloc_buffer;
+  gstbufferpool_class->acquire_buffer = gst_ivas_buffer_pool_acquire_buffer;
+  gstbufferpool_class->free_buffer = gst_ivas_buffer_pool_free_buffer;
+  gstbufferpool_class->flush_start = gst_ivas_buffer_pool_flush_start;
+  gstbufferpool_class->flush_stop = gst_ivas_buffer_pool_flush_stop;
   gstbufferpool_class->release_buffer = gst_ivas_buffer_pool_release_buffer;
   gstbufferpool_class->start = gst_ivas_buffer_pool_start;
   gstbufferpool_class->stop = gst_ivas_buffer_pool_stop;
@@ -438,6 +774,35 @@ gst_ivas_buffer_pool_class_init (GstIvasBufferPoolClass * klass)
       g_param_spec_uint ("elevation-align", "Elevation alignment of buffer",
           "Elevation alignment of buffer", 0, G_MAXUINT,
           0, G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval", "Statistics dump interval",
+          "Interval in ms for logging pool statistics to the ivaspoolstats "
+          "debug category (0 = only at stop)", 0, G_MAXUINT,
+          0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Occupancy, acquire wait and recycle statistics of the pool",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ADAPTIVE,
+      g_param_spec_boolean ("adaptive", "Adaptive sizing",
+          "Grow the pool when acquire blocks and shrink it after sustained "
+          "low occupancy, within the configured min/max buffers", FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_GROW_THRESHOLD,
+      g_param_spec_uint ("grow-threshold", "Grow threshold",
+          "Time in ms acquire may block before the pool grows by a buffer",
+          0, G_MAXUINT, DEFAULT_GROW_THRESHOLD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SHRINK_PERIOD,
+      g_param_spec_uint ("shrink-period", "Shrink period",
+          "Window in ms over which peak occupancy decides shrinking", 1,
+          G_MAXUINT, DEFAULT_SHRINK_PERIOD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 GstBufferPool *
@@ -468,3 +833,154 @@ gst_ivas_buffer_pool_set_post_release_buffer_cb (GstIvasBufferPool * xpool,
   xpool->post_release_cb = release_buf_cb;
   xpool->post_cb_user_data = user_data;
 }
+
+/* Greatest common divisor based LCM, 0 and 1 mean no requirement */
+guint
+gst_ivas_buffer_pool_lcm_align (guint a, guint b)
+{
+  guint x, y, t;
+
+  if (a <= 1)
+    return MAX (b, 1);
+  if (b <= 1)
+    return a;
+
+  x = a;
+  y = b;
+  while (y) {
+    t = x % y;
+    x = y;
+    y = t;
+  }
+
+  return (a / x) * b;
+}
+
+GType
+gst_ivas_buffer_pool_align_api_get_type (void)
+{
+  static volatile GType type = 0;
+  static const gchar *tags[] = { GST_META_TAG_VIDEO_STR, NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type =
+        gst_meta_api_type_register ("GstIvasBufferPoolAlignAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+/* Adds the alignment needed by the caller to an ALLOCATION query. An
+ * existing requirement in the query is merged in, so an element can forward
+ * what its downstream asked for together with its own needs */
+void
+gst_ivas_buffer_pool_query_add_align (GstQuery * query, guint stride_align,
+    guint elevation_align)
+{
+  guint idx, cur_stride = 1, cur_elevation = 1;
+  GstStructure *params;
+
+  g_return_if_fail (GST_QUERY_TYPE (query) == GST_QUERY_ALLOCATION);
+
+  if (gst_query_find_allocation_meta (query,
+          GST_IVAS_BUFFER_POOL_ALIGN_API_TYPE, &idx)) {
+    gst_ivas_buffer_pool_query_get_align (query, &cur_stride, &cur_elevation);
+    gst_query_remove_nth_allocation_meta (query, idx);
+  }
+
+  params = gst_structure_new (IVAS_ALIGN_STRUCT_NAME,
+      "stride-align", G_TYPE_UINT,
+      gst_ivas_buffer_pool_lcm_align (cur_stride, stride_align),
+      "elevation-align", G_TYPE_UINT,
+      gst_ivas_buffer_pool_lcm_align (cur_elevation, elevation_align), NULL);
+  gst_query_add_allocation_meta (query, GST_IVAS_BUFFER_POOL_ALIGN_API_TYPE,
+      params);
+  gst_structure_free (params);
+}
+
+/* Reads the alignment downstream asked for, 1 when it asked for none */
+gboolean
+gst_ivas_buffer_pool_query_get_align (GstQuery * query, guint * stride_align,
+    guint * elevation_align)
+{
+  const GstStructure *params = NULL;
+  guint idx;
+
+  *stride_align = 1;
+  *elevation_align = 1;
+
+  if (!gst_query_find_allocation_meta (query,
+          GST_IVAS_BUFFER_POOL_ALIGN_API_TYPE, &idx))
+    return FALSE;
+
+  gst_query_parse_nth_allocation_meta (query, idx, &params);
+  if (!params)
+    return FALSE;
+
+  gst_structure_get_uint (params, "stride-align", stride_align);
+  gst_structure_get_uint (params, "elevation-align", elevation_align);
+  *stride_align = MAX (*stride_align, 1);
+  *elevation_align = MAX (*elevation_align, 1);
+
+  return TRUE;
+}
+
+/* Decides the pool an IVAS element allocates its output from. A pool
+ * proposed by downstream is shared when it is an IVAS pool whose alignment
+ * already satisfies the LCM of both sides, so both elements see the same
+ * plane layout. Otherwise a new IVAS pool is made with the LCM alignment.
+ * Returns a new reference, the proposed pool reference is not consumed */
+GstBufferPool *
+gst_ivas_buffer_pool_negotiate (GstQuery * query, GstBufferPool * proposed,
+    guint stride_align, guint elevation_align)
+{
+  guint ds_stride, ds_elevation;
+  GstIvasBufferPool *xpool;
+
+  gst_ivas_buffer_pool_query_get_align (query, &ds_stride, &ds_elevation);
+  stride_align = gst_ivas_buffer_pool_lcm_align (stride_align, ds_stride);
+  elevation_align =
+      gst_ivas_buffer_pool_lcm_align (elevation_align, ds_elevation);
+
+  if (proposed && GST_IS_IVAS_BUFFER_POOL (proposed)) {
+    guint pool_stride, pool_elevation;
+
+    xpool = GST_IVAS_BUFFER_POOL_CAST (proposed);
+    gst_ivas_buffer_pool_get_align (xpool, &pool_stride, &pool_elevation);
+    if (pool_stride % stride_align == 0
+        && pool_elevation % elevation_align == 0) {
+      GST_DEBUG_OBJECT (proposed, "sharing pool, stride align %u, elevation "
+          "align %u", pool_stride, pool_elevation);
+      return gst_object_ref (proposed);
+    }
+  }
+
+  GST_DEBUG ("new pool with stride align %u, elevation align %u",
+      stride_align, elevation_align);
+
+  return gst_ivas_buffer_pool_new (stride_align, elevation_align);
+}
+
+void
+gst_ivas_buffer_pool_get_align (GstIvasBufferPool * xpool,
+    guint * stride_align, guint * elevation_align)
+{
+  *stride_align = MAX (xpool->priv->stride_align, 1);
+  *elevation_align = MAX (xpool->priv->elevation_align, 1);
+}
+
+/* Returns a snapshot of the pool counters as a "GstIvasBufferPoolStats"
+ * structure, times are in nanoseconds. Free with gst_structure_free() */
+GstStructure *
+gst_ivas_buffer_pool_get_stats (GstIvasBufferPool * xpool)
+{
+  GstStructure *st;
+
+  g_return_val_if_fail (GST_IS_IVAS_BUFFER_POOL (xpool), NULL);
+
+  g_mutex_lock (&xpool->priv->stats_lock);
+  st = ivas_pool_stats_to_structure (xpool->priv, gst_util_get_timestamp ());
+  g_mutex_unlock (&xpool->priv->stats_lock);
+
+  return st;
+}
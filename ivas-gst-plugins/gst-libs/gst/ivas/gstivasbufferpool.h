@@ -65,6 +65,30 @@ void gst_ivas_buffer_pool_set_pre_release_buffer_cb (GstIvasBufferPool *xpool, P
 GST_EXPORT
 void gst_ivas_buffer_pool_set_post_release_buffer_cb (GstIvasBufferPool *xpool, PostReleaseBufferCallback post_release_cb, gpointer user_data);
 
+#define GST_IVAS_BUFFER_POOL_ALIGN_API_TYPE \
+  (gst_ivas_buffer_pool_align_api_get_type())
+
+GST_EXPORT
+GType gst_ivas_buffer_pool_align_api_get_type (void);
+
+GST_EXPORT
+guint gst_ivas_buffer_pool_lcm_align (guint a, guint b);
+
+GST_EXPORT
+void gst_ivas_buffer_pool_query_add_align (GstQuery *query, guint stride_align, guint elevation_align);
+
+GST_EXPORT
+gboolean gst_ivas_buffer_pool_query_get_align (GstQuery *query, guint *stride_align, guint *elevation_align);
+
+GST_EXPORT
+GstBufferPool *gst_ivas_buffer_pool_negotiate (GstQuery *query, GstBufferPool *proposed, guint stride_align, guint elevation_align);
+
+GST_EXPORT
+void gst_ivas_buffer_pool_get_align (GstIvasBufferPool *xpool, guint *stride_align, guint *elevation_align);
+
+GST_EXPORT
+GstStructure *gst_ivas_buffer_pool_get_stats (GstIvasBufferPool *xpool);
+
 G_END_DECLS
 
 #endif /* __GST_IVAS_BUFFER_POOL_H__ */
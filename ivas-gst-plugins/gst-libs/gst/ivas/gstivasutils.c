@@ -23,8 +23,11 @@
  */
 
 #include <gst/video/video.h>
+#include <ivas/ivaslogs.h>
 #include "gstivasutils.h"
 
+GST_DEBUG_CATEGORY_STATIC (ivas_utils_log_debug);
+
 GstCaps *
 gst_ivas_utils_fixate_caps (GstElement * self,
     GstPadDirection direction, GstCaps * caps, GstCaps * othercaps)
@@ -484,3 +487,146 @@ done:
 
   return othercaps;
 }
+
+static void
+gst_ivas_utils_log_handler (int level, const char *file, const char *func,
+    int line, const char *msg, void *user_data)
+{
+  GstDebugLevel gst_level;
+
+  switch (level) {
+    case LOG_LEVEL_ERROR:
+      gst_level = GST_LEVEL_ERROR;
+      break;
+    case LOG_LEVEL_WARNING:
+      gst_level = GST_LEVEL_WARNING;
+      break;
+    case LOG_LEVEL_INFO:
+      gst_level = GST_LEVEL_INFO;
+      break;
+    default:
+      gst_level = GST_LEVEL_DEBUG;
+      break;
+  }
+
+  gst_debug_log (ivas_utils_log_debug, gst_level, file, func, line, NULL,
+      "%s", msg);
+}
+
+/* Sends messages logged through the ivas-utils logger (ivas_kernel_utils
+ * and kernel libraries) to the "ivasutils" GStreamer debug category
+ * instead of stdout */
+void
+gst_ivas_utils_route_logs_to_gst (void)
+{
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init)) {
+    GST_DEBUG_CATEGORY_INIT (ivas_utils_log_debug, "ivasutils", 0,
+        "IVAS utils and kernel library messages");
+    ivas_log_set_handler (gst_ivas_utils_log_handler, NULL);
+    g_once_init_leave (&init, 1);
+  }
+}
+
+/* Serializes the instances driving one CU through kernel libraries, so
+ * their register programming does not interleave, while instances on
+ * other CUs go on. Locks live as long as the process, there is one per
+ * CU in use */
+struct _GstIvasCuLock
+{
+  guint dev_idx;
+  gint cu_idx;
+  GMutex lock;
+  /* updated with the lock held */
+  guint64 acquired;
+  guint64 contended;
+  GstClockTime wait_time;
+};
+
+GstIvasCuLock *
+gst_ivas_cu_lock_get (guint dev_idx, gint cu_idx)
+{
+  static GMutex locks_lock;
+  static GSList *locks;
+  GstIvasCuLock *cu_lock = NULL;
+  GSList *l;
+
+  g_mutex_lock (&locks_lock);
+  for (l = locks; l; l = l->next) {
+    GstIvasCuLock *entry = (GstIvasCuLock *) l->data;
+
+    if (entry->dev_idx == dev_idx && entry->cu_idx == cu_idx) {
+      cu_lock = entry;
+      break;
+    }
+  }
+
+  if (!cu_lock) {
+    cu_lock = g_new0 (GstIvasCuLock, 1);
+    cu_lock->dev_idx = dev_idx;
+    cu_lock->cu_idx = cu_idx;
+    g_mutex_init (&cu_lock->lock);
+    locks = g_slist_prepend (locks, cu_lock);
+  }
+  g_mutex_unlock (&locks_lock);
+
+  return cu_lock;
+}
+
+/* orders an array of GstIvasCuLock pointers, e.g. with qsort(). Taking
+ * several locks in this order avoids deadlocks between instances sharing
+ * some of their CUs */
+gint
+gst_ivas_cu_lock_compare (gconstpointer a, gconstpointer b)
+{
+  const GstIvasCuLock *la = *(const GstIvasCuLock * const *) a;
+  const GstIvasCuLock *lb = *(const GstIvasCuLock * const *) b;
+
+  if (la->dev_idx != lb->dev_idx)
+    return la->dev_idx < lb->dev_idx ? -1 : 1;
+  if (la->cu_idx != lb->cu_idx)
+    return la->cu_idx < lb->cu_idx ? -1 : 1;
+  return 0;
+}
+
+/* returns the time spent waiting for another instance, 0 if the CU was
+ * free */
+GstClockTime
+gst_ivas_cu_lock_acquire (GstIvasCuLock * cu_lock)
+{
+  GstClockTime wait = 0;
+  gint64 start;
+
+  if (!g_mutex_trylock (&cu_lock->lock)) {
+    start = g_get_monotonic_time ();
+    g_mutex_lock (&cu_lock->lock);
+    wait = (g_get_monotonic_time () - start) * GST_USECOND;
+    cu_lock->contended++;
+    cu_lock->wait_time += wait;
+  }
+  cu_lock->acquired++;
+
+  return wait;
+}
+
+void
+gst_ivas_cu_lock_release (GstIvasCuLock * cu_lock)
+{
+  g_mutex_unlock (&cu_lock->lock);
+}
+
+/* totals over all users of the lock since process start */
+void
+gst_ivas_cu_lock_get_stats (GstIvasCuLock * cu_lock, guint64 * acquired,
+    guint64 * contended, GstClockTime * wait_time)
+{
+  g_mutex_lock (&cu_lock->lock);
+  if (acquired)
+    *acquired = cu_lock->acquired;
+  if (contended)
+    *contended = cu_lock->contended;
+  if (wait_time)
+    *wait_time = cu_lock->wait_time;
+  g_mutex_unlock (&cu_lock->lock);
+}
@@ -18,8 +18,41 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#ifndef __GST_IVAS_UTILS_H__
+#define __GST_IVAS_UTILS_H__
+
 #include <gst/gst.h>
 
+G_BEGIN_DECLS
+
+/* cu_idx for a lock covering a device rather than one CU */
+#define GST_IVAS_CU_LOCK_DEVICE (-1)
+
+typedef struct _GstIvasCuLock GstIvasCuLock;
+
 GST_EXPORT
 GstCaps * gst_ivas_utils_fixate_caps (GstElement * self,
     GstPadDirection direction, GstCaps * caps, GstCaps * othercaps);
+
+GST_EXPORT
+void gst_ivas_utils_route_logs_to_gst (void);
+
+GST_EXPORT
+GstIvasCuLock * gst_ivas_cu_lock_get (guint dev_idx, gint cu_idx);
+
+GST_EXPORT
+gint gst_ivas_cu_lock_compare (gconstpointer a, gconstpointer b);
+
+GST_EXPORT
+GstClockTime gst_ivas_cu_lock_acquire (GstIvasCuLock * cu_lock);
+
+GST_EXPORT
+void gst_ivas_cu_lock_release (GstIvasCuLock * cu_lock);
+
+GST_EXPORT
+void gst_ivas_cu_lock_get_stats (GstIvasCuLock * cu_lock, guint64 * acquired,
+    guint64 * contended, GstClockTime * wait_time);
+
+G_END_DECLS
+
+#endif /* __GST_IVAS_UTILS_H__ */
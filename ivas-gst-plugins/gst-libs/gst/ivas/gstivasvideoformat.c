@@ -0,0 +1,146 @@
+/*
+ * Copyright 2020 Xilinx, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstivasvideoformat.h"
+
+/* alignments are LCMs of what each element needs, not always powers of 2 */
+#define ALIGN(size,align) ((align) > 1 ? \
+    (((size) + (align) - 1) / (align)) * (align) : (size))
+
+#define FORMAT(fmt, kfmt, n_planes, px, b0, b1, b2, w_sub, h_sub, round) \
+  [GST_VIDEO_FORMAT_ ## fmt] = { GST_VIDEO_FORMAT_ ## fmt, kfmt, n_planes, \
+    px, { b0, b1, b2 }, { 0, w_sub, w_sub }, { 0, h_sub, h_sub }, round }
+
+/* indexed by GstVideoFormat, entries with n_planes 0 are not supported.
+ * w_sub/h_sub apply to the chroma planes */
+static const GstIvasVideoFormatInfo formats[] = {
+  /* packed, single plane */
+  FORMAT (GRAY8, IVAS_VFMT_Y8, 1, 1, 1, 0, 0, 0, 0, 1),
+  FORMAT (GRAY10_LE32, IVAS_VFMT_Y10, 1, 3, 4, 0, 0, 0, 0, 2),
+  FORMAT (YUY2, IVAS_VFMT_YUYV8, 1, 2, 4, 0, 0, 0, 0, 1),
+  FORMAT (UYVY, IVAS_VFMT_UYVY8, 1, 2, 4, 0, 0, 0, 0, 1),
+  FORMAT (RGB, IVAS_VFMT_RGB8, 1, 1, 3, 0, 0, 0, 0, 1),
+  FORMAT (BGR, IVAS_VFMT_BGR8, 1, 1, 3, 0, 0, 0, 0, 1),
+  FORMAT (v308, IVAS_VFMT_YUV8, 1, 1, 3, 0, 0, 0, 0, 1),
+  FORMAT (RGBx, IVAS_VFMT_RGBX8, 1, 1, 4, 0, 0, 0, 0, 1),
+  FORMAT (BGRx, IVAS_VFMT_BGRX8, 1, 1, 4, 0, 0, 0, 0, 1),
+  FORMAT (RGBA, IVAS_VMFT_UNKNOWN, 1, 1, 4, 0, 0, 0, 0, 1),
+  FORMAT (BGRA, IVAS_VMFT_UNKNOWN, 1, 1, 4, 0, 0, 0, 0, 1),
+  FORMAT (ABGR, IVAS_VFMT_ABGR8, 1, 1, 4, 0, 0, 0, 0, 1),
+  FORMAT (ARGB, IVAS_VFMT_ARGB8, 1, 1, 4, 0, 0, 0, 0, 1),
+  FORMAT (r210, IVAS_VFMT_RGBX10, 1, 1, 4, 0, 0, 0, 0, 1),
+  FORMAT (Y410, IVAS_VMFT_UNKNOWN, 1, 1, 4, 0, 0, 0, 0, 1),
+  /* semi-planar */
+  FORMAT (NV12, IVAS_VFMT_Y_UV8_420, 2, 1, 1, 1, 0, 0, 1, 1),
+  FORMAT (NV16, IVAS_VFMT_Y_UV8, 2, 1, 1, 1, 0, 0, 0, 1),
+  FORMAT (NV12_10LE32, IVAS_VFMT_Y_UV10_420, 2, 3, 4, 4, 0, 0, 1, 1),
+  /* planar */
+  FORMAT (I420, IVAS_VMFT_UNKNOWN, 3, 1, 1, 1, 1, 1, 1, 1),
+  FORMAT (I420_10LE, IVAS_VMFT_UNKNOWN, 3, 1, 2, 2, 2, 1, 1, 1),
+  FORMAT (I422_10LE, IVAS_VMFT_UNKNOWN, 3, 1, 2, 2, 2, 1, 0, 1),
+};
+
+const GstIvasVideoFormatInfo *
+gst_ivas_video_format_get_info (GstVideoFormat format)
+{
+  if ((guint) format >= G_N_ELEMENTS (formats) || !formats[format].n_planes)
+    return NULL;
+
+  return &formats[format];
+}
+
+IVASVideoFormat
+gst_ivas_video_format_to_kernel (GstVideoFormat format)
+{
+  const GstIvasVideoFormatInfo *finfo = gst_ivas_video_format_get_info (format);
+
+  return finfo ? finfo->kernel_format : IVAS_VMFT_UNKNOWN;
+}
+
+GstVideoFormat
+gst_ivas_video_format_from_kernel (IVASVideoFormat kernel_format)
+{
+  guint i;
+
+  if (kernel_format == IVAS_VMFT_UNKNOWN)
+    return GST_VIDEO_FORMAT_UNKNOWN;
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+    if (formats[i].n_planes && formats[i].kernel_format == kernel_format)
+      return formats[i].format;
+  }
+
+  return GST_VIDEO_FORMAT_UNKNOWN;
+}
+
+/* bytes taken by width pixels in a row of plane, without any alignment */
+guint
+gst_ivas_video_format_row_bytes (const GstIvasVideoFormatInfo * finfo,
+    guint plane, guint width)
+{
+  guint samples;
+
+  g_return_val_if_fail (plane < finfo->n_planes, 0);
+
+  samples = GST_VIDEO_SUB_SCALE (finfo->w_sub[plane], width);
+
+  return ((samples + finfo->pgroup_pixels - 1) / finfo->pgroup_pixels) *
+      finfo->pgroup_bytes[plane];
+}
+
+/* pixels covered by bytes of the first plane, e.g. to express padding */
+guint
+gst_ivas_video_format_bytes_to_pixels (const GstIvasVideoFormatInfo * finfo,
+    guint bytes)
+{
+  return (bytes * finfo->pgroup_pixels) / finfo->pgroup_bytes[0];
+}
+
+/* Lays out a frame of info with each plane stride padded to stride_align
+ * and the height padded to elevation_align, planes back to back */
+gboolean
+gst_ivas_video_layout_compute (const GstVideoInfo * info, guint stride_align,
+    guint elevation_align, GstIvasVideoLayout * layout)
+{
+  const GstIvasVideoFormatInfo *finfo;
+  gsize offset = 0;
+  guint i, rows;
+
+  finfo = gst_ivas_video_format_get_info (GST_VIDEO_INFO_FORMAT (info));
+  if (!finfo)
+    return FALSE;
+
+  layout->n_planes = finfo->n_planes;
+  layout->elevation = ALIGN (GST_VIDEO_INFO_HEIGHT (info), elevation_align);
+
+  for (i = 0; i < finfo->n_planes; i++) {
+    rows = GST_VIDEO_SUB_SCALE (finfo->h_sub[i], layout->elevation);
+    rows = ALIGN (rows, finfo->elevation_round);
+
+    layout->stride[i] =
+        ALIGN (GST_VIDEO_INFO_PLANE_STRIDE (info, i), stride_align);
+    layout->offset[i] = offset;
+    offset += (gsize) layout->stride[i] * rows;
+  }
+
+  layout->size = offset;
+
+  return TRUE;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2020 Xilinx, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __GST_IVAS_VIDEO_FORMAT_H__
+#define __GST_IVAS_VIDEO_FORMAT_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <ivas/ivas_kernel.h>
+
+G_BEGIN_DECLS
+
+#define GST_IVAS_VIDEO_MAX_PLANES 3
+
+typedef struct _GstIvasVideoFormatInfo GstIvasVideoFormatInfo;
+typedef struct _GstIvasVideoLayout GstIvasVideoLayout;
+
+/* Memory layout of a video format as IVAS hardware sees it. Pixels are
+ * stored in groups of pgroup_pixels taking pgroup_bytes in each plane, which
+ * also covers packed formats like NV12_10LE32 (3 pixels in 4 bytes).
+ * Semi-planar chroma planes are not subsampled horizontally as one
+ * interleaved row spans the full width */
+struct _GstIvasVideoFormatInfo
+{
+  GstVideoFormat format;
+  IVASVideoFormat kernel_format;
+  guint n_planes;
+  guint pgroup_pixels;
+  guint pgroup_bytes[GST_IVAS_VIDEO_MAX_PLANES];
+  guint w_sub[GST_IVAS_VIDEO_MAX_PLANES];       /* log2 of subsampling */
+  guint h_sub[GST_IVAS_VIDEO_MAX_PLANES];
+  guint elevation_round;        /* rows of each plane are rounded up to this */
+};
+
+/* plane offsets, strides and total size of a frame with padding applied */
+struct _GstIvasVideoLayout
+{
+  guint n_planes;
+  guint elevation;
+  gsize offset[GST_VIDEO_MAX_PLANES];
+  gint stride[GST_VIDEO_MAX_PLANES];
+  gsize size;
+};
+
+GST_EXPORT
+const GstIvasVideoFormatInfo *gst_ivas_video_format_get_info (GstVideoFormat format);
+
+GST_EXPORT
+IVASVideoFormat gst_ivas_video_format_to_kernel (GstVideoFormat format);
+
+GST_EXPORT
+GstVideoFormat gst_ivas_video_format_from_kernel (IVASVideoFormat kernel_format);
+
+GST_EXPORT
+guint gst_ivas_video_format_row_bytes (const GstIvasVideoFormatInfo *finfo, guint plane, guint width);
+
+GST_EXPORT
+guint gst_ivas_video_format_bytes_to_pixels (const GstIvasVideoFormatInfo *finfo, guint bytes);
+
+GST_EXPORT
+gboolean gst_ivas_video_layout_compute (const GstVideoInfo *info, guint stride_align, guint elevation_align, GstIvasVideoLayout *layout);
+
+G_END_DECLS
+
+#endif /* __GST_IVAS_VIDEO_FORMAT_H__ */
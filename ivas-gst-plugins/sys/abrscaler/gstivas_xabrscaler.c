@@ -55,6 +55,7 @@
 #include <dlfcn.h>
 #include <gst/ivas/gstivasallocator.h>
 #include <gst/ivas/gstivasbufferpool.h>
+#include <gst/ivas/gstivasvideoformat.h>
 #include <gst/ivas/gstinferencemeta.h>
 #include <ivas/xrt_utils.h>
 #ifdef XLNX_PCIe_PLATFORM
@@ -79,11 +80,13 @@
 #define DEFAULT_DEVICE_INDEX 0 /* on Embedded only one device i.e. device 0 */
 #define NEED_DMABUF 1
 #endif
+#define DEFAULT_MEM_BANK 0
 static const int ERT_CMD_SIZE = 4096;
 #define MULTI_SCALER_TIMEOUT 1000       // 1 sec
 #define ALIGN(size,align) (((size) + (align) - 1) & ~((align) - 1))
-#define DIV_AND_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
 #define IVAS_XABRSCALER_AVOID_OUTPUT_COPY_DEFAULT FALSE
+#define IVAS_XABRSCALER_DEFAULT_QUEUE_DEPTH 1
+#define IVAS_XABRSCALER_MAX_QUEUE_DEPTH 4
 #define MEM_BANK 0
 
 /*256x64 for AWS use-case only*/
@@ -95,7 +98,6 @@ static const int ERT_CMD_SIZE = 4096;
 #define HEIGHT_ALIGN 1
 #endif
 
-pthread_mutex_t count_mutex;
 GST_DEBUG_CATEGORY_STATIC (gst_ivas_xabrscaler_debug);
 #define GST_CAT_DEFAULT gst_ivas_xabrscaler_debug
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_PERFORMANCE);
@@ -112,6 +114,8 @@ enum
   PROP_NUM_TAPS,
   PROP_COEF_LOADING_TYPE,
   PROP_AVOID_OUTPUT_COPY,
+  PROP_QUEUE_DEPTH,
+  PROP_MEM_BANK,
 #ifdef ENABLE_PPE_SUPPORT
   PROP_ALPHA_R,
   PROP_ALPHA_G,
@@ -153,6 +157,9 @@ struct _GstIvasXAbrScalerPad
   GstVideoInfo *in_vinfo;
   GstVideoInfo *out_vinfo;
   xrt_buffer *out_xrt_buf;
+  /* system memory buffers in the default layout of out_vinfo, for
+   * downstream not supporting GstVideoMeta */
+  GstBufferPool *copy_pool;
 };
 
 struct _GstIvasXAbrScalerPadClass
@@ -214,6 +221,25 @@ int Select_filt_id(float down_scale_ratio);
 void Generate_cardinal_cubic_spline(int src, int dst, int filterSize,
     int64_t B, int64_t C, int16_t* CCS_filtCoeff);
 
+/* everything a submitted frame needs until the scaler is done with it.
+ * With queue-depth > 1 the next frame is prepared in another slot while the
+ * scaler works on this one */
+typedef struct _IvasXAbrScalerSlot IvasXAbrScalerSlot;
+
+struct _IvasXAbrScalerSlot
+{
+  xrt_buffer ert_cmd_buf;
+  xrt_buffer msPtr[MAX_CHANNELS];
+  /* the descriptor chain is built once for the negotiated geometry, frames
+   * only patch buffer addresses. desc_dirty_* is the byte range of each
+   * descriptor not synced to the device yet, empty when equal */
+  gboolean desc_valid;
+  size_t desc_dirty_start[MAX_CHANNELS];
+  size_t desc_dirty_end[MAX_CHANNELS];
+  GstBuffer *inbuf;
+  GstBuffer *outbufs[MAX_CHANNELS];
+};
+
 struct _GstIvasXAbrScalerPrivate
 {
   GstVideoInfo *in_vinfo;
@@ -222,12 +248,28 @@ struct _GstIvasXAbrScalerPrivate
   uint32_t cu_index;
   bool is_coeff;
   uuid_t xclbinId;
-  xrt_buffer *ert_cmd_buf;
   size_t min_offset, max_offset;
   xrt_buffer Hcoff[MAX_CHANNELS];
   xrt_buffer Vcoff[MAX_CHANNELS];
-  GstBuffer *outbufs[MAX_CHANNELS];
-  xrt_buffer msPtr[MAX_CHANNELS];
+  /* device address of the coefficients each descriptor reads, another
+   * channel's BO when the filters are identical. A dirty BO holds
+   * coefficients not uploaded yet */
+  uint64_t Hcoff_addr[MAX_CHANNELS];
+  uint64_t Vcoff_addr[MAX_CHANNELS];
+  gboolean Hcoff_dirty[MAX_CHANNELS];
+  gboolean Vcoff_dirty[MAX_CHANNELS];
+  IvasXAbrScalerSlot slots[IVAS_XABRSCALER_MAX_QUEUE_DEPTH];
+  guint n_slots;
+  /* slots are used round robin, done_slot is the oldest one in flight and
+   * done_thread waits for it to complete and pushes its outputs */
+  guint cur_slot;
+  guint done_slot;
+  guint n_inflight;
+  GMutex slot_lock;
+  GCond slot_cond;
+  GThread *done_thread;
+  gboolean stop_thread;
+  GstFlowReturn done_ret;
   guint64 phy_in_0;
   guint64 phy_in_1;
   unsigned long int phy_out[MAX_CHANNELS];
@@ -260,101 +302,34 @@ G_DEFINE_TYPE_WITH_PRIVATE (GstIvasXAbrScaler, gst_ivas_xabrscaler,
 static guint
 ivas_xabrscaler_get_stride (GstVideoInfo *info, guint width)
 {
-  guint stride = 0;
+  const GstIvasVideoFormatInfo *finfo;
 
-  switch (GST_VIDEO_INFO_FORMAT(info)) {
-    case GST_VIDEO_FORMAT_GRAY8:
-    case GST_VIDEO_FORMAT_NV12:
-    case GST_VIDEO_FORMAT_NV16:
-      stride = ALIGN (width * 1, 4);
-      break;
-    case GST_VIDEO_FORMAT_BGR:
-    case GST_VIDEO_FORMAT_RGB:
-    case GST_VIDEO_FORMAT_v308:
-      stride = ALIGN (width * 3, 4);
-      break;
-    case GST_VIDEO_FORMAT_YUY2:
-    case GST_VIDEO_FORMAT_UYVY:
-      stride = ALIGN (width * 2, 4);
-      break;
-    case GST_VIDEO_FORMAT_r210:
-    case GST_VIDEO_FORMAT_Y410:
-    case GST_VIDEO_FORMAT_RGBA:
-    case GST_VIDEO_FORMAT_BGRA:
-    case GST_VIDEO_FORMAT_RGBx:
-    case GST_VIDEO_FORMAT_BGRx:
-      stride = width * 4;
-      break;
-    case GST_VIDEO_FORMAT_I422_10LE:
-    case GST_VIDEO_FORMAT_NV12_10LE32:
-    case GST_VIDEO_FORMAT_GRAY10_LE32:
-      /* 4 bytes per 3 pixels */
-      stride = DIV_AND_ROUND_UP(width * 4, 3);
-      break;
-    default:
-      GST_ERROR ("Not supporting %s yet",
-          gst_video_format_to_string (GST_VIDEO_INFO_FORMAT(info)));
-      stride = 0;
-      break;
+  finfo = gst_ivas_video_format_get_info (GST_VIDEO_INFO_FORMAT (info));
+  if (!finfo) {
+    GST_ERROR ("Not supporting %s yet",
+        gst_video_format_to_string (GST_VIDEO_INFO_FORMAT(info)));
+    return 0;
   }
-  return stride;
+
+  return ALIGN (gst_ivas_video_format_row_bytes (finfo, 0, width), 4);
 }
 
 static guint
 ivas_xabrscaler_get_padding_right (GstIvasXAbrScaler * self,
     GstVideoInfo * info)
 {
-  guint padding_pixels = -1;
+  const GstIvasVideoFormatInfo *finfo;
   guint plane_stride = GST_VIDEO_INFO_PLANE_STRIDE (info, 0);
   guint padding_bytes = ALIGN (plane_stride, self->out_stride_align) - plane_stride;
 
-  switch (GST_VIDEO_INFO_FORMAT (info)) {
-    case GST_VIDEO_FORMAT_NV12:
-      padding_pixels = padding_bytes;
-      break;
-    case GST_VIDEO_FORMAT_RGBx:
-    case GST_VIDEO_FORMAT_r210:
-    case GST_VIDEO_FORMAT_Y410:
-    case GST_VIDEO_FORMAT_BGRx:
-    case GST_VIDEO_FORMAT_BGRA:
-    case GST_VIDEO_FORMAT_RGBA:
-      padding_pixels = padding_bytes / 4;
-      break;
-    case GST_VIDEO_FORMAT_YUY2:
-    case GST_VIDEO_FORMAT_UYVY:
-      padding_pixels = padding_bytes / 2;
-      break;
-    case GST_VIDEO_FORMAT_NV16:
-      padding_pixels = padding_bytes;
-      break;
-    case GST_VIDEO_FORMAT_RGB:
-    case GST_VIDEO_FORMAT_v308:
-    case GST_VIDEO_FORMAT_BGR:
-      padding_pixels = padding_bytes / 3;
-      break;
-    case GST_VIDEO_FORMAT_I422_10LE:
-      padding_pixels = padding_bytes / 2;
-      break;
-    case GST_VIDEO_FORMAT_NV12_10LE32:
-      padding_pixels = (padding_bytes * 3) / 4;
-      break;
-    case GST_VIDEO_FORMAT_GRAY8:
-      padding_pixels = padding_bytes;
-      break;
-    case GST_VIDEO_FORMAT_GRAY10_LE32:
-      padding_pixels = (padding_bytes * 3) / 4;
-      break;
-    case GST_VIDEO_FORMAT_I420:
-      padding_pixels = padding_bytes;
-      break;
-    case GST_VIDEO_FORMAT_I420_10LE:
-      padding_pixels = padding_bytes / 2;
-      break;
-    default:
-      GST_ERROR_OBJECT (self, "not yet supporting format %d",
-          GST_VIDEO_INFO_FORMAT (info));
+  finfo = gst_ivas_video_format_get_info (GST_VIDEO_INFO_FORMAT (info));
+  if (!finfo) {
+    GST_ERROR_OBJECT (self, "not yet supporting format %d",
+        GST_VIDEO_INFO_FORMAT (info));
+    return -1;
   }
-  return padding_pixels;
+
+  return gst_ivas_video_format_bytes_to_pixels (finfo, padding_bytes);
 }
 
 static GType
@@ -771,6 +746,112 @@ void Generate_cardinal_cubic_spline(int src, int dst, int filterSize, int64_t B,
 #endif
 }
 
+/* cardinal cubic spline coefficients only depend on these, and ladders
+ * repeat the same ratios over channels and pipelines */
+typedef struct
+{
+  int src;
+  int dst;
+  int filter_size;
+  int64_t B;
+  int64_t C;
+} IvasXAbrScalerCoeffKey;
+
+static guint
+ivas_xabrscaler_coeff_key_hash (gconstpointer data)
+{
+  const IvasXAbrScalerCoeffKey *key = (const IvasXAbrScalerCoeffKey *) data;
+
+  return ((key->src * 31 + key->dst) * 31 + key->filter_size) * 31 +
+      (guint) (key->B ^ key->C);
+}
+
+static gboolean
+ivas_xabrscaler_coeff_key_equal (gconstpointer a, gconstpointer b)
+{
+  const IvasXAbrScalerCoeffKey *ka = (const IvasXAbrScalerCoeffKey *) a;
+  const IvasXAbrScalerCoeffKey *kb = (const IvasXAbrScalerCoeffKey *) b;
+
+  return ka->src == kb->src && ka->dst == kb->dst &&
+      ka->filter_size == kb->filter_size && ka->B == kb->B && ka->C == kb->C;
+}
+
+/* returns a COEFF_SIZE table from a process wide cache, generated on first
+ * use. Tables are never freed */
+static const int16_t *
+ivas_xabrscaler_get_ccs_coeffs (int src, int dst, int filter_size, int64_t B,
+    int64_t C)
+{
+  static GMutex cache_lock;
+  static GHashTable *cache;
+  IvasXAbrScalerCoeffKey key = { src, dst, filter_size, B, C };
+  int16_t *coeffs;
+
+  g_mutex_lock (&cache_lock);
+  if (!cache)
+    cache = g_hash_table_new (ivas_xabrscaler_coeff_key_hash,
+        ivas_xabrscaler_coeff_key_equal);
+
+  coeffs = (int16_t *) g_hash_table_lookup (cache, &key);
+  if (!coeffs) {
+    coeffs = (int16_t *) g_malloc0 (COEFF_SIZE);
+    Generate_cardinal_cubic_spline (src, dst, filter_size, B, C, coeffs);
+    g_hash_table_insert (cache, g_memdup (&key, sizeof (key)), coeffs);
+  } else {
+    GST_DEBUG ("cached coefficients for %d -> %d with filter size %d", src,
+        dst, filter_size);
+  }
+  g_mutex_unlock (&cache_lock);
+
+  return coeffs;
+}
+
+/* the BO only needs an upload when its coefficients change */
+static void
+ivas_xabrscaler_set_coeffs (xrt_buffer * coeff_buf, gboolean * dirty,
+    const void *coeffs)
+{
+  if (!memcmp (coeff_buf->user_ptr, coeffs, COEFF_SIZE))
+    return;
+
+  memcpy (coeff_buf->user_ptr, coeffs, COEFF_SIZE);
+  *dirty = TRUE;
+}
+
+/* points channels, and directions, with identical filters at one BO so it
+ * is uploaded once */
+static void
+ivas_xabrscaler_share_coeffs (GstIvasXAbrScaler * self)
+{
+  GstIvasXAbrScalerPrivate *priv = self->priv;
+  xrt_buffer *bufs[2 * MAX_CHANNELS];
+  guint owner[2 * MAX_CHANNELS];
+  guint n = 0, chan_id, i, j;
+
+  for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
+    bufs[n++] = &priv->Hcoff[chan_id];
+    bufs[n++] = &priv->Vcoff[chan_id];
+  }
+
+  for (i = 0; i < n; i++) {
+    owner[i] = i;
+    for (j = 0; j < i; j++) {
+      if (owner[j] == j &&
+          !memcmp (bufs[j]->user_ptr, bufs[i]->user_ptr, COEFF_SIZE)) {
+        owner[i] = j;
+        break;
+      }
+    }
+  }
+
+  for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
+    priv->Hcoff_addr[chan_id] = bufs[owner[2 * chan_id]]->phy_addr;
+    priv->Vcoff_addr[chan_id] = bufs[owner[2 * chan_id + 1]]->phy_addr;
+    GST_DEBUG_OBJECT (self, "chan-%d : coefficients from BO %u and %u",
+        chan_id, owner[2 * chan_id], owner[2 * chan_id + 1]);
+  }
+}
+
 static void
 ivas_xabrscaler_prepare_coefficients_with_12tap (GstIvasXAbrScaler * self, guint chan_id)
 {
@@ -783,6 +864,7 @@ ivas_xabrscaler_prepare_coefficients_with_12tap (GstIvasXAbrScaler * self, guint
   float scale_ratio[2] = {0, 0};
   int upscale_enable[2] = {0, 0};
   int filterSet[2] = {0, 0};
+  int16_t fixed_coeffs[64][12];
   guint d;
   gboolean bret;
 
@@ -827,12 +909,15 @@ ivas_xabrscaler_prepare_coefficients_with_12tap (GstIvasXAbrScaler * self, guint
     if (bret && !upscale_enable[0]) {
       GST_INFO_OBJECT (self, "Generate cardinal cubic horizontal coefficients "
           "with filter size %d", filter_size);
-      Generate_cardinal_cubic_spline(in_width, out_width, filter_size, B, C,
-          (int16_t *)priv->Hcoff[chan_id].user_ptr);
+      ivas_xabrscaler_set_coeffs (&priv->Hcoff[chan_id],
+          &priv->Hcoff_dirty[chan_id], ivas_xabrscaler_get_ccs_coeffs (in_width,
+              out_width, filter_size, B, C));
     } else {
       /* get fixed horizontal filters*/
       GST_INFO_OBJECT (self, "Consider predefined horizontal filter coefficients");
-      copy_filt_set(priv->Hcoff[chan_id].user_ptr, filterSet[0]);
+      copy_filt_set(fixed_coeffs, filterSet[0]);
+      ivas_xabrscaler_set_coeffs (&priv->Hcoff[chan_id],
+          &priv->Hcoff_dirty[chan_id], fixed_coeffs);
     }
 
     /* prepare vertical coefficients */
@@ -840,21 +925,28 @@ ivas_xabrscaler_prepare_coefficients_with_12tap (GstIvasXAbrScaler * self, guint
     if (bret && !upscale_enable[1]) {
       GST_INFO_OBJECT (self, "Generate cardinal cubic vertical coefficients "
           "with filter size %d", filter_size);
-      Generate_cardinal_cubic_spline(in_height, out_height, filter_size, B, C,
-          (int16_t *)priv->Vcoff[chan_id].user_ptr);
+      ivas_xabrscaler_set_coeffs (&priv->Vcoff[chan_id],
+          &priv->Vcoff_dirty[chan_id], ivas_xabrscaler_get_ccs_coeffs (in_height,
+              out_height, filter_size, B, C));
     } else {
       /* get fixed vertical filters*/
       GST_INFO_OBJECT (self, "Consider predefined vertical filter coefficients");
-      copy_filt_set(priv->Vcoff[chan_id].user_ptr, filterSet[1]);
+      copy_filt_set(fixed_coeffs, filterSet[1]);
+      ivas_xabrscaler_set_coeffs (&priv->Vcoff[chan_id],
+          &priv->Vcoff_dirty[chan_id], fixed_coeffs);
     }
   } else if (self->coef_load_type == COEF_FIXED){
     /* get fixed horizontal filters*/
     GST_INFO_OBJECT (self, "Consider predefined horizontal filter coefficients");
-    copy_filt_set(priv->Hcoff[chan_id].user_ptr, filterSet[0]);
+    copy_filt_set(fixed_coeffs, filterSet[0]);
+    ivas_xabrscaler_set_coeffs (&priv->Hcoff[chan_id],
+        &priv->Hcoff_dirty[chan_id], fixed_coeffs);
 
     /* get fixed vertical filters*/
     GST_INFO_OBJECT (self, "Consider predefined vertical filter coefficients");
-    copy_filt_set(priv->Vcoff[chan_id].user_ptr, filterSet[1]);
+    copy_filt_set(fixed_coeffs, filterSet[1]);
+    ivas_xabrscaler_set_coeffs (&priv->Vcoff[chan_id],
+        &priv->Vcoff_dirty[chan_id], fixed_coeffs);
   }
 }
 
@@ -1246,13 +1338,27 @@ ivas_xabrscaler_create_context (GstIvasXAbrScaler * self)
   return TRUE;
 }
 
+static void
+ivas_xabrscaler_invalidate_descriptors (GstIvasXAbrScaler * self)
+{
+  guint idx;
+
+  for (idx = 0; idx < IVAS_XABRSCALER_MAX_QUEUE_DEPTH; idx++)
+    self->priv->slots[idx].desc_valid = FALSE;
+}
+
 static gboolean
 ivas_xabrscaler_allocate_internal_buffers (GstIvasXAbrScaler * self)
 {
   GstIvasXAbrScalerPrivate *priv = self->priv;
+  IvasXAbrScalerSlot *slot;
   gint chan_id, iret;
+  guint idx;
 
-  GST_INFO_OBJECT (self, "allocating internal buffers");
+  GST_INFO_OBJECT (self, "allocating internal buffers for %u frames",
+      self->queue_depth);
+
+  ivas_xabrscaler_invalidate_descriptors (self);
 
   for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
     iret =
@@ -1273,19 +1379,39 @@ ivas_xabrscaler_allocate_internal_buffers (GstIvasXAbrScaler * self)
       goto error;
     }
 
-    iret =
-        alloc_xrt_buffer (priv->xcl_handle, DESC_SIZE, XCL_BO_DEVICE_RAM,
-        MEM_BANK, &priv->msPtr[chan_id]);
+    /* device side content is unknown until the first upload */
+    priv->Hcoff_addr[chan_id] = priv->Hcoff[chan_id].phy_addr;
+    priv->Vcoff_addr[chan_id] = priv->Vcoff[chan_id].phy_addr;
+    priv->Hcoff_dirty[chan_id] = priv->Vcoff_dirty[chan_id] = TRUE;
+  }
+
+  /* each frame in flight has its own command and descriptor chain */
+  for (idx = 0; idx < self->queue_depth; idx++) {
+    slot = &priv->slots[idx];
+
+    iret = alloc_xrt_buffer (priv->xcl_handle, ERT_CMD_SIZE,
+        XCL_BO_SHARED_VIRTUAL, XCL_BO_FLAGS_EXECBUF, &slot->ert_cmd_buf);
     if (iret < 0) {
-      GST_ERROR_OBJECT (self,
-          "failed to allocate vertical coefficients command buffer..");
+      GST_ERROR_OBJECT (self, "failed to allocate ert command buffer..");
       goto error;
     }
+
+    for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
+      iret =
+          alloc_xrt_buffer (priv->xcl_handle, DESC_SIZE, XCL_BO_DEVICE_RAM,
+          MEM_BANK, &slot->msPtr[chan_id]);
+      if (iret < 0) {
+        GST_ERROR_OBJECT (self, "failed to allocate descriptor buffer..");
+        goto error;
+      }
+    }
   }
+  priv->n_slots = self->queue_depth;
+  priv->cur_slot = priv->done_slot = 0;
 #ifdef DEBUG
   for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
-    printf ("DESC phy %lx  virt  %p \n", priv->msPtr[chan_id].phy_addr,
-        priv->msPtr[chan_id].user_ptr);
+    printf ("DESC phy %lx  virt  %p \n", priv->slots[0].msPtr[chan_id].phy_addr,
+        priv->slots[0].msPtr[chan_id].user_ptr);
     printf ("HCoef phy %lx  virt  %p \n", priv->Hcoff[chan_id].phy_addr,
         priv->Hcoff[i].user_ptr);
     printf ("VCoef phy %lx  virt  %p \n", priv->Vcoff[chan_id].phy_addr,
@@ -1304,10 +1430,13 @@ static void
 ivas_xabrscaler_free_internal_buffers (GstIvasXAbrScaler * self)
 {
   GstIvasXAbrScalerPrivate *priv = self->priv;
-  guint chan_id;
+  IvasXAbrScalerSlot *slot;
+  guint chan_id, idx;
 
   GST_DEBUG_OBJECT (self, "freeing internal buffers");
 
+  ivas_xabrscaler_invalidate_descriptors (self);
+
   for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
     if (priv->Hcoff[chan_id].user_ptr) {
       free_xrt_buffer (priv->xcl_handle, &priv->Hcoff[chan_id]);
@@ -1317,11 +1446,23 @@ ivas_xabrscaler_free_internal_buffers (GstIvasXAbrScaler * self)
       free_xrt_buffer (priv->xcl_handle, &priv->Vcoff[chan_id]);
       memset (&(self->priv->Vcoff[chan_id]), 0x0, sizeof(xrt_buffer));
     }
-    if (priv->msPtr[chan_id].user_ptr) {
-      free_xrt_buffer (priv->xcl_handle, &priv->msPtr[chan_id]);
-      memset (&(self->priv->msPtr[chan_id]), 0x0, sizeof(xrt_buffer));
+  }
+
+  for (idx = 0; idx < IVAS_XABRSCALER_MAX_QUEUE_DEPTH; idx++) {
+    slot = &priv->slots[idx];
+
+    if (slot->ert_cmd_buf.user_ptr) {
+      free_xrt_buffer (priv->xcl_handle, &slot->ert_cmd_buf);
+      memset (&slot->ert_cmd_buf, 0x0, sizeof (xrt_buffer));
+    }
+    for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
+      if (slot->msPtr[chan_id].user_ptr) {
+        free_xrt_buffer (priv->xcl_handle, &slot->msPtr[chan_id]);
+        memset (&slot->msPtr[chan_id], 0x0, sizeof (xrt_buffer));
+      }
     }
   }
+  priv->n_slots = 0;
 }
 
 static gboolean
@@ -1358,6 +1499,7 @@ ivas_xabrscaler_destroy_context (GstIvasXAbrScaler * self)
       GST_ERROR_OBJECT (self, "failed to close xrt context");
       has_error = TRUE;
     }
+    gst_ivas_dmabuf_import_release (priv->xcl_handle);
     xclClose (priv->xcl_handle);
     priv->xcl_handle = NULL;
     GST_INFO_OBJECT (self, "closed xrt context");
@@ -1387,7 +1529,8 @@ ivas_xabrscaler_allocate_internal_pool (GstIvasXAbrScaler * self)
   pool = gst_video_buffer_pool_new ();
   GST_LOG_OBJECT (self, "allocated internal sink pool %p", pool);
 
-  allocator = gst_ivas_allocator_new (self->dev_index, NEED_DMABUF);
+  allocator = gst_ivas_allocator_new_with_bank (self->dev_index,
+      NEED_DMABUF, self->mem_bank);
   gst_allocation_params_init (&alloc_params);
   alloc_params.flags = GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
   alloc_params.flags |= GST_IVAS_ALLOCATOR_FLAG_MEM_INIT;
@@ -1396,7 +1539,7 @@ ivas_xabrscaler_allocate_internal_pool (GstIvasXAbrScaler * self)
   config = gst_buffer_pool_get_config (pool);
 
   gst_buffer_pool_config_set_params (config, caps, GST_VIDEO_INFO_SIZE (&info),
-      3, 5);
+      2 + self->queue_depth, 4 + self->queue_depth);
 
   gst_buffer_pool_config_set_allocator (config, allocator, &alloc_params);
   gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
@@ -1424,86 +1567,94 @@ error:
 
 #ifdef XLNX_PCIe_PLATFORM
 static gboolean
+xlnx_abr_coeff_upload (GstIvasXAbrScaler * self, xrt_buffer * coeff_buf,
+    const gchar * direction)
+{
+  GstIvasXAbrScalerPrivate *priv = self->priv;
+  int iret;
+
+  iret = xclWriteBO (priv->xcl_handle, coeff_buf->bo, coeff_buf->user_ptr,
+      coeff_buf->size, 0);
+  if (iret != 0) {
+    GST_ERROR_OBJECT (self,
+        "failed to write %s coefficients. reason : %s", direction,
+        strerror (errno));
+    return FALSE;
+  }
+  iret = xclSyncBO (priv->xcl_handle, coeff_buf->bo,
+      XCL_BO_SYNC_BO_TO_DEVICE, coeff_buf->size, 0);
+  if (iret != 0) {
+    GST_ERROR_OBJECT (self,
+        "failed to sync %s coefficients. reason : %s", direction,
+        strerror (errno));
+    GST_ELEMENT_ERROR (self, RESOURCE, SYNC, NULL,
+        ("failed to sync %s coefficients to device. reason : %s", direction,
+            strerror (errno)));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* uploads changed coefficients of the BOs descriptors read, BOs standing in
+ * for another channel's are left alone */
+static gboolean
 xlnx_abr_coeff_syncBO (GstIvasXAbrScaler * self)
 {
   GstIvasXAbrScalerPrivate *priv = self->priv;
   int chan_id;
-  int iret;
 
   for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
-
-    iret = xclWriteBO (priv->xcl_handle, priv->Hcoff[chan_id].bo,
-        priv->Hcoff[chan_id].user_ptr, priv->Hcoff[chan_id].size, 0);
-    if (iret != 0) {
-      GST_ERROR_OBJECT (self,
-          "failed to write horizontal coefficients. reason : %s",
-          strerror (errno));
-      return FALSE;
-    }
-    iret = xclSyncBO (priv->xcl_handle, priv->Hcoff[chan_id].bo,
-        XCL_BO_SYNC_BO_TO_DEVICE, priv->Hcoff[chan_id].size, 0);
-    if (iret != 0) {
-      GST_ERROR_OBJECT (self,
-          "failed to sync horizontal coefficients. reason : %s",
-          strerror (errno));
-      GST_ELEMENT_ERROR (self, RESOURCE, SYNC, NULL,
-          ("failed to sync horizontal coefficients to device. reason : %s",
-              strerror (errno)));
-      return FALSE;
+    if (priv->Hcoff_dirty[chan_id] &&
+        priv->Hcoff_addr[chan_id] == priv->Hcoff[chan_id].phy_addr) {
+      if (!xlnx_abr_coeff_upload (self, &priv->Hcoff[chan_id], "horizontal"))
+        return FALSE;
+      priv->Hcoff_dirty[chan_id] = FALSE;
     }
 
-    iret = xclWriteBO (priv->xcl_handle, priv->Vcoff[chan_id].bo,
-        priv->Vcoff[chan_id].user_ptr, priv->Vcoff[chan_id].size, 0);
-    if (iret != 0) {
-      GST_ERROR_OBJECT (self,
-          "failed to write vertical coefficients. reason : %s",
-          strerror (errno));
-      return FALSE;
-    }
-    iret = xclSyncBO (priv->xcl_handle, priv->Vcoff[chan_id].bo,
-        XCL_BO_SYNC_BO_TO_DEVICE, priv->Vcoff[chan_id].size, 0);
-    if (iret != 0) {
-      GST_ERROR_OBJECT (self,
-          "failed to sync vertical coefficients. reason : %s",
-          strerror (errno));
-      GST_ELEMENT_ERROR (self, RESOURCE, SYNC, NULL,
-          ("failed to sync vertical coefficients to device. reason : %s",
-              strerror (errno)));
-      return FALSE;
+    if (priv->Vcoff_dirty[chan_id] &&
+        priv->Vcoff_addr[chan_id] == priv->Vcoff[chan_id].phy_addr) {
+      if (!xlnx_abr_coeff_upload (self, &priv->Vcoff[chan_id], "vertical"))
+        return FALSE;
+      priv->Vcoff_dirty[chan_id] = FALSE;
     }
   }
   return TRUE;
 }
 
 static gboolean
-xlnx_abr_desc_syncBO (GstIvasXAbrScaler * self)
+xlnx_abr_desc_syncBO (GstIvasXAbrScaler * self, IvasXAbrScalerSlot * slot)
 {
   GstIvasXAbrScalerPrivate *priv = self->priv;
   int chan_id;
   int iret;
+  size_t offset, size;
 
   for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
+    offset = slot->desc_dirty_start[chan_id];
+    size = slot->desc_dirty_end[chan_id] - offset;
+    if (!size)
+      continue;
 
-    iret = xclWriteBO (priv->xcl_handle, priv->msPtr[chan_id].bo,
-        priv->msPtr[chan_id].user_ptr, priv->msPtr[chan_id].size, 0);
+    iret = xclWriteBO (priv->xcl_handle, slot->msPtr[chan_id].bo,
+        (char *) slot->msPtr[chan_id].user_ptr + offset, size, offset);
     if (iret != 0) {
       GST_ERROR_OBJECT (self,
-          "failed to write horizontal coefficients. reason : %s",
-          strerror (errno));
+          "failed to write descriptor. reason : %s", strerror (errno));
       return FALSE;
     }
-    iret = xclSyncBO (priv->xcl_handle, priv->msPtr[chan_id].bo,
-        XCL_BO_SYNC_BO_TO_DEVICE, priv->msPtr[chan_id].size, 0);
+    iret = xclSyncBO (priv->xcl_handle, slot->msPtr[chan_id].bo,
+        XCL_BO_SYNC_BO_TO_DEVICE, size, offset);
     if (iret != 0) {
       GST_ERROR_OBJECT (self,
-          "failed to sync horizontal coefficients. reason : %s",
-          strerror (errno));
+          "failed to sync descriptor. reason : %s", strerror (errno));
       GST_ELEMENT_ERROR (self, RESOURCE, SYNC, NULL,
-          ("failed to sync  horizontal coefficients to device. reason : %s",
+          ("failed to sync descriptor to device. reason : %s",
               strerror (errno)));
       return FALSE;
     }
 
+    slot->desc_dirty_start[chan_id] = slot->desc_dirty_end[chan_id] = 0;
   }
   return TRUE;
 }
@@ -1535,37 +1686,14 @@ ivas_xabrscaler_prepare_input_buffer (GstIvasXAbrScaler * self,
       && gst_ivas_memory_can_avoid_copy (in_mem, self->dev_index)) {
     phy_addr = gst_ivas_allocator_get_paddr (in_mem);
   } else if (gst_is_dmabuf_memory (in_mem)) {
-    guint bo = NULLBO;
-    gint dma_fd = -1;
-    struct xclBOProperties p;
-
-    dma_fd = gst_dmabuf_memory_get_fd (in_mem);
-    if (dma_fd < 0) {
-      GST_ERROR_OBJECT (self, "failed to get DMABUF FD");
-      goto error;
-    }
-
-    /* dmabuf but not from xrt */
-    bo = xclImportBO (self->priv->xcl_handle, dma_fd, 0);
-    if (bo == NULLBO) {
-      GST_WARNING_OBJECT (self,
-          "failed to get XRT BO...fall back to copy input");
-    }
-
-    GST_DEBUG_OBJECT (self, "received dma fd %d and its xrt BO = %u", dma_fd,
-        bo);
-
-    if (!xclGetBOProperties (self->priv->xcl_handle, bo, &p)) {
-      phy_addr = p.paddr;
-    } else {
+    /* dmabuf but not from xrt, imported once per dmabuf */
+    phy_addr =
+        gst_ivas_dmabuf_import_get_paddr (self->priv->xcl_handle, in_mem);
+    if (!phy_addr) {
       GST_WARNING_OBJECT (self,
           "failed to get physical address...fall back to copy input");
       use_inpool = TRUE;
     }
-
-    if (bo != NULLBO)
-       xclFreeBO(self->priv->xcl_handle, bo);
-
   } else {
     use_inpool = TRUE;
   }
@@ -1666,7 +1794,8 @@ error:
 }
 
 static gboolean
-ivas_xabrscaler_prepare_output_buffer (GstIvasXAbrScaler * self)
+ivas_xabrscaler_prepare_output_buffer (GstIvasXAbrScaler * self,
+    IvasXAbrScalerSlot * slot)
 {
   guint chan_id;
   GstMemory *mem = NULL;
@@ -1688,7 +1817,7 @@ ivas_xabrscaler_prepare_output_buffer (GstIvasXAbrScaler * self)
     }
     GST_LOG_OBJECT (srcpad, "acquired buffer %p from pool", outbuf);
 
-    self->priv->outbufs[chan_id] = outbuf;
+    slot->outbufs[chan_id] = outbuf;
     mem = gst_buffer_get_memory (outbuf, 0);
     if (mem == NULL) {
       GST_ERROR_OBJECT (srcpad,
@@ -1701,35 +1830,13 @@ ivas_xabrscaler_prepare_output_buffer (GstIvasXAbrScaler * self)
     if (gst_is_ivas_memory (mem)) {
       phy_addr = gst_ivas_allocator_get_paddr (mem);
     } else if (gst_is_dmabuf_memory (mem)) {
-      guint bo = NULLBO;
-      gint dma_fd = -1;
-      struct xclBOProperties p;
-
-      dma_fd = gst_dmabuf_memory_get_fd (mem);
-      if (dma_fd < 0) {
-        GST_ERROR_OBJECT (self, "failed to get DMABUF FD");
+      /* dmabuf but not from xrt, imported once per dmabuf */
+      phy_addr =
+          gst_ivas_dmabuf_import_get_paddr (self->priv->xcl_handle, mem);
+      if (!phy_addr) {
+        GST_ERROR_OBJECT (self, "failed to get physical address of output");
         goto error;
       }
-
-      /* dmabuf but not from xrt */
-      bo = xclImportBO (self->priv->xcl_handle, dma_fd, 0);
-      if (bo == NULLBO) {
-        GST_WARNING_OBJECT (self,
-            "failed to get XRT BO...fall back to copy input");
-      }
-
-      GST_INFO_OBJECT (self, "received dma fd %d and its xrt BO = %u", dma_fd,
-          bo);
-
-      if (!xclGetBOProperties (self->priv->xcl_handle, bo, &p)) {
-        phy_addr = p.paddr;
-      } else {
-        GST_WARNING_OBJECT (self,
-            "failed to get physical address...fall back to copy input");
-      }
-
-      if (bo != NULLBO)
-        xclFreeBO(self->priv->xcl_handle, bo);
     }
 
     vmeta = gst_buffer_get_video_meta (outbuf);
@@ -1926,8 +2033,8 @@ xlnx_multiscaler_coff_fill (void *Hcoeff_BufAddr, void *Vcoeff_BufAddr,
 }
 
 static void
-ivas_xabrscaler_reg_write (GstIvasXAbrScaler * self, void *src, size_t size,
-    size_t offset)
+ivas_xabrscaler_reg_write (GstIvasXAbrScaler * self,
+    IvasXAbrScalerSlot * slot, void *src, size_t size, size_t offset)
 {
   unsigned int *src_array = (unsigned int *) src;
   size_t cur_min = offset;
@@ -1935,7 +2042,7 @@ ivas_xabrscaler_reg_write (GstIvasXAbrScaler * self, void *src, size_t size,
   unsigned int entries = size / sizeof (uint32_t);
   unsigned int start = offset / sizeof (uint32_t), i;
   struct ert_start_kernel_cmd *ert_cmd =
-      (struct ert_start_kernel_cmd *) (self->priv->ert_cmd_buf->user_ptr);
+      (struct ert_start_kernel_cmd *) (slot->ert_cmd_buf.user_ptr);
 
   for (i = 0; i < entries; i++)
     ert_cmd->data[start + i] = src_array[i];
@@ -1948,8 +2055,90 @@ ivas_xabrscaler_reg_write (GstIvasXAbrScaler * self, void *src, size_t size,
     self->priv->min_offset = cur_min;
 }
 
+/* buffer addresses are the only descriptor fields changing per frame */
+#define DESC_ADDR_START G_STRUCT_OFFSET (MULTI_SCALER_DESC_STRUCT, msc_srcImgBuf0)
+#define DESC_ADDR_END G_STRUCT_OFFSET (MULTI_SCALER_DESC_STRUCT, msc_blkmm_hfltCoeff)
+
+static void
+xlnx_multiscaler_descriptor_dirty (IvasXAbrScalerSlot * slot,
+    guint chan_id, size_t start, size_t end)
+{
+  if (slot->desc_dirty_start[chan_id] == slot->desc_dirty_end[chan_id]) {
+    slot->desc_dirty_start[chan_id] = start;
+    slot->desc_dirty_end[chan_id] = end;
+  } else {
+    slot->desc_dirty_start[chan_id] =
+        MIN (slot->desc_dirty_start[chan_id], start);
+    slot->desc_dirty_end[chan_id] = MAX (slot->desc_dirty_end[chan_id], end);
+  }
+}
+
+/* whether the frame needs other sizes, formats or strides than the chain
+ * was built for. Output buffers may come from downstream pools */
+static gboolean
+xlnx_multiscaler_descriptor_changed (GstIvasXAbrScaler * self,
+    IvasXAbrScalerSlot * slot)
+{
+  GstIvasXAbrScalerPrivate *priv = self->priv;
+  MULTI_SCALER_DESC_STRUCT *msPtr;
+  GstVideoMeta *meta_out;
+  guint chan_id;
+
+  msPtr = (MULTI_SCALER_DESC_STRUCT *) (slot->msPtr[0].user_ptr);
+  if (msPtr->msc_strideIn !=
+      xlnx_multiscaler_stride_align (priv->meta_in_stride, self->ppc * 64))
+    return TRUE;
+
+  for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
+    msPtr = (MULTI_SCALER_DESC_STRUCT *) (slot->msPtr[chan_id].user_ptr);
+    meta_out = gst_buffer_get_video_meta (slot->outbufs[chan_id]);
+    if (msPtr->msc_widthOut != meta_out->width ||
+        msPtr->msc_heightOut != meta_out->height ||
+        msPtr->msc_outPixelFmt !=
+        xlnx_multiscaler_colorformat (meta_out->format) ||
+        msPtr->msc_strideOut !=
+        xlnx_multiscaler_stride_align (*(meta_out->stride), self->ppc * 64))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* points the prebuilt chain at the buffers of this frame, each descriptor
+ * reading the output of the previous one */
+static void
+xlnx_multiscaler_descriptor_update (GstIvasXAbrScaler * self,
+    IvasXAbrScalerSlot * slot)
+{
+  GstIvasXAbrScalerPrivate *priv = self->priv;
+  MULTI_SCALER_DESC_STRUCT *msPtr;
+  uint64_t phy_in_0 = priv->phy_in_0;
+  uint64_t phy_in_1 = priv->phy_in_1;
+  guint chan_id;
+
+  for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
+    msPtr = (MULTI_SCALER_DESC_STRUCT *) (slot->msPtr[chan_id].user_ptr);
+
+    if (msPtr->msc_srcImgBuf0 != phy_in_0 ||
+        msPtr->msc_srcImgBuf1 != phy_in_1 ||
+        msPtr->msc_dstImgBuf0 != priv->phy_out[chan_id] ||
+        msPtr->msc_dstImgBuf1 != priv->out_offset[chan_id]) {
+      msPtr->msc_srcImgBuf0 = phy_in_0;
+      msPtr->msc_srcImgBuf1 = phy_in_1;
+      msPtr->msc_dstImgBuf0 = priv->phy_out[chan_id];
+      msPtr->msc_dstImgBuf1 = priv->out_offset[chan_id];
+      xlnx_multiscaler_descriptor_dirty (slot, chan_id, DESC_ADDR_START,
+          DESC_ADDR_END);
+    }
+
+    phy_in_0 = msPtr->msc_dstImgBuf0;
+    phy_in_1 = msPtr->msc_dstImgBuf1;
+  }
+}
+
 static bool
-xlnx_multiscaler_descriptor_create (GstIvasXAbrScaler * self)
+xlnx_multiscaler_descriptor_create (GstIvasXAbrScaler * self,
+    IvasXAbrScalerSlot * slot)
 {
   GstVideoMeta *meta_out;
   MULTI_SCALER_DESC_STRUCT *msPtr;
@@ -1971,7 +2160,7 @@ xlnx_multiscaler_descriptor_create (GstIvasXAbrScaler * self)
 
   for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
 
-    msPtr = (MULTI_SCALER_DESC_STRUCT *) (priv->msPtr[chan_id].user_ptr);
+    msPtr = (MULTI_SCALER_DESC_STRUCT *) (slot->msPtr[chan_id].user_ptr);
     msPtr->msc_srcImgBuf0 = (uint64_t) phy_in_0;
     msPtr->msc_srcImgBuf1 = (uint64_t) phy_in_1;        /* plane 2 */
     msPtr->msc_srcImgBuf2 = (uint64_t) 0;
@@ -1984,7 +2173,7 @@ xlnx_multiscaler_descriptor_create (GstIvasXAbrScaler * self)
     msPtr->msc_heightIn = height;
     msPtr->msc_inPixelFmt = msc_inPixelFmt;
     msPtr->msc_strideIn = stride;
-    meta_out = gst_buffer_get_video_meta (priv->outbufs[chan_id]);
+    meta_out = gst_buffer_get_video_meta (slot->outbufs[chan_id]);
     msPtr->msc_widthOut = meta_out->width;
     msPtr->msc_heightOut = meta_out->height;
 #ifdef ENABLE_PPE_SUPPORT
@@ -2006,129 +2195,442 @@ xlnx_multiscaler_descriptor_create (GstIvasXAbrScaler * self)
             ((msPtr->msc_widthOut) / 2)) / (float) msPtr->msc_widthOut);
     msPtr->msc_outPixelFmt = xlnx_multiscaler_colorformat (meta_out->format);
 
-    msPtr->msc_strideOut =
-        xlnx_multiscaler_stride_align (*(meta_out->stride), self->ppc * 64);
+    msPtr->msc_strideOut =
+        xlnx_multiscaler_stride_align (*(meta_out->stride), self->ppc * 64);
+
+    msPtr->msc_blkmm_hfltCoeff = 0;
+    msPtr->msc_blkmm_vfltCoeff = 0;
+    if (chan_id == (self->num_request_pads - 1))
+      msPtr->msc_nxtaddr = 0;
+    else
+      msPtr->msc_nxtaddr = slot->msPtr[chan_id + 1].phy_addr;
+    msPtr->msc_blkmm_hfltCoeff = priv->Hcoff_addr[chan_id];
+    msPtr->msc_blkmm_vfltCoeff = priv->Vcoff_addr[chan_id];
+
+    /* set the output as input for next descripto if any */
+    phy_in_0 = msPtr->msc_dstImgBuf0;
+    phy_in_1 = msPtr->msc_dstImgBuf1;
+    width = msPtr->msc_widthOut;
+    height = msPtr->msc_heightOut;
+    msc_inPixelFmt = msPtr->msc_outPixelFmt;
+    stride = msPtr->msc_strideOut;
+
+    xlnx_multiscaler_descriptor_dirty (slot, chan_id, 0, DESC_SIZE);
+  }
+  priv->is_coeff = false;
+  slot->desc_valid = TRUE;
+  return TRUE;
+}
+
+/* issues the frame prepared in slot to the scaler without waiting for it */
+static gboolean
+ivas_xabrscaler_process (GstIvasXAbrScaler * self, IvasXAbrScalerSlot * slot)
+{
+  GstIvasXAbrScalerPrivate *priv = self->priv;
+  struct ert_start_kernel_cmd *ert_cmd =
+      (struct ert_start_kernel_cmd *) (slot->ert_cmd_buf.user_ptr);
+  int iret;
+  uint32_t value = 0;
+  uint64_t desc_addr = 0;
+  uint32_t payload_offset = 0;
+  bool ret;
+
+  /* set descriptor */
+  if (!slot->desc_valid || xlnx_multiscaler_descriptor_changed (self, slot)) {
+    GST_DEBUG_OBJECT (self, "building descriptor chain");
+    ret = xlnx_multiscaler_descriptor_create (self, slot);
+    if (!ret)
+      return FALSE;
+  } else {
+    xlnx_multiscaler_descriptor_update (self, slot);
+  }
+#ifdef XLNX_PCIe_PLATFORM
+  ret = xlnx_abr_desc_syncBO (self, slot);
+  if (!ret)
+    return FALSE;
+#endif
+
+  /*to support 128 cu index we need 3 extra cu mask in ert command buffer */
+  ert_cmd->extra_cu_masks = 3;
+  payload_offset = ert_cmd->extra_cu_masks * 4; /* 4 bytes per mask */
+
+  /* prgram registers */
+  value = self->num_request_pads;
+  ivas_xabrscaler_reg_write (self, slot, &value, sizeof (value),
+      (XV_MULTI_SCALER_CTRL_ADDR_HWREG_NUM_OUTS_DATA + payload_offset));
+  desc_addr = slot->msPtr[0].phy_addr;
+  ivas_xabrscaler_reg_write (self, slot, &desc_addr, sizeof (desc_addr),
+      (XV_MULTI_SCALER_CTRL_ADDR_HWREG_START_ADDR_DATA + payload_offset));
+
+  /* start ert command */
+  ert_cmd->state = ERT_CMD_STATE_NEW;
+  ert_cmd->opcode = ERT_START_CU;
+
+  if ( priv->cu_index > 31) {
+     ert_cmd->cu_mask = 0;
+     if (priv->cu_index > 63) {
+       ert_cmd->data[0] = 0;
+       if (priv->cu_index > 96) {
+         ert_cmd->data[1] = 0;
+         ert_cmd->data[2] = (1 << (priv->cu_index - 96));
+       } else {
+         ert_cmd->data[1] = (1 << (priv->cu_index - 64));
+         ert_cmd->data[2] = 0;
+       }
+    } else {
+       ert_cmd->data[0] = (1 << (priv->cu_index - 32));
+   }
+ } else {
+      ert_cmd->cu_mask = (1 << priv->cu_index);
+      ert_cmd->data[0] = 0;
+      ert_cmd->data[1] = 0;
+      ert_cmd->data[2] = 0;
+ }
+
+ ert_cmd->count = (self->priv->max_offset >> 2) + 1;
+ iret = xclExecBuf (priv->xcl_handle, slot->ert_cmd_buf.bo);
+
+ if (iret) {
+    GST_ERROR_OBJECT (self, "failed to execute command %d", iret);
+    GST_ELEMENT_ERROR (self, RESOURCE, FAILED, NULL,
+        ("failed to issue execute command. reason : %s", strerror (errno)));
+    return FALSE;
+ }
+
+  return TRUE;
+}
+
+/* waits for the command of slot to complete. A wakeup may be for another
+ * command in flight, so the state is checked before each wait */
+static gboolean
+ivas_xabrscaler_wait (GstIvasXAbrScaler * self, IvasXAbrScalerSlot * slot)
+{
+  GstIvasXAbrScalerPrivate *priv = self->priv;
+  struct ert_start_kernel_cmd *ert_cmd =
+      (struct ert_start_kernel_cmd *) (slot->ert_cmd_buf.user_ptr);
+  int iret;
+  uint32_t chan_id = 0;
+  GstMemory *mem = NULL;
+
+  while (ert_cmd->state != ERT_CMD_STATE_COMPLETED) {
+    iret = xclExecWait (priv->xcl_handle, MULTI_SCALER_TIMEOUT);
+    if (iret < 0) {
+      GST_ERROR_OBJECT (self, "ExecWait ret = %d. reason : %s", iret,
+          strerror (errno));
+      GST_ELEMENT_ERROR (self, RESOURCE, FAILED, NULL,
+          ("error in processing a frame. reason : %s", strerror (errno)));
+      return FALSE;
+    } else if (!iret) {
+      GST_ERROR_OBJECT (self, "timeout on execwait");
+      GST_ELEMENT_ERROR (self, RESOURCE, FAILED, NULL,
+          ("timeout occured in processing a frame. reason : %s", strerror (errno)));
+      return FALSE;
+    }
+  }
+
+  for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
+    mem = gst_buffer_get_memory (slot->outbufs[chan_id], 0);
+    if (mem == NULL) {
+      GST_ERROR_OBJECT (self,
+          "chan-%d : failed to get memory from output buffer", chan_id);
+      return FALSE;
+    }
+#ifdef XLNX_PCIe_PLATFORM
+    gst_ivas_memory_set_sync_flag (mem, IVAS_SYNC_FROM_DEVICE);
+#endif
+    gst_memory_unref (mem);
+  }
+  return TRUE;
+}
+
+/* whether buf is laid out as info without any padding, so downstream not
+ * reading GstVideoMeta can take it as is */
+static gboolean
+ivas_xabrscaler_has_default_layout (GstVideoInfo * info, GstBuffer * buf)
+{
+  GstVideoMeta *vmeta = gst_buffer_get_video_meta (buf);
+  guint plane;
+
+  if (!vmeta || vmeta->n_planes != GST_VIDEO_INFO_N_PLANES (info))
+    return FALSE;
+
+  for (plane = 0; plane < vmeta->n_planes; plane++) {
+    if (vmeta->stride[plane] != GST_VIDEO_INFO_PLANE_STRIDE (info, plane) ||
+        vmeta->offset[plane] != GST_VIDEO_INFO_PLANE_OFFSET (info, plane))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* copies the visible rows of each plane, honouring both strides. Planes
+ * with equal strides are copied in one go */
+static void
+ivas_xabrscaler_copy_frame (GstVideoFrame * dest, GstVideoFrame * src)
+{
+  const GstIvasVideoFormatInfo *finfo;
+  guint plane, row, rows, row_bytes;
+  gint src_stride, dest_stride;
+  guint8 *sp, *dp;
+
+  finfo = gst_ivas_video_format_get_info (GST_VIDEO_FRAME_FORMAT (src));
+  if (!finfo) {
+    gst_video_frame_copy (dest, src);
+    return;
+  }
+
+  for (plane = 0; plane < finfo->n_planes; plane++) {
+    sp = GST_VIDEO_FRAME_PLANE_DATA (src, plane);
+    dp = GST_VIDEO_FRAME_PLANE_DATA (dest, plane);
+    src_stride = GST_VIDEO_FRAME_PLANE_STRIDE (src, plane);
+    dest_stride = GST_VIDEO_FRAME_PLANE_STRIDE (dest, plane);
+    rows = GST_VIDEO_SUB_SCALE (finfo->h_sub[plane],
+        GST_VIDEO_FRAME_HEIGHT (src));
+    row_bytes = gst_ivas_video_format_row_bytes (finfo, plane,
+        GST_VIDEO_FRAME_WIDTH (src));
+
+    if (!rows)
+      continue;
+
+    if (src_stride == dest_stride) {
+      memcpy (dp, sp, (gsize) src_stride * (rows - 1) + row_bytes);
+      continue;
+    }
+
+    for (row = 0; row < rows; row++) {
+      memcpy (dp, sp, row_bytes);
+      sp += src_stride;
+      dp += dest_stride;
+    }
+  }
+}
+
+/* unrefs the buffers a slot still holds */
+static void
+ivas_xabrscaler_slot_clear (IvasXAbrScalerSlot * slot)
+{
+  guint chan_id;
+
+  if (slot->inbuf) {
+    gst_buffer_unref (slot->inbuf);
+    slot->inbuf = NULL;
+  }
+  for (chan_id = 0; chan_id < MAX_CHANNELS; chan_id++) {
+    if (slot->outbufs[chan_id]) {
+      gst_buffer_unref (slot->outbufs[chan_id]);
+      slot->outbufs[chan_id] = NULL;
+    }
+  }
+}
+
+/* pushes the scaled outputs of a completed slot and releases its buffers */
+static GstFlowReturn
+ivas_xabrscaler_push_outputs (GstIvasXAbrScaler * self,
+    IvasXAbrScalerSlot * slot)
+{
+  GstBuffer *inbuf = slot->inbuf;
+  GstFlowReturn fret = GST_FLOW_OK;
+  guint chan_id = 0;
+
+  /* pad push of each output buffer to respective srcpad */
+  for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
+    GstBuffer *outbuf = slot->outbufs[chan_id];
+    GstIvasXAbrScalerPad *srcpad =
+        gst_ivas_xabrscaler_srcpad_at_index (self, chan_id);
+    GstMeta *in_meta;
+
+    slot->outbufs[chan_id] = NULL;
+
+    gst_buffer_copy_into (outbuf, inbuf,
+        (GstBufferCopyFlags) (GST_BUFFER_COPY_FLAGS |
+            GST_BUFFER_COPY_TIMESTAMPS), 0, -1);
+
+    /* Scaling of input ivas metadata based on output resolution */
+    in_meta = gst_buffer_get_meta (inbuf, gst_inference_meta_api_get_type ());
+
+    if (in_meta) {
+      GstVideoMetaTransform trans = { self->priv->in_vinfo, srcpad->out_vinfo };
+      GQuark scale_quark = gst_video_meta_transform_scale_get_quark ();
+
+      GST_DEBUG_OBJECT (srcpad, "attaching scaled inference metadata");
+      in_meta->info->transform_func (outbuf, (GstMeta *) in_meta,
+          inbuf, scale_quark, &trans);
+    }
+
+    /* buffers without padding are pushed as is even when a copy is needed */
+    if (self->priv->need_copy[chan_id] &&
+        !ivas_xabrscaler_has_default_layout (srcpad->out_vinfo, outbuf)) {
+      GstBuffer *new_outbuf = NULL;
+      GstVideoFrame new_frame, out_frame;
+
+      fret = gst_buffer_pool_acquire_buffer (srcpad->copy_pool, &new_outbuf,
+          NULL);
+      if (fret != GST_FLOW_OK) {
+        GST_DEBUG_OBJECT (srcpad, "failed to acquire buffer from pool %p. "
+            "reason : %s", srcpad->copy_pool, gst_flow_get_name (fret));
+        gst_buffer_unref (outbuf);
+        goto out;
+      }
+
+      if (!gst_video_frame_map (&out_frame, srcpad->out_vinfo, outbuf,
+              GST_MAP_READ)) {
+        GST_ERROR_OBJECT (srcpad, "failed to map output buffer");
+        gst_buffer_unref (outbuf);
+        gst_buffer_unref (new_outbuf);
+        fret = GST_FLOW_ERROR;
+        goto out;
+      }
+      if (!gst_video_frame_map (&new_frame, srcpad->out_vinfo, new_outbuf,
+              GST_MAP_WRITE)) {
+        GST_ERROR_OBJECT (srcpad, "failed to map copy buffer");
+        gst_video_frame_unmap (&out_frame);
+        gst_buffer_unref (outbuf);
+        gst_buffer_unref (new_outbuf);
+        fret = GST_FLOW_ERROR;
+        goto out;
+      }
+      GST_CAT_LOG_OBJECT (GST_CAT_PERFORMANCE, srcpad,
+        "slow copy data from %p to %p", outbuf, new_outbuf);
+      ivas_xabrscaler_copy_frame (&new_frame, &out_frame);
+      gst_video_frame_unmap (&out_frame);
+      gst_video_frame_unmap (&new_frame);
+
+      gst_buffer_copy_into (new_outbuf, outbuf, GST_BUFFER_COPY_METADATA, 0, -1);
+      gst_buffer_unref (outbuf);
+      GST_LOG_OBJECT (srcpad,
+        "pushing outbuf %p with pts = %" GST_TIME_FORMAT " dts = %"
+        GST_TIME_FORMAT " duration = %" GST_TIME_FORMAT, new_outbuf,
+        GST_TIME_ARGS (GST_BUFFER_PTS (new_outbuf)),
+        GST_TIME_ARGS (GST_BUFFER_DTS (new_outbuf)),
+        GST_TIME_ARGS (GST_BUFFER_DURATION (new_outbuf)));
+
+      fret = gst_pad_push (GST_PAD_CAST (srcpad), new_outbuf);
+      if (G_UNLIKELY (fret != GST_FLOW_OK)) {
+        if (fret == GST_FLOW_EOS)
+	  GST_DEBUG_OBJECT (self, "failed to push buffer. reason : %s",
+          gst_flow_get_name (fret));
+	else
+          GST_ERROR_OBJECT (self, "failed to push buffer. reason : %s",
+          gst_flow_get_name (fret));
+        goto out;
+      }
+
+    } else {
+      GST_LOG_OBJECT (srcpad,
+          "pushing outbuf %p with pts = %" GST_TIME_FORMAT " dts = %"
+          GST_TIME_FORMAT " duration = %" GST_TIME_FORMAT, outbuf,
+          GST_TIME_ARGS (GST_BUFFER_PTS (outbuf)),
+          GST_TIME_ARGS (GST_BUFFER_DTS (outbuf)),
+          GST_TIME_ARGS (GST_BUFFER_DURATION (outbuf)));
+
+      fret = gst_pad_push (GST_PAD_CAST (srcpad), outbuf);
+      if (G_UNLIKELY (fret != GST_FLOW_OK)) {
+        if (fret == GST_FLOW_EOS)
+	  GST_DEBUG_OBJECT (self, "failed to push buffer. reason : %s",
+          gst_flow_get_name (fret));
+	else
+          GST_ERROR_OBJECT (self, "failed to push buffer. reason : %s",
+          gst_flow_get_name (fret));
+        goto out;
+      }
+    }
+  }
+
+out:
+  ivas_xabrscaler_slot_clear (slot);
+  return fret;
+}
+
+static gpointer
+ivas_xabrscaler_done_thread (gpointer data)
+{
+  GstIvasXAbrScaler *self = GST_IVAS_XABRSCALER (data);
+  GstIvasXAbrScalerPrivate *priv = self->priv;
+  IvasXAbrScalerSlot *slot;
+  GstFlowReturn fret;
 
-    msPtr->msc_blkmm_hfltCoeff = 0;
-    msPtr->msc_blkmm_vfltCoeff = 0;
-    if (chan_id == (self->num_request_pads - 1))
-      msPtr->msc_nxtaddr = 0;
-    else
-      msPtr->msc_nxtaddr = priv->msPtr[chan_id + 1].phy_addr;
-    msPtr->msc_blkmm_hfltCoeff = priv->Hcoff[chan_id].phy_addr;
-    msPtr->msc_blkmm_vfltCoeff = priv->Vcoff[chan_id].phy_addr;
+  GST_DEBUG_OBJECT (self, "completion thread started");
 
-    /* set the output as input for next descripto if any */
-    phy_in_0 = msPtr->msc_dstImgBuf0;
-    phy_in_1 = msPtr->msc_dstImgBuf1;
-    width = msPtr->msc_widthOut;
-    height = msPtr->msc_heightOut;
-    msc_inPixelFmt = msPtr->msc_outPixelFmt;
-    stride = msPtr->msc_strideOut;
+  g_mutex_lock (&priv->slot_lock);
+  while (TRUE) {
+    while (!priv->n_inflight && !priv->stop_thread)
+      g_cond_wait (&priv->slot_cond, &priv->slot_lock);
+
+    /* frames still in flight are completed before stopping */
+    if (!priv->n_inflight)
+      break;
+
+    slot = &priv->slots[priv->done_slot];
+    g_mutex_unlock (&priv->slot_lock);
+
+    if (ivas_xabrscaler_wait (self, slot)) {
+      fret = ivas_xabrscaler_push_outputs (self, slot);
+    } else {
+      ivas_xabrscaler_slot_clear (slot);
+      fret = GST_FLOW_ERROR;
+    }
+
+    g_mutex_lock (&priv->slot_lock);
+    /* returned from chain on the next frame, first error wins */
+    if (priv->done_ret == GST_FLOW_OK)
+      priv->done_ret = fret;
+    priv->done_slot = (priv->done_slot + 1) % priv->n_slots;
+    priv->n_inflight--;
+    g_cond_broadcast (&priv->slot_cond);
   }
-  priv->is_coeff = false;
-  return TRUE;
+  g_mutex_unlock (&priv->slot_lock);
+
+  GST_DEBUG_OBJECT (self, "completion thread stopped");
+  return NULL;
 }
 
 static gboolean
-ivas_xabrscaler_process (GstIvasXAbrScaler * self)
+ivas_xabrscaler_start_done_thread (GstIvasXAbrScaler * self)
 {
   GstIvasXAbrScalerPrivate *priv = self->priv;
-  struct ert_start_kernel_cmd *ert_cmd =
-      (struct ert_start_kernel_cmd *) (priv->ert_cmd_buf->user_ptr);
-  int iret;
-  uint32_t value = 0, chan_id = 0;
-  uint64_t desc_addr = 0;
-  uint32_t payload_offset = 0;
-  bool ret;
-  GstMemory *mem = NULL;
 
-  /* set descriptor */
-  ret = xlnx_multiscaler_descriptor_create (self);
-  if (!ret)
-    return FALSE;
-#ifdef XLNX_PCIe_PLATFORM
-  ret = xlnx_abr_desc_syncBO (self);
-  if (!ret)
-    return FALSE;
-#endif
+  priv->stop_thread = FALSE;
+  priv->n_inflight = 0;
+  priv->done_ret = GST_FLOW_OK;
 
-  /*to support 128 cu index we need 3 extra cu mask in ert command buffer */
-  ert_cmd->extra_cu_masks = 3;
-  payload_offset = ert_cmd->extra_cu_masks * 4; /* 4 bytes per mask */
+  if (self->queue_depth < 2)
+    return TRUE;
 
-  /* prgram registers */
-  value = self->num_request_pads;
-  ivas_xabrscaler_reg_write (self, &value, sizeof (value),
-      (XV_MULTI_SCALER_CTRL_ADDR_HWREG_NUM_OUTS_DATA + payload_offset));
-  desc_addr = priv->msPtr[0].phy_addr;
-  ivas_xabrscaler_reg_write (self, &desc_addr, sizeof (desc_addr),
-      (XV_MULTI_SCALER_CTRL_ADDR_HWREG_START_ADDR_DATA + payload_offset));
+  priv->done_thread = g_thread_try_new ("abrscaler-done",
+      ivas_xabrscaler_done_thread, self, NULL);
+  if (!priv->done_thread) {
+    GST_ERROR_OBJECT (self, "failed to create completion thread");
+    return FALSE;
+  }
+  return TRUE;
+}
 
-  /* start ert command */
-  ert_cmd->state = ERT_CMD_STATE_NEW;
-  ert_cmd->opcode = ERT_START_CU;
+static void
+ivas_xabrscaler_stop_done_thread (GstIvasXAbrScaler * self)
+{
+  GstIvasXAbrScalerPrivate *priv = self->priv;
 
-  if ( priv->cu_index > 31) {
-     ert_cmd->cu_mask = 0;
-     if (priv->cu_index > 63) {
-       ert_cmd->data[0] = 0;
-       if (priv->cu_index > 96) {
-         ert_cmd->data[1] = 0;
-         ert_cmd->data[2] = (1 << (priv->cu_index - 96));
-       } else {
-         ert_cmd->data[1] = (1 << (priv->cu_index - 64));
-         ert_cmd->data[2] = 0;
-       }
-    } else {
-       ert_cmd->data[0] = (1 << (priv->cu_index - 32));
-   }
- } else {
-      ert_cmd->cu_mask = (1 << priv->cu_index);
-      ert_cmd->data[0] = 0;
-      ert_cmd->data[1] = 0;
-      ert_cmd->data[2] = 0;
- }
+  if (!priv->done_thread)
+    return;
 
- ert_cmd->count = (self->priv->max_offset >> 2) + 1;
- iret = xclExecBuf (priv->xcl_handle, priv->ert_cmd_buf->bo);
+  g_mutex_lock (&priv->slot_lock);
+  priv->stop_thread = TRUE;
+  g_cond_broadcast (&priv->slot_cond);
+  g_mutex_unlock (&priv->slot_lock);
 
- if (iret) {
-    GST_ERROR_OBJECT (self, "failed to execute command %d", iret);
-    GST_ELEMENT_ERROR (self, RESOURCE, FAILED, NULL,
-        ("failed to issue execute command. reason : %s", strerror (errno)));
-    return FALSE;
- }
+  g_thread_join (priv->done_thread);
+  priv->done_thread = NULL;
+}
 
-  do {
-    iret = xclExecWait (priv->xcl_handle, MULTI_SCALER_TIMEOUT);
-    if (iret < 0) {
-      GST_ERROR_OBJECT (self, "ExecWait ret = %d. reason : %s", iret,
-          strerror (errno));
-      GST_ELEMENT_ERROR (self, RESOURCE, FAILED, NULL,
-          ("error in processing a frame. reason : %s", strerror (errno)));
-      return FALSE;
-    } else if (!iret) {
-      GST_ERROR_OBJECT (self, "timeout on execwait");
-      GST_ELEMENT_ERROR (self, RESOURCE, FAILED, NULL,
-          ("timeout occured in processing a frame. reason : %s", strerror (errno)));
-      return FALSE;
-    }
-  } while (ert_cmd->state != ERT_CMD_STATE_COMPLETED);
+/* waits until every submitted frame has been pushed */
+static void
+ivas_xabrscaler_drain (GstIvasXAbrScaler * self)
+{
+  GstIvasXAbrScalerPrivate *priv = self->priv;
 
-  for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
-    mem = gst_buffer_get_memory (priv->outbufs[chan_id], 0);
-    if (mem == NULL) {
-      GST_ERROR_OBJECT (self,
-          "chan-%d : failed to get memory from output buffer", chan_id);
-      return FALSE;
-    }
-#ifdef XLNX_PCIe_PLATFORM
-    gst_ivas_memory_set_sync_flag (mem, IVAS_SYNC_FROM_DEVICE);
-#endif
-    gst_memory_unref (mem);
-  }
-  return TRUE;
+  g_mutex_lock (&priv->slot_lock);
+  while (priv->n_inflight)
+    g_cond_wait (&priv->slot_cond, &priv->slot_lock);
+  g_mutex_unlock (&priv->slot_lock);
 }
 
 static void
@@ -2138,6 +2640,8 @@ gst_ivas_xabrscaler_finalize (GObject * object)
 
   g_hash_table_unref (self->pad_indexes);
   gst_video_info_free (self->priv->in_vinfo);
+  g_mutex_clear (&self->priv->slot_lock);
+  g_cond_clear (&self->priv->slot_cond);
 
   g_free (self->kern_name);
   g_free (self->xclbin_path);
@@ -2237,6 +2741,23 @@ gst_ivas_xabrscaler_class_init (GstIvasXAbrScalerClass * klass)
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
           GST_PARAM_MUTABLE_READY));
 
+  g_object_class_install_property (gobject_class, PROP_QUEUE_DEPTH,
+      g_param_spec_uint ("queue-depth", "Frames in flight",
+          "Number of frames submitted to the scaler at once. With more than"
+          " one, the next frame is prepared while the current one is scaled"
+          " and output buffers are pushed from a separate thread",
+          1, IVAS_XABRSCALER_MAX_QUEUE_DEPTH,
+          IVAS_XABRSCALER_DEFAULT_QUEUE_DEPTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_MEM_BANK,
+      g_param_spec_uint ("mem-bank", "Device memory bank",
+          "Device memory bank the element allocates its buffers from",
+          0, 31, DEFAULT_MEM_BANK,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
 #ifdef ENABLE_PPE_SUPPORT
   g_object_class_install_property (gobject_class, PROP_ALPHA_R,
       g_param_spec_float ("alpha-r",
@@ -2300,6 +2821,8 @@ gst_ivas_xabrscaler_init (GstIvasXAbrScaler * self)
   self->num_taps = IVAS_XABRSCALER_DEFAULT_NUM_TAPS;
   self->coef_load_type = IVAS_XABRSCALER_DEFAULT_COEF_LOAD_TYPE;
   self->avoid_output_copy = IVAS_XABRSCALER_AVOID_OUTPUT_COPY_DEFAULT;
+  self->queue_depth = IVAS_XABRSCALER_DEFAULT_QUEUE_DEPTH;
+  self->mem_bank = DEFAULT_MEM_BANK;
 #ifdef ENABLE_PPE_SUPPORT
   self->alpha_r = 0;
   self->alpha_g = 0;
@@ -2321,8 +2844,9 @@ gst_ivas_xabrscaler_init (GstIvasXAbrScaler * self)
   self->priv->in_vinfo = gst_video_info_new ();
   self->priv->validate_import = TRUE;
   self->priv->input_pool = NULL;
-  self->priv->ert_cmd_buf = NULL;
   gst_video_info_init (self->priv->in_vinfo);
+  g_mutex_init (&self->priv->slot_lock);
+  g_cond_init (&self->priv->slot_cond);
 
   for (idx = 0; idx < MAX_CHANNELS; idx++) {
     self->priv->need_copy[idx] = TRUE;
@@ -2488,24 +3012,40 @@ gst_ivas_xabrscaler_set_property (GObject * object, guint prop_id,
     case PROP_AVOID_OUTPUT_COPY:
       self->avoid_output_copy = g_value_get_boolean (value);
       break;
+    case PROP_QUEUE_DEPTH:
+      if (GST_STATE (self) > GST_STATE_READY) {
+        g_warning ("can't set queue-depth when instance is streaming");
+        return;
+      }
+      self->queue_depth = g_value_get_uint (value);
+      break;
+    case PROP_MEM_BANK:
+      self->mem_bank = g_value_get_uint (value);
+      break;
 #ifdef ENABLE_PPE_SUPPORT
     case PROP_ALPHA_R:
       self->alpha_r = g_value_get_float (value);
+      ivas_xabrscaler_invalidate_descriptors (self);
       break;
     case PROP_ALPHA_G:
       self->alpha_g = g_value_get_float (value);
+      ivas_xabrscaler_invalidate_descriptors (self);
       break;
     case PROP_ALPHA_B:
       self->alpha_b = g_value_get_float (value);
+      ivas_xabrscaler_invalidate_descriptors (self);
       break;
     case PROP_BETA_R:
       self->beta_r = g_value_get_float (value);
+      ivas_xabrscaler_invalidate_descriptors (self);
       break;
     case PROP_BETA_G:
       self->beta_g = g_value_get_float (value);
+      ivas_xabrscaler_invalidate_descriptors (self);
       break;
     case PROP_BETA_B:
       self->beta_b = g_value_get_float (value);
+      ivas_xabrscaler_invalidate_descriptors (self);
       break;
 #endif
 #ifdef ENABLE_XRM_SUPPORT
@@ -2552,6 +3092,12 @@ gst_ivas_xabrscaler_get_property (GObject * object, guint prop_id,
     case PROP_AVOID_OUTPUT_COPY:
       g_value_set_boolean (value, self->avoid_output_copy);
       break;
+    case PROP_QUEUE_DEPTH:
+      g_value_set_uint (value, self->queue_depth);
+      break;
+    case PROP_MEM_BANK:
+      g_value_set_uint (value, self->mem_bank);
+      break;
 #ifdef ENABLE_PPE_SUPPORT
     case PROP_ALPHA_R:
       g_value_set_float (value, self->alpha_r);
@@ -2603,6 +3149,8 @@ gst_ivas_xabrscaler_change_state (GstElement * element,
       GST_INFO_OBJECT (self, "successfully created xrm context");
       self->priv->has_error = FALSE;
 #endif
+      if (!ivas_xabrscaler_start_done_thread (self))
+        return GST_STATE_CHANGE_FAILURE;
       break;
     }
     default:
@@ -2614,6 +3162,9 @@ gst_ivas_xabrscaler_change_state (GstElement * element,
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
 
+      /* pads are inactive now, frames still in flight are only released */
+      ivas_xabrscaler_stop_done_thread (self);
+
       for (idx = 0; idx < g_list_length (self->srcpads); idx++) {
         GstIvasXAbrScalerPad *srcpad = gst_ivas_xabrscaler_srcpad_at_index (self, idx);
         if (srcpad->pool && gst_buffer_pool_is_active (srcpad->pool)) {
@@ -2623,6 +3174,13 @@ gst_ivas_xabrscaler_change_state (GstElement * element,
           gst_clear_object (&srcpad->pool);
           srcpad->pool = NULL;
         }
+        if (srcpad->copy_pool) {
+          if (gst_buffer_pool_is_active (srcpad->copy_pool)
+              && !gst_buffer_pool_set_active (srcpad->copy_pool, FALSE))
+            GST_ERROR_OBJECT (self, "failed to deactivate pool %" GST_PTR_FORMAT,
+              srcpad->copy_pool);
+          gst_clear_object (&srcpad->copy_pool);
+        }
       }
 
       if (self->priv->input_pool && gst_buffer_pool_is_active (self->priv->input_pool)) {
@@ -2635,12 +3193,6 @@ gst_ivas_xabrscaler_change_state (GstElement * element,
 
       ivas_xabrscaler_free_internal_buffers (self);
 
-      if (self->priv->ert_cmd_buf) {
-        free_xrt_buffer (self->priv->xcl_handle, self->priv->ert_cmd_buf);
-        free (self->priv->ert_cmd_buf);
-        self->priv->ert_cmd_buf = NULL;
-      }
-
       ivas_xabrscaler_destroy_context (self);
       break;
     default:
@@ -3330,6 +3882,44 @@ error_cleanup:
   }
 }
 
+/* pool for frames copied out of the scaler's padded buffers. Prefers the
+ * pool downstream proposed, else makes a plain video pool */
+static GstBufferPool *
+ivas_xabrscaler_create_copy_pool (GstIvasXAbrScaler * self,
+    GstIvasXAbrScalerPad * srcpad, GstCaps * outcaps, GstBufferPool * ds_pool,
+    guint min, guint max)
+{
+  GstBufferPool *pool = NULL;
+  GstStructure *config;
+  guint size = GST_VIDEO_INFO_SIZE (srcpad->out_vinfo);
+
+  if (ds_pool) {
+    config = gst_buffer_pool_get_config (ds_pool);
+    gst_buffer_pool_config_set_params (config, outcaps, size, min, max);
+    if (gst_buffer_pool_set_config (ds_pool, config)) {
+      pool = gst_object_ref (ds_pool);
+    } else {
+      GST_DEBUG_OBJECT (srcpad, "downstream pool %" GST_PTR_FORMAT
+          " rejected our configuration", ds_pool);
+    }
+  }
+
+  if (!pool) {
+    pool = gst_video_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, outcaps, size, 2, 0);
+    if (!gst_buffer_pool_set_config (pool, config)) {
+      GST_ERROR_OBJECT (srcpad, "failed to configure copy pool");
+      gst_object_unref (pool);
+      return NULL;
+    }
+  }
+
+  GST_INFO_OBJECT (srcpad, "copying output frames into pool %" GST_PTR_FORMAT,
+      pool);
+  return pool;
+}
+
 static gboolean
 ivas_xabrscaler_decide_allocation (GstIvasXAbrScaler * self,
     GstIvasXAbrScalerPad * srcpad, GstQuery * query, GstCaps * outcaps)
@@ -3342,6 +3932,8 @@ ivas_xabrscaler_decide_allocation (GstIvasXAbrScaler * self,
   GstStructure *config = NULL;
   GstVideoInfo out_vinfo;
   gint srcpadIdx = gst_ivas_xabrscaler_srcpad_get_index(self, srcpad);
+  GstBufferPool *ds_pool = NULL;
+  guint ds_min = 0, ds_max = 0;
 
   /* we got configuration from our peer or the decide_allocation method,
    * parse them */
@@ -3363,6 +3955,12 @@ ivas_xabrscaler_decide_allocation (GstIvasXAbrScaler * self,
 
   if (gst_query_get_n_allocation_pools (query) > 0) {
     gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
+    /* a downstream pool laid out the default way can take copied frames */
+    if (pool && !GST_IS_IVAS_BUFFER_POOL (pool)) {
+      ds_pool = gst_object_ref (pool);
+      ds_min = min;
+      ds_max = max;
+    }
     size = MAX (size, out_vinfo.size);
     update_pool = TRUE;
     if (min == 0)
@@ -3375,6 +3973,11 @@ ivas_xabrscaler_decide_allocation (GstIvasXAbrScaler * self,
     update_pool = FALSE;
   }
 
+  /* frames in flight hold an output buffer each */
+  min += self->queue_depth - 1;
+  if (max && max < min)
+    max = min;
+
   /* Check if the proposed pool is IVAS Buffer Pool and stride is aligned with (8 * ppc)
    * If otherwise, discard the pool. Will create a new one */
   if (pool) {
@@ -3456,7 +4059,8 @@ ivas_xabrscaler_decide_allocation (GstIvasXAbrScaler * self,
 
   if (!allocator) {
     /* making sdx allocator for the HW mode without dmabuf */
-    allocator = gst_ivas_allocator_new (self->dev_index, NEED_DMABUF);
+    allocator = gst_ivas_allocator_new_with_bank (self->dev_index,
+        NEED_DMABUF, self->mem_bank);
     params.flags = GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
     params.flags |= GST_IVAS_ALLOCATOR_FLAG_MEM_INIT;
     GST_INFO_OBJECT (srcpad, "creating new xrt allocator %" GST_PTR_FORMAT,
@@ -3481,6 +4085,21 @@ next:
 
   if (!pool) {
     GstVideoAlignment align;
+    guint ds_stride_align, ds_elevation_align;
+
+    /* take the layout IVAS elements downstream need into account as well,
+     * so they can use our buffers without copying them */
+    if (gst_ivas_buffer_pool_query_get_align (query, &ds_stride_align,
+            &ds_elevation_align)) {
+      self->out_stride_align =
+          gst_ivas_buffer_pool_lcm_align (self->out_stride_align,
+          ds_stride_align);
+      self->out_elevation_align =
+          gst_ivas_buffer_pool_lcm_align (self->out_elevation_align,
+          ds_elevation_align);
+      GST_DEBUG_OBJECT (srcpad, "downstream needs stride align %u, elevation "
+          "align %u", ds_stride_align, ds_elevation_align);
+    }
 
     pool =
         gst_ivas_buffer_pool_new (self->out_stride_align,
@@ -3531,6 +4150,15 @@ next:
     GST_INFO_OBJECT (srcpad, "Don't copy output frames");
   }
 
+  if (self->priv->need_copy[srcpadIdx]) {
+    srcpad->copy_pool = ivas_xabrscaler_create_copy_pool (self, srcpad,
+        outcaps, ds_pool != pool ? ds_pool : NULL, ds_min, ds_max);
+    if (!srcpad->copy_pool)
+      goto error;
+  }
+  if (ds_pool)
+    gst_object_unref (ds_pool);
+
   GST_INFO_OBJECT (srcpad,
       "allocated pool %p with parameters : size %u, min_buffers = %u, max_buffers = %u",
       pool, size, min, max);
@@ -3554,6 +4182,8 @@ error:
     gst_object_unref (allocator);
   if (pool)
     gst_object_unref (pool);
+  if (ds_pool)
+    gst_object_unref (ds_pool);
   return FALSE;
 }
 
@@ -3581,6 +4211,7 @@ gst_ivas_xabrscaler_sink_setcaps (GstIvasXAbrScaler * self, GstPad * sinkpad,
       incaps);
 
   self->priv->validate_import = TRUE;
+  ivas_xabrscaler_invalidate_descriptors (self);
 
   /* store sinkpad info */
   if (!gst_video_info_from_caps (self->priv->in_vinfo, in_caps)) {
@@ -3654,24 +4285,8 @@ gst_ivas_xabrscaler_sink_setcaps (GstIvasXAbrScaler * self, GstPad * sinkpad,
   }
 #endif
 
-  if (!priv->ert_cmd_buf) { /* one time allocation memory */
-    gint iret;
-
-    priv->ert_cmd_buf = (xrt_buffer *) calloc (1, sizeof (xrt_buffer));
-    if (priv->ert_cmd_buf == NULL) {
-      GST_ERROR_OBJECT (self, "failed to allocate ert cmd memory");
-      goto failed_configure;
-    }
-
-    /* allocate ert command buffer */
-    iret = alloc_xrt_buffer (priv->xcl_handle, ERT_CMD_SIZE,
-            XCL_BO_SHARED_VIRTUAL, XCL_BO_FLAGS_EXECBUF, priv->ert_cmd_buf);
-    if (iret < 0) {
-      GST_ERROR_OBJECT (self, "failed to allocate ert command buffer..");
-      goto failed_configure;
-    }
-
-    /* allocate internal buffers */
+  if (!priv->n_slots) { /* one time allocation memory */
+    /* allocate ert command and internal buffers */
     bret = ivas_xabrscaler_allocate_internal_buffers (self);
     if (!bret)
       goto failed_configure;
@@ -3702,6 +4317,12 @@ gst_ivas_xabrscaler_sink_setcaps (GstIvasXAbrScaler * self, GstPad * sinkpad,
         GST_ERROR_OBJECT (srcpad, "failed to activate pool");
         goto failed_configure;
       }
+
+      if (srcpad->copy_pool
+          && !gst_buffer_pool_set_active (srcpad->copy_pool, TRUE)) {
+        GST_ERROR_OBJECT (srcpad, "failed to activate copy pool");
+        goto failed_configure;
+      }
     }
 
     if (self->num_taps == 12) {
@@ -3710,10 +4331,15 @@ gst_ivas_xabrscaler_sink_setcaps (GstIvasXAbrScaler * self, GstPad * sinkpad,
       if (self->scale_mode == POLYPHASE) {
         float scale = (float) GST_VIDEO_INFO_HEIGHT (srcpad->in_vinfo)
             / (float) GST_VIDEO_INFO_HEIGHT (srcpad->out_vinfo);
+        int16_t hcoeffs[64][12] = { {0} }, vcoeffs[64][12] = { {0} };
+
         GST_INFO_OBJECT (self, "preparing coefficients with scaling ration %f and taps %d",
             scale, self->num_taps);
-        xlnx_multiscaler_coff_fill (priv->Hcoff[idx].user_ptr,
-            priv->Vcoff[idx].user_ptr, scale);
+        xlnx_multiscaler_coff_fill (hcoeffs, vcoeffs, scale);
+        ivas_xabrscaler_set_coeffs (&priv->Hcoff[idx], &priv->Hcoff_dirty[idx],
+            hcoeffs);
+        ivas_xabrscaler_set_coeffs (&priv->Vcoff[idx], &priv->Vcoff_dirty[idx],
+            vcoeffs);
       }
     }
 
@@ -3727,6 +4353,8 @@ gst_ivas_xabrscaler_sink_setcaps (GstIvasXAbrScaler * self, GstPad * sinkpad,
     }
   }
 
+  ivas_xabrscaler_share_coeffs (self);
+
 #ifdef XLNX_PCIe_PLATFORM
   if (!xlnx_abr_coeff_syncBO (self))
     return FALSE;
@@ -3778,6 +4406,10 @@ gst_ivas_xabrscaler_sink_event (GstPad * pad, GstObject * parent,
   GST_DEBUG_OBJECT (pad, "received event '%s' %p %" GST_PTR_FORMAT,
       gst_event_type_get_name (GST_EVENT_TYPE (event)), event, event);
 
+  /* keep serialized events behind the frames still being scaled */
+  if (GST_EVENT_IS_SERIALIZED (event))
+    ivas_xabrscaler_drain (self);
+
   switch (GST_EVENT_TYPE (event)) {
     case GST_EVENT_CAPS:{
       GstCaps *caps;
@@ -3787,6 +4419,12 @@ gst_ivas_xabrscaler_sink_event (GstPad * pad, GstObject * parent,
       gst_event_unref (event);
       break;
     }
+    case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (&self->priv->slot_lock);
+      self->priv->done_ret = GST_FLOW_OK;
+      g_mutex_unlock (&self->priv->slot_lock);
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
     default:
       ret = gst_pad_event_default (pad, parent, event);
       break;
@@ -3828,19 +4466,26 @@ ivas_xabrscaler_propose_allocation (GstIvasXAbrScaler * self, GstQuery * query)
         return FALSE;
       }
 #endif
-      allocator = gst_ivas_allocator_new (self->dev_index, NEED_DMABUF);
+      allocator = gst_ivas_allocator_new_with_bank (self->dev_index,
+          NEED_DMABUF, self->mem_bank);
       GST_INFO_OBJECT (self, "creating new xrt allocator %" GST_PTR_FORMAT,
           allocator);
 
       gst_query_add_allocation_param (query, allocator, &params);
     }
 
-    pool = gst_video_buffer_pool_new ();
+    /* scaler reads rows in WIDTH_ALIGN byte bursts, ask IVAS elements
+     * upstream to lay their output out that way */
+    if (allocator && GST_IS_IVAS_ALLOCATOR (allocator))
+      pool = gst_ivas_buffer_pool_new (WIDTH_ALIGN, 1);
+    else
+      pool = gst_video_buffer_pool_new ();
     GST_LOG_OBJECT (self, "allocated internal sink pool %p", pool);
 
     structure = gst_buffer_pool_get_config (pool);
 
-    gst_buffer_pool_config_set_params (structure, caps, size, 2, 0);
+    gst_buffer_pool_config_set_params (structure, caps, size,
+        1 + self->queue_depth, 0);
 
     gst_buffer_pool_config_set_allocator (structure, allocator, &params);
 
@@ -3853,6 +4498,8 @@ ivas_xabrscaler_propose_allocation (GstIvasXAbrScaler * self, GstQuery * query)
     if (!gst_buffer_pool_set_config (pool, structure))
       goto config_failed;
 
+    gst_ivas_buffer_pool_query_add_align (query, WIDTH_ALIGN, 1);
+
     GST_OBJECT_LOCK (self);
     gst_query_add_allocation_pool (query, pool, size, 2, 0);
 
@@ -3948,113 +4595,62 @@ static GstFlowReturn
 gst_ivas_xabrscaler_chain (GstPad * pad, GstObject * parent, GstBuffer * inbuf)
 {
   GstIvasXAbrScaler *self = GST_IVAS_XABRSCALER (parent);
+  GstIvasXAbrScalerPrivate *priv = self->priv;
+  IvasXAbrScalerSlot *slot;
   GstFlowReturn fret = GST_FLOW_OK;
-  guint chan_id = 0;
   gboolean bret = FALSE;
 
+  if (priv->n_slots > 1) {
+    /* all slots in flight, wait for the oldest frame to be pushed */
+    g_mutex_lock (&priv->slot_lock);
+    while (priv->n_inflight == priv->n_slots)
+      g_cond_wait (&priv->slot_cond, &priv->slot_lock);
+    fret = priv->done_ret;
+    g_mutex_unlock (&priv->slot_lock);
+
+    if (fret != GST_FLOW_OK) {
+      GST_DEBUG_OBJECT (self, "dropping buffer, completion thread returned %s",
+          gst_flow_get_name (fret));
+      goto error;
+    }
+  }
+  slot = &priv->slots[priv->cur_slot];
+
   bret = ivas_xabrscaler_prepare_input_buffer (self, &inbuf);
   if (!bret)
     goto error;
 
-  bret = ivas_xabrscaler_prepare_output_buffer (self);
+  bret = ivas_xabrscaler_prepare_output_buffer (self, slot);
   if (!bret)
     goto error;
 
-  bret = ivas_xabrscaler_process (self);
+  bret = ivas_xabrscaler_process (self, slot);
   if (!bret)
     goto error;
 
+  slot->inbuf = inbuf;
 
-  /* pad push of each output buffer to respective srcpad */
-  for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
-    GstBuffer *outbuf = self->priv->outbufs[chan_id];
-    GstIvasXAbrScalerPad *srcpad =
-        gst_ivas_xabrscaler_srcpad_at_index (self, chan_id);
-    GstMeta *in_meta;
-
-    gst_buffer_copy_into (outbuf, inbuf,
-        (GstBufferCopyFlags) (GST_BUFFER_COPY_FLAGS |
-            GST_BUFFER_COPY_TIMESTAMPS), 0, -1);
-
-    /* Scaling of input ivas metadata based on output resolution */
-    in_meta = gst_buffer_get_meta (inbuf, gst_inference_meta_api_get_type ());
-
-    if (in_meta) {
-      GstVideoMetaTransform trans = { self->priv->in_vinfo, srcpad->out_vinfo };
-      GQuark scale_quark = gst_video_meta_transform_scale_get_quark ();
-
-      GST_DEBUG_OBJECT (srcpad, "attaching scaled inference metadata");
-      in_meta->info->transform_func (outbuf, (GstMeta *) in_meta,
-          inbuf, scale_quark, &trans);
-    }
-
-    if (self->priv->need_copy[chan_id]) {
-      GstBuffer *new_outbuf;
-      GstVideoFrame new_frame, out_frame;
-      new_outbuf =
-        gst_buffer_new_and_alloc (GST_VIDEO_INFO_SIZE (srcpad->out_vinfo));
-      if (!new_outbuf) {
-        GST_ERROR_OBJECT (srcpad, "failed to allocate output buffer");
-        fret =  GST_FLOW_ERROR;
-        goto error2;
-      }
-
-      gst_video_frame_map (&out_frame, srcpad->out_vinfo, outbuf, GST_MAP_READ);
-      gst_video_frame_map (&new_frame, srcpad->out_vinfo, new_outbuf,
-        GST_MAP_WRITE);
-      GST_CAT_LOG_OBJECT (GST_CAT_PERFORMANCE, srcpad,
-        "slow copy data from %p to %p", outbuf, new_outbuf);
-      gst_video_frame_copy (&new_frame, &out_frame);
-      gst_video_frame_unmap (&out_frame);
-      gst_video_frame_unmap (&new_frame);
-
-      gst_buffer_copy_into (new_outbuf, outbuf, GST_BUFFER_COPY_METADATA, 0, -1);
-      gst_buffer_unref (outbuf);
-      GST_LOG_OBJECT (srcpad,
-        "pushing outbuf %p with pts = %" GST_TIME_FORMAT " dts = %"
-        GST_TIME_FORMAT " duration = %" GST_TIME_FORMAT, new_outbuf,
-        GST_TIME_ARGS (GST_BUFFER_PTS (new_outbuf)),
-        GST_TIME_ARGS (GST_BUFFER_DTS (new_outbuf)),
-        GST_TIME_ARGS (GST_BUFFER_DURATION (new_outbuf)));
-
-      fret = gst_pad_push (GST_PAD_CAST (srcpad), new_outbuf);
-      if (G_UNLIKELY (fret != GST_FLOW_OK)) {
-        if (fret == GST_FLOW_EOS)
-	  GST_DEBUG_OBJECT (self, "failed to push buffer. reason : %s",
-          gst_flow_get_name (fret));
-	else
-          GST_ERROR_OBJECT (self, "failed to push buffer. reason : %s",
-          gst_flow_get_name (fret));
-        goto error2;
-      }
-
-    } else {
-      GST_LOG_OBJECT (srcpad,
-          "pushing outbuf %p with pts = %" GST_TIME_FORMAT " dts = %"
-          GST_TIME_FORMAT " duration = %" GST_TIME_FORMAT, outbuf,
-          GST_TIME_ARGS (GST_BUFFER_PTS (outbuf)),
-          GST_TIME_ARGS (GST_BUFFER_DTS (outbuf)),
-          GST_TIME_ARGS (GST_BUFFER_DURATION (outbuf)));
-
-      fret = gst_pad_push (GST_PAD_CAST (srcpad), outbuf);
-      if (G_UNLIKELY (fret != GST_FLOW_OK)) {
-        if (fret == GST_FLOW_EOS)
-	  GST_DEBUG_OBJECT (self, "failed to push buffer. reason : %s",
-          gst_flow_get_name (fret));
-	else
-          GST_ERROR_OBJECT (self, "failed to push buffer. reason : %s",
-          gst_flow_get_name (fret));
-        goto error2;
-      }
+  if (priv->n_slots == 1) {
+    if (!ivas_xabrscaler_wait (self, slot)) {
+      ivas_xabrscaler_slot_clear (slot);
+      return GST_FLOW_ERROR;
     }
+    return ivas_xabrscaler_push_outputs (self, slot);
   }
 
-  gst_buffer_unref (inbuf);
-  return fret;
+  /* hand the frame over to the completion thread */
+  g_mutex_lock (&priv->slot_lock);
+  priv->cur_slot = (priv->cur_slot + 1) % priv->n_slots;
+  priv->n_inflight++;
+  g_cond_broadcast (&priv->slot_cond);
+  g_mutex_unlock (&priv->slot_lock);
+
+  return GST_FLOW_OK;
 
 error:
-error2:
   gst_buffer_unref (inbuf);
+  if (priv->n_slots)
+    ivas_xabrscaler_slot_clear (&priv->slots[priv->cur_slot]);
   return fret;
 }
 
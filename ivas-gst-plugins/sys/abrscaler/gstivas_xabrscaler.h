@@ -71,6 +71,8 @@ struct _GstIvasXAbrScaler
   IvasXAbrScalerCoefType coef_load_type;
   guint num_taps;
   gboolean avoid_output_copy;
+  guint queue_depth;
+  guint mem_bank;
 #ifdef ENABLE_PPE_SUPPORT
   gfloat alpha_r;
   gfloat alpha_g;
@@ -37,6 +37,7 @@
 #include <gst/gst.h>
 #include <gst/base/base.h>
 #include <gst/ivas/gstivasallocator.h>
+#include <gst/ivas/gstivasbufferpool.h>
 #include <gst/allocators/gstdmabuf.h>
 #include <dlfcn.h>              /* for dlXXX APIs */
 #include <sys/mman.h>           /* for munmap */
@@ -49,19 +50,31 @@
 #include <ivas/ivas_kernel.h>
 #include "gstivas_xfilter.h"
 #include <gst/ivas/gstivasutils.h>
+#include <gst/ivas/gstivasvideoformat.h>
 
 GST_DEBUG_CATEGORY_STATIC (gst_ivas_xfilter_debug);
 #define GST_CAT_DEFAULT gst_ivas_xfilter_debug
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_PERFORMANCE);
 
-pthread_mutex_t count_mutex;
 
 static const int ERT_CMD_SIZE = 4096;
 #define CMD_EXEC_TIMEOUT 1000   // 1 sec
 #define MIN_POOL_BUFFERS 2
 #define DEFAULT_IVAS_LIB_PATH "/usr/lib/"
 #define DEFAULT_DEVICE_INDEX 0
+#define DEFAULT_MEM_BANK 0
+#define DEFAULT_QUEUE_DEPTH IVAS_DEFAULT_QUEUE_DEPTH
 #define MAX_PRIV_POOLS 10
+#define MAX_BATCH_SIZE 32
+#define DEFAULT_BATCH_SIZE 1
+#define DEFAULT_BATCH_TIMEOUT 30        /* ms */
+#define MAX_CU_INSTANCES 16
+#define MAX_WORKERS 16          /* frame slots are shared with batching */
+#define DEFAULT_NUM_WORKERS 1
+#define MAX_DEVICES 32
+#define DEFAULT_CU_DISPATCH IVAS_XFILTER_DISPATCH_ROUND_ROBIN
+#define DEFAULT_DROP_POLICY IVAS_XFILTER_DROP_NEVER
+#define DEFAULT_DROP_INTERVAL 2
 #define ALIGN(size,align) (((size) + (align) - 1) & ~((align) - 1))
 
 #if defined(XLNX_PCIe_PLATFORM) && defined (USE_XRM)
@@ -87,9 +100,47 @@ typedef struct
   gchar *skname;
 } IvasSoftKernelInfo;
 
+typedef enum
+{
+  IVAS_XFILTER_DISPATCH_ROUND_ROBIN,
+  IVAS_XFILTER_DISPATCH_LEAST_LOADED,
+} Ivas_XFilterDispatch;
+
+typedef enum
+{
+  IVAS_XFILTER_DROP_NEVER,
+  IVAS_XFILTER_DROP_LATE,
+  IVAS_XFILTER_DROP_EVERY_NTH,
+} Ivas_XFilterDropPolicy;
+
+/* one of the identical CUs frames are spread over. Each has its own kernel
+ * library instance and ERT command ring */
+typedef struct
+{
+  gchar *name;
+  gint cu_idx;
+  IVASKernel *ivas_handle;
+  gboolean initialized;
+  guint in_flight;
+} Ivas_XFilterCu;
+
+/* software kernel library context running frames on its own thread */
+typedef struct
+{
+  GstIvas_XFilter *self;
+  IVASKernel *ivas_handle;
+  gboolean owns_handle;         /* worker 0 runs on the primary handle */
+  gboolean initialized;
+  GThread *thread;
+  json_t *dyn_config;           /* reference to config last given to kernel */
+  IVASFrame *input[MAX_NUM_OBJECT];
+  IVASFrame *output[MAX_NUM_OBJECT];
+} Ivas_XFilterWorker;
+
 typedef struct
 {
   gchar *name;
+  gchar **cu_names;             /* kernel-name entries, may be patterns */
   json_t *config;
   gchar *ivas_lib_path;
   void *lib_fd;
@@ -97,23 +148,58 @@ typedef struct
   IVASKernelInit kernel_init_func;
   IVASKernelStartFunc kernel_start_func;
   IVASKernelDoneFunc kernel_done_func;
+  IVASKernelStartAsyncFunc kernel_start_async_func;   /* optional */
+  IVASKernelWaitFunc kernel_wait_func;  /* optional */
+  IVASKernelDynConfigFunc kernel_dyn_config_func;       /* optional */
   IVASKernelDeInit kernel_deinit_func;
   IVASKernel *ivas_handle;
-  GstVideoFrame in_vframe;
-  GstVideoFrame out_vframe;
+  GstVideoFrame in_vframe[MAX_BATCH_SIZE];
+  GstVideoFrame out_vframe[MAX_BATCH_SIZE];
   IVASFrame *input[MAX_NUM_OBJECT];
   IVASFrame *output[MAX_NUM_OBJECT];
   gboolean is_softkernel;
+  /* cus[0] is the primary CU of name, cu_idx and ivas_handle above */
+  Ivas_XFilterCu cus[MAX_CU_INSTANCES];
+  guint n_cus;
+  guint next_cu;
+  Ivas_XFilterWorker *workers[MAX_WORKERS];
+  guint n_workers;
 #ifdef XLNX_PCIe_PLATFORM
   IvasSoftKernelInfo *skinfo;
 #endif
 } Ivas_XFilter;
 
+/* command submitted to kernel but not yet pushed downstream, also used for
+ * frames waiting in a batch. Commands run by workers have no cu, they use
+ * frame slot and report completion through done and ret */
+typedef struct
+{
+  Ivas_XFilterCu *cu;
+  guint slot;
+  json_t *dyn_config;
+  guint dyn_config_gen;
+  gboolean done;
+  gint ret;
+  IVASKernelToken token;
+  GstClockTime start;           /* submit time, for the QoS average */
+  GstBuffer *inbuf;
+  GstBuffer *new_inbuf;
+  GstBuffer *outbuf;
+} Ivas_XFilterPendingCmd;
+
 enum
 {
   PROP_0,
   PROP_CONFIG_LOCATION,
   PROP_DYNAMIC_CONFIG,
+  PROP_QUEUE_DEPTH,
+  PROP_BATCH_SIZE,
+  PROP_BATCH_TIMEOUT,
+  PROP_CU_DISPATCH,
+  PROP_NUM_WORKERS,
+  PROP_DROP_POLICY,
+  PROP_DROP_INTERVAL,
+  PROP_MEM_BANK,
 #if defined(XLNX_PCIe_PLATFORM)
 #if defined (MANUAL_SOFTKERNEL_DOWNLOAD)
   PROP_SK_CURRENT_INDEX,
@@ -132,9 +218,26 @@ typedef enum
   IVAS_ELEMENT_MODE_TRANSFORM,  /* input and output buffers are different */
 } Ivas_XFilterMode;
 
+/* caps advertised by a kernel library with a given config. Entries are
+ * shared by all instances and live as long as the process */
+typedef struct
+{
+  GstCaps *sink_caps;           /* NULL for default caps handling */
+  GstCaps *src_caps;
+} Ivas_XFilterCapsEntry;
+
+/* last transform_caps call of one direction */
+typedef struct
+{
+  GstCaps *caps;
+  GstCaps *filter;
+  GstCaps *result;
+} Ivas_XFilterCapsMemo;
+
 struct _GstIvas_XFilterPrivate
 {
   guint dev_idx;
+  guint mem_bank;
   xclDeviceHandle xcl_handle;
   gchar *xclbin_loc;
   json_t *root;
@@ -147,7 +250,49 @@ struct _GstIvas_XFilterPrivate
   xrt_buffer *ert_cmd_buf;
   GstBufferPool *input_pool;
   GstBufferPool *priv_pools[MAX_PRIV_POOLS];
+  GMutex priv_pool_lock;        /* priv_pools are created from workers */
+  /* dynamic-config is parsed on property set into dyn_json_pending and
+   * dyn_config_gen bumped. The streaming thread takes a reference in
+   * dyn_json_config and hands it to the kernels once the generation
+   * differs from dyn_config_applied, 0 being nothing applied yet */
   json_t *dyn_json_config;
+  json_t *dyn_json_pending;
+  gint dyn_config_gen;
+  gint dyn_config_applied;
+  guint queue_depth;
+  GQueue *pending_cmds;
+  Ivas_XFilterDispatch cu_dispatch;
+  guint max_in_flight;          /* queue depth summed over all CUs */
+  guint num_workers;
+  GAsyncQueue *work_queue;
+  GMutex work_lock;
+  GCond work_cond;
+  guint64 work_seq;
+  GstCaps *sink_caps;
+  GstCaps *src_caps;
+  Ivas_XFilterCapsMemo caps_memo[2];    /* guarded by the object lock */
+  /* QoS: earliest_time is taken from upstream QOS events under the object
+   * lock, frames with an earlier running time skip the kernel */
+  Ivas_XFilterDropPolicy drop_policy;
+  guint drop_interval;
+  GstClockTime earliest_time;
+  gdouble proportion;
+  GstClockTime avg_proc_time;
+  guint late_count;
+  guint64 processed;
+  guint64 dropped;
+  /* batching: frames collected in batch[] are handed to the kernel in one
+   * call once batch_size are in or batch_timeout passed since the first */
+  guint batch_size;
+  GstClockTime batch_timeout;
+  Ivas_XFilterPendingCmd *batch[MAX_BATCH_SIZE];
+  guint batch_len;
+  gint64 batch_deadline;
+  GstFlowReturn batch_flow;
+  GMutex batch_lock;
+  GCond batch_cond;
+  GThread *batch_thread;
+  gboolean batch_quit;
 #ifdef XLNX_PCIe_PLATFORM
 #ifdef MANUAL_SOFTKERNEL_DOWNLOAD
   gint sk_cur_idx;
@@ -190,6 +335,16 @@ static GstFlowReturn
 gst_ivas_xfilter_transform (GstBaseTransform * base, GstBuffer * inbuf,
     GstBuffer * outbuf);
 static void gst_ivas_xfilter_finalize (GObject * obj);
+static GstFlowReturn ivas_xfilter_drain_pending (GstIvas_XFilter * self,
+    guint max_pending, gboolean push);
+static void ivas_xfilter_unmap_frames (GstIvas_XFilter * self, guint idx);
+static GstFlowReturn ivas_xfilter_submit_batch (GstIvas_XFilter * self,
+    gboolean push, gboolean keep_last);
+static gpointer ivas_xfilter_batch_timer (gpointer data);
+static void ivas_xfilter_batch_stop (GstIvas_XFilter * self);
+static void ivas_xfilter_lookup_caps (GstIvas_XFilter * self);
+static void ivas_xfilter_update_proc_time (GstIvas_XFilter * self,
+    GstClockTime start);
 
 static Ivas_XFilterMode
 get_kernel_mode (const gchar * mode)
@@ -204,64 +359,68 @@ get_kernel_mode (const gchar * mode)
     return IVAS_ELEMENT_MODE_NOT_SUPPORTED;
 }
 
+#define IVAS_XFILTER_CU_DISPATCH_TYPE (ivas_xfilter_cu_dispatch_type ())
+
+static GType
+ivas_xfilter_cu_dispatch_type (void)
+{
+  static GType dispatch_type = 0;
+
+  if (!dispatch_type) {
+    static const GEnumValue dispatch_types[] = {
+      {IVAS_XFILTER_DISPATCH_ROUND_ROBIN, "Use the CUs in turn",
+          "round-robin"},
+      {IVAS_XFILTER_DISPATCH_LEAST_LOADED,
+          "Use the CU with the fewest frames in flight", "least-loaded"},
+      {0, NULL, NULL}
+    };
+    dispatch_type = g_enum_register_static ("GstIvasXFilterCuDispatch",
+        dispatch_types);
+  }
+  return dispatch_type;
+}
+
+#define IVAS_XFILTER_DROP_POLICY_TYPE (ivas_xfilter_drop_policy_type ())
+
+static GType
+ivas_xfilter_drop_policy_type (void)
+{
+  static GType policy_type = 0;
+
+  if (!policy_type) {
+    static const GEnumValue policy_types[] = {
+      {IVAS_XFILTER_DROP_NEVER, "Process every frame", "never"},
+      {IVAS_XFILTER_DROP_LATE, "Skip frames that would be late", "late"},
+      {IVAS_XFILTER_DROP_EVERY_NTH,
+          "While late, process one frame out of drop-interval", "every-nth"},
+      {0, NULL, NULL}
+    };
+    policy_type = g_enum_register_static ("GstIvasXFilterDropPolicy",
+        policy_types);
+  }
+  return policy_type;
+}
+
 static inline IVASVideoFormat
 get_kernellib_format (GstVideoFormat gst_fmt)
 {
-  switch (gst_fmt) {
-    case GST_VIDEO_FORMAT_GRAY8:
-      return IVAS_VFMT_Y8;
-    case GST_VIDEO_FORMAT_NV12:
-      return IVAS_VFMT_Y_UV8_420;
-    case GST_VIDEO_FORMAT_BGR:
-      return IVAS_VFMT_BGR8;
-    case GST_VIDEO_FORMAT_RGB:
-      return IVAS_VFMT_RGB8;
-    case GST_VIDEO_FORMAT_YUY2:
-      return IVAS_VFMT_YUYV8;
-    case GST_VIDEO_FORMAT_r210:
-      return IVAS_VFMT_RGBX10;
-    case GST_VIDEO_FORMAT_v308:
-      return IVAS_VFMT_YUV8;
-    case GST_VIDEO_FORMAT_GRAY10_LE32:
-      return IVAS_VFMT_Y10;
-    case GST_VIDEO_FORMAT_ABGR:
-      return IVAS_VFMT_ABGR8;
-    case GST_VIDEO_FORMAT_ARGB:
-      return IVAS_VFMT_ARGB8;
-    default:
-      GST_ERROR ("Not supporting %s yet", gst_video_format_to_string (gst_fmt));
-      return IVAS_VMFT_UNKNOWN;
-  }
+  IVASVideoFormat kernel_fmt = gst_ivas_video_format_to_kernel (gst_fmt);
+
+  if (kernel_fmt == IVAS_VMFT_UNKNOWN)
+    GST_ERROR ("Not supporting %s yet", gst_video_format_to_string (gst_fmt));
+
+  return kernel_fmt;
 }
 
 static inline GstVideoFormat
 get_gst_format (IVASVideoFormat kernel_fmt)
 {
-  switch (kernel_fmt) {
-    case IVAS_VFMT_Y8:
-      return GST_VIDEO_FORMAT_GRAY8;
-    case IVAS_VFMT_Y_UV8_420:
-      return GST_VIDEO_FORMAT_NV12;
-    case IVAS_VFMT_BGR8:
-      return GST_VIDEO_FORMAT_BGR;
-    case IVAS_VFMT_RGB8:
-      return GST_VIDEO_FORMAT_RGB;
-    case IVAS_VFMT_YUYV8:
-      return GST_VIDEO_FORMAT_YUY2;
-    case IVAS_VFMT_RGBX10:
-      return GST_VIDEO_FORMAT_r210;
-    case IVAS_VFMT_YUV8:
-      return GST_VIDEO_FORMAT_v308;
-    case IVAS_VFMT_Y10:
-      return GST_VIDEO_FORMAT_GRAY10_LE32;
-    case IVAS_VFMT_ABGR8:
-      return GST_VIDEO_FORMAT_ABGR;
-    case IVAS_VFMT_ARGB8:
-      return GST_VIDEO_FORMAT_ARGB;
-    default:
-      GST_ERROR ("Not supporting kernel format %d yet", kernel_fmt);
-      return GST_VIDEO_FORMAT_UNKNOWN;
-  }
+  GstVideoFormat gst_fmt = gst_ivas_video_format_from_kernel (kernel_fmt);
+
+  if (gst_fmt == GST_VIDEO_FORMAT_UNKNOWN)
+    GST_ERROR ("Not supporting kernel format %d yet", kernel_fmt);
+
+  return gst_fmt;
 }
 
 void
@@ -321,6 +480,8 @@ ivas_buffer_alloc (IVASKernel * handle, IVASFrame * ivas_frame, void *data)
   while (size_requested * MAX_PRIV_POOLS > oidx * max_size) {
     oidx++;
   }
+  /* with worker threads, several frames can ask for the pool at once */
+  g_mutex_lock (&self->priv->priv_pool_lock);
   priv_pool = self->priv->priv_pools[oidx - 1];
 
   GST_DEBUG_OBJECT (self,
@@ -347,8 +508,10 @@ ivas_buffer_alloc (IVASKernel * handle, IVASFrame * ivas_frame, void *data)
         (oidx * GST_VIDEO_INFO_HEIGHT (self->priv->in_vinfo)) / MAX_PRIV_POOLS,
         NULL);
 
-    if (!gst_video_info_from_caps (&tmp_info, caps))
+    if (!gst_video_info_from_caps (&tmp_info, caps)) {
+      g_mutex_unlock (&self->priv->priv_pool_lock);
       return -1;
+    }
 
     pool_buf_size = GST_VIDEO_INFO_SIZE (&tmp_info);
 
@@ -356,7 +519,8 @@ ivas_buffer_alloc (IVASKernel * handle, IVASFrame * ivas_frame, void *data)
     pool_buf_size = ALIGN (pool_buf_size, 4096);
     GST_INFO_OBJECT (self, "allocated internal private pool %p with size %lu",
         priv_pool, pool_buf_size);
-    allocator = gst_ivas_allocator_new (self->priv->dev_idx, USE_DMABUF);
+    allocator = gst_ivas_allocator_new_with_bank (self->priv->dev_idx,
+        USE_DMABUF, self->priv->mem_bank);
 
     config = gst_buffer_pool_get_config (priv_pool);
     gst_buffer_pool_config_set_params (config, caps, pool_buf_size, 2, 0);
@@ -367,6 +531,8 @@ ivas_buffer_alloc (IVASKernel * handle, IVASFrame * ivas_frame, void *data)
 
     if (!gst_buffer_pool_set_config (priv_pool, config)) {
       GST_ERROR_OBJECT (self, "failed to configure  pool");
+      gst_object_unref (priv_pool);
+      g_mutex_unlock (&self->priv->priv_pool_lock);
       return -1;
     }
 
@@ -377,10 +543,13 @@ ivas_buffer_alloc (IVASKernel * handle, IVASFrame * ivas_frame, void *data)
     bret = gst_buffer_pool_set_active (priv_pool, TRUE);
     if (!bret) {
       GST_ERROR_OBJECT (self, "failed to active private pool");
+      gst_object_unref (priv_pool);
+      g_mutex_unlock (&self->priv->priv_pool_lock);
       return -1;
     }
     self->priv->priv_pools[oidx - 1] = priv_pool;
   }
+  g_mutex_unlock (&self->priv->priv_pool_lock);
 
   fret = gst_buffer_pool_acquire_buffer (priv_pool, &outbuf, NULL);
   if (fret != GST_FLOW_OK) {
@@ -497,6 +666,33 @@ find_kernel_lib_symbols (GstIvas_XFilter * self, Ivas_XFilter * kernel)
         "could not find ivas_xfilter_deinit function. reason : %s", dlerror ());
     return FALSE;
   }
+
+  /* asynchronous entry points are optional */
+  kernel->kernel_start_async_func =
+      (IVASKernelStartAsyncFunc) dlsym (kernel->lib_fd,
+      "xlnx_kernel_start_async");
+  kernel->kernel_wait_func = (IVASKernelWaitFunc) dlsym (kernel->lib_fd,
+      "xlnx_kernel_wait");
+  if (!kernel->kernel_start_async_func || !kernel->kernel_wait_func) {
+    /* neither in-tree library exports them, so say so when it matters */
+    if (self->priv->queue_depth > 1
+        || self->priv->cu_dispatch != DEFAULT_CU_DISPATCH)
+      GST_WARNING_OBJECT (self, "kernel library %s lacks "
+          "xlnx_kernel_start_async/xlnx_kernel_wait, queue-depth and "
+          "cu-dispatch have no effect", kernel->ivas_lib_path);
+    else
+      GST_INFO_OBJECT (self, "kernel library does not support async "
+          "submission");
+    kernel->kernel_start_async_func = NULL;
+    kernel->kernel_wait_func = NULL;
+  }
+
+  /* so is the dynamic config notification */
+  kernel->kernel_dyn_config_func =
+      (IVASKernelDynConfigFunc) dlsym (kernel->lib_fd,
+      "xlnx_kernel_dyn_config");
+  dlerror ();
+
   return TRUE;
 }
 
@@ -521,7 +717,8 @@ ivas_xfilter_allocate_sink_internal_pool (GstIvas_XFilter * self)
   pool = gst_video_buffer_pool_new ();
   GST_LOG_OBJECT (self, "allocated internal sink pool %p", pool);
 
-  allocator = gst_ivas_allocator_new (self->priv->dev_idx, USE_DMABUF);
+  allocator = gst_ivas_allocator_new_with_bank (self->priv->dev_idx,
+      USE_DMABUF, self->priv->mem_bank);
   gst_allocation_params_init (&alloc_params);
   alloc_params.flags = GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
 
@@ -552,6 +749,25 @@ error:
   return FALSE;
 }
 
+/* plane layout the kernel library asked for on a pad, 1 when it did not */
+static void
+ivas_xfilter_kernel_align (GstIvas_XFilter * self, paddir dir,
+    guint * stride_align, guint * elevation_align)
+{
+  Ivas_XFilter *kernel = self->priv->kernel;
+
+  *stride_align = 1;
+  *elevation_align = 1;
+
+  if (!kernel || !kernel->ivas_handle)
+    return;
+
+  *stride_align = MAX (ivas_caps_get_stride_align (kernel->ivas_handle, dir),
+      1);
+  *elevation_align =
+      MAX (ivas_caps_get_height_align (kernel->ivas_handle, dir), 1);
+}
+
 static gboolean
 gst_ivas_xfilter_propose_allocation (GstBaseTransform * trans,
     GstQuery * decide_query, GstQuery * query)
@@ -561,6 +777,9 @@ gst_ivas_xfilter_propose_allocation (GstBaseTransform * trans,
   GstVideoInfo info;
   GstBufferPool *pool;
   guint size;
+  /* upstream buffers wait in a partially filled batch or in flight */
+  guint min_buffers = MIN_POOL_BUFFERS + self->priv->batch_size - 1 +
+      self->priv->max_in_flight - 1;
 
   GST_BASE_TRANSFORM_CLASS (parent_class)->propose_allocation (trans,
       decide_query, query);
@@ -581,30 +800,63 @@ gst_ivas_xfilter_propose_allocation (GstBaseTransform * trans,
     GstAllocationParams params = { GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS, 0, 0,
       0
     };
+    guint stride_align = 1, elevation_align = 1;
+    guint kernel_stride, kernel_elevation;
 
     if (gst_query_get_n_allocation_params (query) > 0) {
       gst_query_parse_nth_allocation_param (query, 0, &allocator, &params);
     } else {
-      allocator = gst_ivas_allocator_new (self->priv->dev_idx, USE_DMABUF);
+      allocator = gst_ivas_allocator_new_with_bank (self->priv->dev_idx,
+          USE_DMABUF, self->priv->mem_bank);
       gst_query_add_allocation_param (query, allocator, &params);
     }
 
-    pool = gst_video_buffer_pool_new ();
+    /* forward the layout downstream IVAS elements need, so upstream IVAS
+     * elements can allocate buffers all of the chain agrees on */
+    if (decide_query)
+      gst_ivas_buffer_pool_query_get_align (decide_query, &stride_align,
+          &elevation_align);
+    ivas_xfilter_kernel_align (self, SINK, &kernel_stride, &kernel_elevation);
+    stride_align = gst_ivas_buffer_pool_lcm_align (stride_align, kernel_stride);
+    elevation_align =
+        gst_ivas_buffer_pool_lcm_align (elevation_align, kernel_elevation);
+
+    if (allocator && GST_IS_IVAS_ALLOCATOR (allocator))
+      pool = gst_ivas_buffer_pool_new (stride_align, elevation_align);
+    else
+      pool = gst_video_buffer_pool_new ();
 
     GST_LOG_OBJECT (self, "allocated internal pool %p", pool);
 
     structure = gst_buffer_pool_get_config (pool);
-    gst_buffer_pool_config_set_params (structure, caps, size, MIN_POOL_BUFFERS,
-        0);
+    gst_buffer_pool_config_set_params (structure, caps, size, min_buffers, 0);
     gst_buffer_pool_config_add_option (structure,
         GST_BUFFER_POOL_OPTION_VIDEO_META);
     gst_buffer_pool_config_set_allocator (structure, allocator, &params);
 
-    if (!gst_buffer_pool_set_config (pool, structure))
-      goto config_failed;
+    if (!gst_buffer_pool_set_config (pool, structure)) {
+      if (!GST_IS_IVAS_BUFFER_POOL (pool))
+        goto config_failed;
+
+      /* format without an IVAS plane layout, fall back to a video pool */
+      GST_DEBUG_OBJECT (self, "IVAS pool rejected caps, using video pool");
+      gst_object_unref (pool);
+      pool = gst_video_buffer_pool_new ();
+      structure = gst_buffer_pool_get_config (pool);
+      gst_buffer_pool_config_set_params (structure, caps, size, min_buffers,
+          0);
+      gst_buffer_pool_config_add_option (structure,
+          GST_BUFFER_POOL_OPTION_VIDEO_META);
+      gst_buffer_pool_config_set_allocator (structure, allocator, &params);
+      if (!gst_buffer_pool_set_config (pool, structure))
+        goto config_failed;
+    } else if (GST_IS_IVAS_BUFFER_POOL (pool)) {
+      gst_ivas_buffer_pool_query_add_align (query, stride_align,
+          elevation_align);
+    }
 
     GST_OBJECT_LOCK (self);
-    gst_query_add_allocation_pool (query, pool, size, MIN_POOL_BUFFERS, 0);
+    gst_query_add_allocation_pool (query, pool, size, min_buffers, 0);
     GST_OBJECT_UNLOCK (self);
 
     if (self->priv->input_pool)
@@ -642,6 +894,9 @@ gst_ivas_xfilter_decide_allocation (GstBaseTransform * trans, GstQuery * query)
   gboolean update_allocator;
   gboolean update_pool;
   GstStructure *config = NULL;
+  GstBufferPool *proposed = NULL;
+  guint stride_align, elevation_align;
+  gboolean bret;
 
   gst_query_parse_allocation (query, &outcaps, NULL);
 
@@ -676,6 +931,29 @@ gst_ivas_xfilter_decide_allocation (GstBaseTransform * trans, GstQuery * query)
     update_pool = FALSE;
   }
 
+  /* output buffers held by in-flight kernel commands are not available to
+   * the pool, so account for them on top of downstream's requirement */
+  if (self->priv->max_in_flight > 1) {
+    min += self->priv->max_in_flight - 1;
+    if (max && max < min)
+      max = min;
+  }
+
+  /* same for the output buffers of a batch still being collected */
+  if (self->priv->batch_size > 1) {
+    min += self->priv->batch_size - 1;
+    if (max && max < min)
+      max = min;
+  }
+
+  /* an IVAS pool from downstream is shared only when its layout also suits
+   * the kernel, gst_ivas_buffer_pool_negotiate() decides below */
+  if (pool && GST_IS_IVAS_BUFFER_POOL (pool)) {
+    proposed = pool;
+    pool = NULL;
+  }
+  ivas_xfilter_kernel_align (self, SRC, &stride_align, &elevation_align);
+
 #ifdef XLNX_EMBEDDED_PLATFORM
   /* TODO: Currently Kms buffer are not supported in PCIe platform */
   if (pool) {
@@ -716,7 +994,8 @@ gst_ivas_xfilter_decide_allocation (GstBaseTransform * trans, GstQuery * query)
 
   if (!allocator) {
     /* making sdx allocator for the HW mode without dmabuf */
-    allocator = gst_ivas_allocator_new (self->priv->dev_idx, USE_DMABUF);
+    allocator = gst_ivas_allocator_new_with_bank (self->priv->dev_idx,
+        USE_DMABUF, self->priv->mem_bank);
     //params.flags = GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
     // TODO: Need to add XRT related flags here
   }
@@ -729,12 +1008,61 @@ next:
   else
     gst_query_add_allocation_param (query, allocator, &params);
 
-  if (allocator)
-    gst_object_unref (allocator);
-
   if (pool == NULL) {
     GST_DEBUG_OBJECT (self, "no pool, making new pool");
+    /* lay buffers out the way both the kernel and IVAS elements downstream
+     * need, sharing downstream's pool when it already does */
+    if (allocator && GST_IS_IVAS_ALLOCATOR (allocator))
+      pool = gst_ivas_buffer_pool_negotiate (query, proposed, stride_align,
+          elevation_align);
+    else
+      pool = gst_video_buffer_pool_new ();
+  }
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, outcaps, size, min, max);
+  gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+  if (GST_IS_IVAS_BUFFER_POOL (pool))
+    gst_buffer_pool_config_set_allocator (config, allocator, &params);
+
+  bret = gst_buffer_pool_set_config (pool, config);
+  if (!bret && proposed && pool == proposed) {
+    /* downstream's pool is already in use with another configuration */
+    GST_DEBUG_OBJECT (self, "shared pool rejected config, making own pool");
+    gst_object_unref (pool);
+    pool = gst_ivas_buffer_pool_negotiate (query, NULL, stride_align,
+        elevation_align);
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, outcaps, size, min, max);
+    gst_buffer_pool_config_add_option (config,
+        GST_BUFFER_POOL_OPTION_VIDEO_META);
+    gst_buffer_pool_config_set_allocator (config, allocator, &params);
+    bret = gst_buffer_pool_set_config (pool, config);
+  }
+
+  if (proposed) {
+    gst_object_unref (proposed);
+    proposed = NULL;
+  }
+
+  if (!bret) {
+    if (update_pool || !GST_IS_IVAS_BUFFER_POOL (pool)) {
+      GST_ERROR_OBJECT (self, "failed to set config on own pool %p", pool);
+      goto error;
+    }
+
+    /* format without an IVAS plane layout, fall back to a video pool */
+    GST_DEBUG_OBJECT (self, "IVAS pool rejected caps, using video pool");
+    gst_object_unref (pool);
     pool = gst_video_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, outcaps, size, min, max);
+    gst_buffer_pool_config_add_option (config,
+        GST_BUFFER_POOL_OPTION_VIDEO_META);
+    if (!gst_buffer_pool_set_config (pool, config)) {
+      GST_ERROR_OBJECT (self, "failed to set config on own pool %p", pool);
+      goto error;
+    }
   }
 
   if (update_pool)
@@ -742,13 +1070,9 @@ next:
   else
     gst_query_add_allocation_pool (query, pool, size, min, max);
 
-  config = gst_buffer_pool_get_config (pool);
-  gst_buffer_pool_config_set_params (config, outcaps, size, min, max);
-  gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
-
-  if (!gst_buffer_pool_set_config (pool, config)) {
-   GST_ERROR_OBJECT (self, "failed to set config on own pool %p", pool);
-   goto error;
+  if (allocator) {
+    gst_object_unref (allocator);
+    allocator = NULL;
   }
 
   gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
@@ -764,6 +1088,8 @@ error:
     gst_object_unref (allocator);
   if (pool)
     gst_object_unref (pool);
+  if (proposed)
+    gst_object_unref (proposed);
 
   return FALSE;
 }
@@ -902,123 +1228,116 @@ static gboolean
 ivas_xfilter_download_xclbin (GstIvas_XFilter * self)
 {
   char *bit = self->priv->xclbin_loc;
-  FILE *fptr = NULL;
-  int size = 0;
-  char *header = NULL;
-  const xclBin *blob = NULL;
-  const struct axlf *top = NULL;
 
   if (!bit || !strlen (bit)) {
     GST_ERROR_OBJECT (self, "invalid xclbin location");
-    goto error;
+    return FALSE;
   }
 
-  fptr = fopen (bit, "rb");
-  if (!fptr) {
-    GST_ERROR_OBJECT (self, "fopen() with %s failed due to %s", bit,
-        strerror (errno));
-    goto error;
+  /* xclbin file is mapped and parsed once per process */
+  if (load_xclbin (self->priv->xcl_handle, self->priv->dev_idx, bit,
+          &self->priv->xclbinId)) {
+    GST_ERROR_OBJECT (self, "failed to download xclbin %s", bit);
+    return FALSE;
   }
 
-  if (fseek (fptr, 0, SEEK_END) != 0) {
-    GST_ERROR_OBJECT (self, "fseek() failed to SEEK_END with %s",
-        strerror (errno));
-    goto error;
-  }
+  GST_INFO_OBJECT (self, "Finished downloading bitstream %s", bit);
+  return TRUE;
+}
+#endif
 
-  size = ftell (fptr);
-  if (size == (size_t) (-1)) {
-    GST_ERROR_OBJECT (self, "ftell failed with %s", strerror (errno));
-    goto error;
-  }
+/* kernel init is serialized among instances on the same device only */
+static GMutex *
+ivas_xfilter_device_lock (GstIvas_XFilter * self)
+{
+  static GMutex device_locks[MAX_DEVICES];
 
-  if (fseek (fptr, 0, SEEK_SET) != 0) {
-    GST_ERROR_OBJECT (self, "fseek() failed to SEEK_SET with %s",
-        strerror (errno));
-    goto error;
-  }
+  return &device_locks[self->priv->dev_idx % MAX_DEVICES];
+}
 
-  header = (char *) calloc (1, size);
-  if (header == NULL) {
-    GST_ERROR_OBJECT (self, "failed to allocate memory");
-    goto error;
-  }
+/* resolves kernel-name entries to CUs, entries with wildcards are matched
+ * against the kernels in the xclbin */
+static gboolean
+ivas_xfilter_find_cus (GstIvas_XFilter * self)
+{
+  GstIvas_XFilterPrivate *priv = self->priv;
+  Ivas_XFilter *kernel = priv->kernel;
+  char *names[MAX_CU_INSTANCES];
+  guint i, max;
+  gint n, j;
+
+  kernel->n_cus = 0;
+  for (i = 0; kernel->cu_names[i]; i++) {
+    const gchar *entry = kernel->cu_names[i];
+
+    max = MAX_CU_INSTANCES - kernel->n_cus;
+    if (!max) {
+      GST_WARNING_OBJECT (self, "more than %d CUs, ignoring %s",
+          MAX_CU_INSTANCES, entry);
+      continue;
+    }
 
-  if (fread (header, sizeof (char), size, fptr) != size) {
-    GST_ERROR_OBJECT (self, "fread failed with %s", strerror (errno));
-    goto error;
-  }
+    if (strpbrk (entry, "*?[")) {
+      n = find_xclbin_kernels (priv->xclbinId, entry, names, max);
+      if (n <= 0) {
+        GST_ERROR_OBJECT (self, "no kernel in xclbin matches %s", entry);
+        return FALSE;
+      }
+    } else {
+      names[0] = strdup (entry);
+      n = 1;
+    }
 
-  if (strncmp (header, "xclbin2", 8)) {
-    GST_ERROR_OBJECT (self, "Invalid bitstream xclbin2 tag not present");
-    goto error;
+    for (j = 0; j < n; j++)
+      kernel->cus[kernel->n_cus++].name = names[j];
   }
 
-  blob = (const xclBin *) header;
-  if (xclLoadXclBin (self->priv->xcl_handle, blob)) {
-    GST_ERROR_OBJECT (self, "Bitstream download failed");
-    goto error;
-  }
+  for (i = 0; i < kernel->n_cus; i++) {
+    Ivas_XFilterCu *cu = &kernel->cus[i];
 
-  GST_INFO_OBJECT (self, "Finished downloading bitstream %s", bit);
+    cu->cu_idx = xclIPName2Index (priv->xcl_handle, cu->name);
+    if (cu->cu_idx < 0) {
+      GST_ERROR_OBJECT (self, "failed to get cu index for IP name %s",
+          cu->name);
+      return FALSE;
+    }
 
-  top = (const struct axlf *) header;
-  uuid_copy (self->priv->xclbinId, top->m_header.uuid);
+    GST_INFO_OBJECT (self, "cu_idx for kernel %s is %d", cu->name,
+        cu->cu_idx);
+  }
 
-  free (header);
-  fclose (fptr);
   return TRUE;
-
-error:
-  if (header)
-    free (header);
-  if (fptr)
-    fclose (fptr);
-  return FALSE;
 }
-#endif
 
+/* sets up an additional CU the same way as the primary one */
 static gboolean
-ivas_xfilter_init (GstIvas_XFilter * self)
+ivas_xfilter_init_cu (GstIvas_XFilter * self, Ivas_XFilterCu * cu)
 {
   GstIvas_XFilterPrivate *priv = self->priv;
+  IVASKernel *primary = priv->kernel->ivas_handle;
+  IVASKernel *ivas_handle = NULL;
   int iret;
-  struct ert_start_kernel_cmd *ert_cmd = NULL;
-  IVASKernel *ivas_handle = priv->kernel->ivas_handle;
-  int i;
 
-#ifndef USE_XRM /* XRM will download xclbin */
-  if (priv->kernel->name || priv->kernel->is_softkernel) {
-    /* xclbin need to be downloaded only when hardkernel or softkernel is used */
-    if (!ivas_xfilter_download_xclbin (self))
-      return FALSE;
+  if (xclOpenContext (priv->xcl_handle, priv->xclbinId, cu->cu_idx, true)) {
+    GST_ERROR_OBJECT (self, "failed to do xclOpenContext for %s", cu->name);
+    return FALSE;
   }
-#endif
-
-  if (priv->kernel->name) {
-    //iret = xclIPName2Index (priv->xcl_handle, priv->kernel->name, &priv->kernel->cu_idx);
-    priv->kernel->cu_idx =
-        xclIPName2Index (priv->xcl_handle, priv->kernel->name);
-    //xclCuName2Index (priv->xcl_handle, priv->kernel->name, &priv->kernel->cu_idx);
-    if (priv->kernel->cu_idx < 0) {
-      GST_ERROR_OBJECT (self, "failed to get cu index for IP name %s",
-          priv->kernel->name);
-      return FALSE;
-    }
 
-    GST_INFO_OBJECT (self, "cu_idx for kernel %s is %d", priv->kernel->name,
-        priv->kernel->cu_idx);
+  /* from here on deinit releases everything, context included */
+  ivas_handle = (IVASKernel *) calloc (1, sizeof (IVASKernel));
+  if (!ivas_handle) {
+    GST_ERROR_OBJECT (self, "failed to allocate memory");
+    xclCloseContext (priv->xcl_handle, priv->xclbinId, cu->cu_idx);
+    return FALSE;
   }
+  cu->ivas_handle = ivas_handle;
 
-  if (priv->kernel->cu_idx >= 0) {
-    if (xclOpenContext (priv->xcl_handle, priv->xclbinId, priv->kernel->cu_idx,
-        true)) {
-      GST_ERROR_OBJECT (self, "failed to do xclOpenContext...");
-      return FALSE;
-    }
+  ivas_handle->ert_cmd_buf = (xrt_buffer *) calloc (1, sizeof (xrt_buffer));
+  if (ivas_handle->ert_cmd_buf == NULL) {
+    GST_ERROR_OBJECT (self, "failed to allocate ert cmd memory");
+    return FALSE;
   }
 
-  /* allocate ert command buffer */
   iret =
       alloc_xrt_buffer (priv->xcl_handle, ERT_CMD_SIZE, XCL_BO_SHARED_VIRTUAL,
       XCL_BO_FLAGS_EXECBUF, ivas_handle->ert_cmd_buf);
@@ -1026,106 +1345,501 @@ ivas_xfilter_init (GstIvas_XFilter * self)
     GST_ERROR_OBJECT (self, "failed to allocate ert command buffer..");
     return FALSE;
   }
-
-  ert_cmd =
-      (struct ert_start_kernel_cmd *) (ivas_handle->ert_cmd_buf->user_ptr);
-  memset (ert_cmd, 0x0, ERT_CMD_SIZE);
+  memset (ivas_handle->ert_cmd_buf->user_ptr, 0x0, ERT_CMD_SIZE);
 
   ivas_handle->xcl_handle = priv->xcl_handle;
-#if defined(XLNX_PCIe_PLATFORM)
-  ivas_handle->is_softkernel = priv->kernel->is_softkernel;
-  if (priv->kernel->is_softkernel) {
-    ivas_handle->cu_idx = priv->sk_cur_idx;
-  } else {
-    ivas_handle->cu_idx = priv->kernel->cu_idx;
-  }
-#else
-  ivas_handle->cu_idx = priv->kernel->cu_idx;
-#endif
-  ivas_handle->kernel_config = priv->kernel->config;
+  ivas_handle->cu_idx = cu->cu_idx;
+  ivas_handle->kernel_config = primary->kernel_config;
+  ivas_handle->queue_depth = primary->queue_depth;
 
-  GST_INFO_OBJECT (self, "ivas library cu_idx = %d", ivas_handle->cu_idx);
+  if (ivas_kernel_alloc_cmd_ring (ivas_handle, ivas_handle->queue_depth) < 0) {
+    GST_ERROR_OBJECT (self, "failed to allocate ert command ring..");
+    return FALSE;
+  }
 
-  /* no need to do alloc in ivas library, so no callbacks required */
   ivas_handle->alloc_func = ivas_buffer_alloc;
   ivas_handle->free_func = ivas_buffer_free;
   ivas_handle->cb_user_data = self;
 
-  pthread_mutex_lock (&count_mutex);    /* lock for TDM */
+  g_mutex_lock (ivas_xfilter_device_lock (self));     /* lock for TDM */
   iret = priv->kernel->kernel_init_func (ivas_handle);
+  g_mutex_unlock (ivas_xfilter_device_lock (self));
   if (iret < 0) {
-    GST_ERROR_OBJECT (self, "failed to do kernel init..");
+    GST_ERROR_OBJECT (self, "failed to do kernel init for %s", cu->name);
     return FALSE;
   }
-  pthread_mutex_unlock (&count_mutex);
-  GST_INFO_OBJECT (self, "completed kernel init");
+  cu->initialized = TRUE;
 
-  memset (priv->kernel->input, 0x0, sizeof (IVASFrame *) * MAX_NUM_OBJECT);
-  memset (priv->kernel->output, 0x0, sizeof (IVASFrame *) * MAX_NUM_OBJECT);
+  GST_INFO_OBJECT (self, "completed kernel init for %s, cu_idx %d", cu->name,
+      cu->cu_idx);
+  return TRUE;
+}
 
-  priv->kernel->input[0] = (IVASFrame *) calloc (1, sizeof (IVASFrame));
-  if (NULL == priv->kernel->input[0]) {
-    GST_ERROR_OBJECT (self, "failed to allocate memory");
-    return FALSE;
+static void
+ivas_xfilter_log_stats (GstIvas_XFilter * self, IVASKernel * ivas_handle)
+{
+  IVASKernelStats stats;
+
+  if (!ivas_kernel_get_stats (ivas_handle, &stats) && stats.submitted) {
+    GST_INFO_OBJECT (self, "cu %u : submitted %" G_GUINT64_FORMAT
+        ", completed %" G_GUINT64_FORMAT ", errors %" G_GUINT64_FORMAT
+        ", retries %" G_GUINT64_FORMAT ", timeouts %" G_GUINT64_FORMAT
+        ", latency usec p50 %" G_GUINT64_FORMAT ", p99 %" G_GUINT64_FORMAT
+        ", max %" G_GUINT64_FORMAT, stats.cu_idx, stats.submitted,
+        stats.completed, stats.errors, stats.retries, stats.timeouts,
+        stats.latency_p50_us, stats.latency_p99_us, stats.latency_max_us);
   }
+}
 
-  if (priv->element_mode == IVAS_ELEMENT_MODE_TRANSFORM) {
-    priv->kernel->output[0] = (IVASFrame *) calloc (1, sizeof (IVASFrame));
-    if (NULL == priv->kernel->output[0]) {
-      GST_ERROR_OBJECT (self, "failed to allocate memory");
-      return FALSE;
+/* releases an additional CU, the primary one is released by deinit */
+static void
+ivas_xfilter_deinit_cu (GstIvas_XFilter * self, Ivas_XFilterCu * cu)
+{
+  GstIvas_XFilterPrivate *priv = self->priv;
+  IVASKernel *ivas_handle = cu->ivas_handle;
+
+  if (ivas_handle) {
+    if (cu->initialized && priv->kernel->kernel_deinit_func
+        && priv->kernel->kernel_deinit_func (ivas_handle) < 0)
+      GST_ERROR_OBJECT (self, "failed to do kernel deinit for %s", cu->name);
+
+    ivas_xfilter_log_stats (self, ivas_handle);
+    ivas_kernel_release_stats (ivas_handle);
+    ivas_kernel_free_cmd_ring (ivas_handle);
+    if (ivas_handle->ert_cmd_buf) {
+      free_xrt_buffer (priv->xcl_handle, ivas_handle->ert_cmd_buf);
+      free (ivas_handle->ert_cmd_buf);
     }
+    free (ivas_handle);
+
+    GST_INFO_OBJECT (self, "closing context for cu_idx %d", cu->cu_idx);
+    xclCloseContext (priv->xcl_handle, priv->xclbinId, cu->cu_idx);
   }
 
-  for (i = 0; i < MAX_PRIV_POOLS; i++)
-    priv->priv_pools[i] = NULL;
+  free (cu->name);
+  memset (cu, 0x0, sizeof (Ivas_XFilterCu));
+}
 
-  return TRUE;
+static void
+ivas_xfilter_set_handle_config (GstIvas_XFilter * self,
+    IVASKernel * ivas_handle, json_t * config, guint gen)
+{
+  Ivas_XFilter *kernel = self->priv->kernel;
+
+  ivas_handle->kernel_dyn_config = config;
+  ivas_handle->dyn_config_gen = gen;
+
+  if (kernel->kernel_dyn_config_func
+      && kernel->kernel_dyn_config_func (ivas_handle, config) < 0)
+    GST_WARNING_OBJECT (self, "kernel rejected dynamic config generation %u",
+        gen);
 }
 
-static gboolean
-ivas_xfilter_deinit (GstIvas_XFilter * self)
+/* picks up a dynamic-config set since the last frame, called on the
+ * streaming thread before frames are handed to the kernel */
+static void
+ivas_xfilter_apply_dyn_config (GstIvas_XFilter * self)
 {
   GstIvas_XFilterPrivate *priv = self->priv;
-  int iret, i;
-  gint cu_idx = -1;
+  Ivas_XFilter *kernel = priv->kernel;
+  json_t *config;
+  gint gen;
+  guint i;
 
-  if (priv->kernel) {
-    if (priv->kernel->input[0])
-      free (priv->kernel->input[0]);
+  if (g_atomic_int_get (&priv->dyn_config_gen) == priv->dyn_config_applied)
+    return;
 
-    if (priv->kernel->output[0])
-      free (priv->kernel->output[0]);
+  GST_OBJECT_LOCK (self);
+  gen = priv->dyn_config_gen;
+  config = priv->dyn_json_pending ? json_incref (priv->dyn_json_pending) : NULL;
+  GST_OBJECT_UNLOCK (self);
 
-    cu_idx = priv->kernel->cu_idx;
+  if (priv->dyn_json_config)
+    json_decref (priv->dyn_json_config);
+  priv->dyn_json_config = config;
+  priv->dyn_config_applied = gen;
 
-    if (priv->kernel->kernel_deinit_func) {
-      iret = priv->kernel->kernel_deinit_func (priv->kernel->ivas_handle);
-      if (iret < 0) {
-        GST_ERROR_OBJECT (self, "failed to do kernel deinit..");
-      }
-      GST_DEBUG_OBJECT (self, "successfully completed deinit");
-    }
+  GST_DEBUG_OBJECT (self, "applying dynamic config generation %d", gen);
 
-    if (priv->kernel->ivas_handle) {
-      if (priv->kernel->ivas_handle->ert_cmd_buf) {
-        free_xrt_buffer (priv->xcl_handle,
-            priv->kernel->ivas_handle->ert_cmd_buf);
-        free (priv->kernel->ivas_handle->ert_cmd_buf);
-      }
-      free (priv->kernel->ivas_handle);
-    }
-#ifdef XLNX_PCIe_PLATFORM
-    if (priv->kernel->skinfo) {
-      if (priv->kernel->skinfo->skname) {
-        g_free (priv->kernel->skinfo->skname);
-        priv->kernel->skinfo->skname = NULL;
-      }
-      free (priv->kernel->skinfo);
-    }
-#endif
+  /* workers pick it up from their next command */
+  if (kernel->n_workers > 1)
+    return;
 
-    if (priv->kernel->config)
+  for (i = 0; i < kernel->n_cus; i++)
+    ivas_xfilter_set_handle_config (self, kernel->cus[i].ivas_handle, config,
+        gen);
+}
+
+/* popped by a worker to make it exit */
+static Ivas_XFilterPendingCmd worker_quit;
+
+static gpointer
+ivas_xfilter_worker_func (gpointer data)
+{
+  Ivas_XFilterWorker *worker = (Ivas_XFilterWorker *) data;
+  GstIvas_XFilter *self = worker->self;
+  GstIvas_XFilterPrivate *priv = self->priv;
+  Ivas_XFilter *kernel = priv->kernel;
+  gboolean transform = priv->element_mode == IVAS_ELEMENT_MODE_TRANSFORM;
+  Ivas_XFilterPendingCmd *cmd;
+  gint ret;
+
+  while ((cmd = (Ivas_XFilterPendingCmd *)
+          g_async_queue_pop (priv->work_queue)) != &worker_quit) {
+    worker->input[0] = kernel->input[cmd->slot];
+    worker->output[0] = kernel->output[cmd->slot];
+
+    /* each worker owns its handle, so it updates the config itself */
+    if (worker->ivas_handle->dyn_config_gen != cmd->dyn_config_gen) {
+      if (worker->dyn_config)
+        json_decref (worker->dyn_config);
+      worker->dyn_config = json_incref (cmd->dyn_config);
+      ivas_xfilter_set_handle_config (self, worker->ivas_handle,
+          worker->dyn_config, cmd->dyn_config_gen);
+    }
+
+    ret = kernel->kernel_start_func (worker->ivas_handle, 0, worker->input,
+        transform ? worker->output : NULL);
+    if (ret >= 0)
+      ret = kernel->kernel_done_func (worker->ivas_handle);
+
+    g_mutex_lock (&priv->work_lock);
+    cmd->ret = ret;
+    cmd->done = TRUE;
+    g_cond_broadcast (&priv->work_cond);
+    g_mutex_unlock (&priv->work_lock);
+  }
+
+  return NULL;
+}
+
+/* worker 0 reuses the primary kernel context, others get their own */
+static gboolean
+ivas_xfilter_start_workers (GstIvas_XFilter * self)
+{
+  GstIvas_XFilterPrivate *priv = self->priv;
+  Ivas_XFilter *kernel = priv->kernel;
+  IVASKernel *primary = kernel->ivas_handle;
+  guint i;
+  int iret;
+
+  for (i = 0; i < kernel->n_workers; i++) {
+    Ivas_XFilterWorker *worker = g_new0 (Ivas_XFilterWorker, 1);
+    gchar *name;
+
+    kernel->workers[i] = worker;
+    worker->self = self;
+
+    if (i == 0) {
+      worker->ivas_handle = primary;
+    } else {
+      worker->ivas_handle = (IVASKernel *) calloc (1, sizeof (IVASKernel));
+      if (!worker->ivas_handle) {
+        GST_ERROR_OBJECT (self, "failed to allocate memory");
+        return FALSE;
+      }
+      worker->owns_handle = TRUE;
+      worker->ivas_handle->xcl_handle = primary->xcl_handle;
+      worker->ivas_handle->cu_idx = primary->cu_idx;
+      worker->ivas_handle->kernel_config = primary->kernel_config;
+      worker->ivas_handle->queue_depth = 1;
+      worker->ivas_handle->alloc_func = ivas_buffer_alloc;
+      worker->ivas_handle->free_func = ivas_buffer_free;
+      worker->ivas_handle->cb_user_data = self;
+
+      g_mutex_lock (ivas_xfilter_device_lock (self));
+      iret = kernel->kernel_init_func (worker->ivas_handle);
+      g_mutex_unlock (ivas_xfilter_device_lock (self));
+      if (iret < 0) {
+        GST_ERROR_OBJECT (self, "failed to do kernel init for worker %u", i);
+        return FALSE;
+      }
+      worker->initialized = TRUE;
+    }
+
+    name = g_strdup_printf ("ivasworker%u", i);
+    worker->thread = g_thread_new (name, ivas_xfilter_worker_func, worker);
+    g_free (name);
+  }
+
+  GST_INFO_OBJECT (self, "started %u workers", kernel->n_workers);
+  return TRUE;
+}
+
+static void
+ivas_xfilter_stop_workers (GstIvas_XFilter * self)
+{
+  GstIvas_XFilterPrivate *priv = self->priv;
+  Ivas_XFilter *kernel = priv->kernel;
+  guint i;
+
+  for (i = 0; i < MAX_WORKERS; i++) {
+    if (kernel->workers[i] && kernel->workers[i]->thread)
+      g_async_queue_push (priv->work_queue, &worker_quit);
+  }
+
+  for (i = 0; i < MAX_WORKERS; i++) {
+    Ivas_XFilterWorker *worker = kernel->workers[i];
+
+    if (!worker)
+      continue;
+
+    if (worker->thread)
+      g_thread_join (worker->thread);
+
+    if (worker->dyn_config)
+      json_decref (worker->dyn_config);
+
+    if (worker->owns_handle) {
+      if (worker->initialized && kernel->kernel_deinit_func
+          && kernel->kernel_deinit_func (worker->ivas_handle) < 0)
+        GST_ERROR_OBJECT (self, "failed to do kernel deinit for worker %u", i);
+      free (worker->ivas_handle);
+    }
+
+    g_free (worker);
+    kernel->workers[i] = NULL;
+  }
+}
+
+static gboolean
+ivas_xfilter_init (GstIvas_XFilter * self)
+{
+  GstIvas_XFilterPrivate *priv = self->priv;
+  int iret;
+  struct ert_start_kernel_cmd *ert_cmd = NULL;
+  IVASKernel *ivas_handle = priv->kernel->ivas_handle;
+  int i;
+
+#ifndef USE_XRM /* XRM will download xclbin */
+  if (priv->kernel->name || priv->kernel->is_softkernel) {
+    /* xclbin need to be downloaded only when hardkernel or softkernel is used */
+    if (!ivas_xfilter_download_xclbin (self))
+      return FALSE;
+  }
+#endif
+
+  if (priv->kernel->name) {
+    if (!ivas_xfilter_find_cus (self))
+      return FALSE;
+    priv->kernel->cu_idx = priv->kernel->cus[0].cu_idx;
+  } else {
+    priv->kernel->cus[0].cu_idx = priv->kernel->cu_idx;
+    priv->kernel->n_cus = 1;
+  }
+  priv->kernel->cus[0].ivas_handle = ivas_handle;
+
+  if (priv->kernel->cu_idx >= 0) {
+    if (xclOpenContext (priv->xcl_handle, priv->xclbinId, priv->kernel->cu_idx,
+        true)) {
+      GST_ERROR_OBJECT (self, "failed to do xclOpenContext...");
+      return FALSE;
+    }
+  }
+
+  /* allocate ert command buffer */
+  iret =
+      alloc_xrt_buffer (priv->xcl_handle, ERT_CMD_SIZE, XCL_BO_SHARED_VIRTUAL,
+      XCL_BO_FLAGS_EXECBUF, ivas_handle->ert_cmd_buf);
+  if (iret < 0) {
+    GST_ERROR_OBJECT (self, "failed to allocate ert command buffer..");
+    return FALSE;
+  }
+
+  ert_cmd =
+      (struct ert_start_kernel_cmd *) (ivas_handle->ert_cmd_buf->user_ptr);
+  memset (ert_cmd, 0x0, ERT_CMD_SIZE);
+
+  ivas_handle->xcl_handle = priv->xcl_handle;
+#if defined(XLNX_PCIe_PLATFORM)
+  ivas_handle->is_softkernel = priv->kernel->is_softkernel;
+  if (priv->kernel->is_softkernel) {
+    ivas_handle->cu_idx = priv->sk_cur_idx;
+  } else {
+    ivas_handle->cu_idx = priv->kernel->cu_idx;
+  }
+#else
+  ivas_handle->cu_idx = priv->kernel->cu_idx;
+#endif
+  ivas_handle->kernel_config = priv->kernel->config;
+
+  /* only hardware kernels in transform mode can keep frames in flight */
+  ivas_handle->queue_depth = 1;
+  if (priv->queue_depth > 1 && priv->batch_size > 1) {
+    GST_WARNING_OBJECT (self, "queue-depth %u is not used with batch-size %u",
+        priv->queue_depth, priv->batch_size);
+  } else if (priv->queue_depth > 1) {
+    if (priv->kernel->kernel_start_async_func
+        && priv->element_mode == IVAS_ELEMENT_MODE_TRANSFORM
+        && (priv->kernel->name || priv->kernel->is_softkernel)) {
+      ivas_handle->queue_depth = priv->queue_depth;
+    } else if (!priv->kernel->kernel_start_async_func) {
+      GST_WARNING_OBJECT (self, "queue-depth %u needs xlnx_kernel_start_async "
+          "and xlnx_kernel_wait in the kernel library, using 1",
+          priv->queue_depth);
+    } else {
+      GST_WARNING_OBJECT (self, "queue-depth %u needs a hardware kernel in "
+          "transform mode, using 1", priv->queue_depth);
+    }
+  }
+
+  /* frames are spread over CUs through the asynchronous entry points */
+  if (priv->kernel->n_cus > 1 && !(priv->kernel->kernel_start_async_func
+          && priv->element_mode == IVAS_ELEMENT_MODE_TRANSFORM
+          && !priv->kernel->is_softkernel && priv->batch_size == 1)) {
+    GST_WARNING_OBJECT (self, "%u CUs found but %s, using %s only",
+        priv->kernel->n_cus, priv->kernel->kernel_start_async_func ?
+        "element mode supports one" : "kernel library lacks "
+        "xlnx_kernel_start_async/xlnx_kernel_wait", priv->kernel->cus[0].name);
+    for (i = 1; i < (int) priv->kernel->n_cus; i++) {
+      free (priv->kernel->cus[i].name);
+      priv->kernel->cus[i].name = NULL;
+    }
+    priv->kernel->n_cus = 1;
+  }
+  priv->max_in_flight = ivas_handle->queue_depth * priv->kernel->n_cus;
+
+  /* software libraries run frames on a pool of kernel contexts instead */
+  priv->kernel->n_workers = 1;
+  if (priv->num_workers > 1) {
+    if (!priv->kernel->name && !priv->kernel->is_softkernel
+        && priv->batch_size == 1) {
+      priv->kernel->n_workers = priv->num_workers;
+      priv->max_in_flight = priv->num_workers;
+    } else {
+      GST_WARNING_OBJECT (self, "num-workers %u needs a software kernel "
+          "library and no batching, using 1", priv->num_workers);
+    }
+  }
+
+  GST_INFO_OBJECT (self, "ivas library cu_idx = %d, queue depth = %u, "
+      "%u CUs, %u workers", ivas_handle->cu_idx, ivas_handle->queue_depth,
+      priv->kernel->n_cus, priv->kernel->n_workers);
+
+  /* one ERT command per frame in flight */
+  if (ivas_kernel_alloc_cmd_ring (ivas_handle, ivas_handle->queue_depth) < 0) {
+    GST_ERROR_OBJECT (self, "failed to allocate ert command ring..");
+    return FALSE;
+  }
+
+  /* no need to do alloc in ivas library, so no callbacks required */
+  ivas_handle->alloc_func = ivas_buffer_alloc;
+  ivas_handle->free_func = ivas_buffer_free;
+  ivas_handle->cb_user_data = self;
+
+  g_mutex_lock (ivas_xfilter_device_lock (self));     /* lock for TDM */
+  iret = priv->kernel->kernel_init_func (ivas_handle);
+  g_mutex_unlock (ivas_xfilter_device_lock (self));
+  if (iret < 0) {
+    GST_ERROR_OBJECT (self, "failed to do kernel init..");
+    return FALSE;
+  }
+  priv->kernel->cus[0].initialized = TRUE;
+  GST_INFO_OBJECT (self, "completed kernel init");
+
+  for (i = 1; i < (int) priv->kernel->n_cus; i++) {
+    if (!ivas_xfilter_init_cu (self, &priv->kernel->cus[i]))
+      return FALSE;
+  }
+
+  memset (priv->kernel->input, 0x0, sizeof (IVASFrame *) * MAX_NUM_OBJECT);
+  memset (priv->kernel->output, 0x0, sizeof (IVASFrame *) * MAX_NUM_OBJECT);
+
+  /* one frame per batch slot or worker, the arrays stay NULL terminated */
+  for (i = 0; i < (int) MAX (priv->batch_size, priv->kernel->n_workers); i++) {
+    priv->kernel->input[i] = (IVASFrame *) calloc (1, sizeof (IVASFrame));
+    if (NULL == priv->kernel->input[i]) {
+      GST_ERROR_OBJECT (self, "failed to allocate memory");
+      return FALSE;
+    }
+
+    if (priv->element_mode == IVAS_ELEMENT_MODE_TRANSFORM) {
+      priv->kernel->output[i] = (IVASFrame *) calloc (1, sizeof (IVASFrame));
+      if (NULL == priv->kernel->output[i]) {
+        GST_ERROR_OBJECT (self, "failed to allocate memory");
+        return FALSE;
+      }
+    }
+  }
+
+  for (i = 0; i < MAX_PRIV_POOLS; i++)
+    priv->priv_pools[i] = NULL;
+
+  if (priv->kernel->n_workers > 1 && !ivas_xfilter_start_workers (self))
+    return FALSE;
+
+  return TRUE;
+}
+
+/* transform_caps depends on the element mode of the loaded config */
+static void
+ivas_xfilter_clear_caps_memo (GstIvas_XFilter * self)
+{
+  Ivas_XFilterCapsMemo *memo = self->priv->caps_memo;
+  guint i;
+
+  GST_OBJECT_LOCK (self);
+  for (i = 0; i < G_N_ELEMENTS (self->priv->caps_memo); i++) {
+    gst_caps_replace (&memo[i].caps, NULL);
+    gst_caps_replace (&memo[i].filter, NULL);
+    gst_caps_replace (&memo[i].result, NULL);
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static gboolean
+ivas_xfilter_deinit (GstIvas_XFilter * self)
+{
+  GstIvas_XFilterPrivate *priv = self->priv;
+  int iret, i;
+  gint cu_idx = -1;
+
+  if (priv->kernel) {
+    ivas_xfilter_stop_workers (self);
+
+    for (i = 0; i < MAX_BATCH_SIZE; i++) {
+      if (priv->kernel->input[i])
+        free (priv->kernel->input[i]);
+
+      if (priv->kernel->output[i])
+        free (priv->kernel->output[i]);
+    }
+
+    cu_idx = priv->kernel->cu_idx;
+
+    for (i = 1; i < (int) priv->kernel->n_cus; i++)
+      ivas_xfilter_deinit_cu (self, &priv->kernel->cus[i]);
+
+    if (priv->kernel->kernel_deinit_func) {
+      iret = priv->kernel->kernel_deinit_func (priv->kernel->ivas_handle);
+      if (iret < 0) {
+        GST_ERROR_OBJECT (self, "failed to do kernel deinit..");
+      }
+      GST_DEBUG_OBJECT (self, "successfully completed deinit");
+    }
+
+    if (priv->kernel->ivas_handle) {
+      ivas_xfilter_log_stats (self, priv->kernel->ivas_handle);
+      ivas_kernel_release_stats (priv->kernel->ivas_handle);
+      ivas_kernel_free_cmd_ring (priv->kernel->ivas_handle);
+      if (priv->kernel->ivas_handle->ert_cmd_buf) {
+        free_xrt_buffer (priv->xcl_handle,
+            priv->kernel->ivas_handle->ert_cmd_buf);
+        free (priv->kernel->ivas_handle->ert_cmd_buf);
+      }
+      free (priv->kernel->ivas_handle);
+    }
+#ifdef XLNX_PCIe_PLATFORM
+    if (priv->kernel->skinfo) {
+      if (priv->kernel->skinfo->skname) {
+        g_free (priv->kernel->skinfo->skname);
+        priv->kernel->skinfo->skname = NULL;
+      }
+      free (priv->kernel->skinfo);
+    }
+#endif
+
+    if (priv->kernel->config)
       json_decref (priv->kernel->config);
 
     if (priv->kernel->ivas_lib_path)
@@ -1134,9 +1848,18 @@ ivas_xfilter_deinit (GstIvas_XFilter * self)
     if (priv->kernel->name)
       free (priv->kernel->name);
 
+    free (priv->kernel->cus[0].name);
+    g_strfreev (priv->kernel->cu_names);
+
     free (priv->kernel);
     priv->kernel = NULL;
   }
+  priv->max_in_flight = 1;
+  /* kernel handles of the next start need the config again */
+  priv->dyn_config_applied = 0;
+
+  gst_caps_replace (&priv->sink_caps, NULL);
+  gst_caps_replace (&priv->src_caps, NULL);
 
   for (i = 0; i < MAX_PRIV_POOLS; i++) {
     if (priv->priv_pools[i]) {
@@ -1154,6 +1877,8 @@ ivas_xfilter_deinit (GstIvas_XFilter * self)
       GST_INFO_OBJECT (self, "closing context for cu_idx %d", cu_idx);
       xclCloseContext (priv->xcl_handle, priv->xclbinId, cu_idx);
     }
+    gst_ivas_dmabuf_import_release (priv->xcl_handle);
+    ivas_buffer_cache_release (priv->xcl_handle);
     xclClose (priv->xcl_handle);
   }
 #if defined(XLNX_PCIe_PLATFORM) && defined (USE_XRM)
@@ -1170,6 +1895,16 @@ ivas_xfilter_deinit (GstIvas_XFilter * self)
   return TRUE;
 }
 
+static void
+ivas_xfilter_reset_qos (GstIvas_XFilter * self)
+{
+  GST_OBJECT_LOCK (self);
+  self->priv->earliest_time = GST_CLOCK_TIME_NONE;
+  self->priv->proportion = 1.0;
+  GST_OBJECT_UNLOCK (self);
+  self->priv->late_count = 0;
+}
+
 static gboolean
 gst_ivas_xfilter_start (GstBaseTransform * trans)
 {
@@ -1238,6 +1973,7 @@ gst_ivas_xfilter_start (GstBaseTransform * trans)
       priv->element_mode == IVAS_ELEMENT_MODE_PASSTHROUGH);
   gst_base_transform_set_in_place (trans,
       priv->element_mode == IVAS_ELEMENT_MODE_IN_PLACE);
+  ivas_xfilter_clear_caps_memo (self);
 
   /* get kernels array */
   karray = json_object_get (root, "kernels");
@@ -1283,17 +2019,39 @@ gst_ivas_xfilter_start (GstBaseTransform * trans)
       g_strconcat (lib_path, json_string_value (value), NULL);
   GST_DEBUG_OBJECT (self, "ivas library path %s", priv->kernel->ivas_lib_path);
 
-  /* get kernel name */
+  /* get kernel name. A pattern like "scaler:*" or an array of names
+   * selects several identical CUs to spread frames over */
   value = json_object_get (kernel, "kernel-name");
-  if (value) {
+  if (json_is_array (value)) {
+    json_t *entry;
+    size_t idx;
+
+    if (!json_array_size (value)) {
+      GST_ERROR_OBJECT (self, "kernel name array is empty");
+      goto error;
+    }
+
+    priv->kernel->cu_names = g_new0 (gchar *, json_array_size (value) + 1);
+    json_array_foreach (value, idx, entry) {
+      if (!json_is_string (entry)) {
+        GST_ERROR_OBJECT (self, "kernel name is not of string type");
+        goto error;
+      }
+      priv->kernel->cu_names[idx] = g_strdup (json_string_value (entry));
+    }
+  } else if (value) {
     if (!json_is_string (value)) {
       GST_ERROR_OBJECT (self, "primary kernel name is not of string type");
       goto error;
     }
-    priv->kernel->name = g_strdup (json_string_value (value));
-  } else {
-    priv->kernel->name = NULL;
+    priv->kernel->cu_names = g_new0 (gchar *, 2);
+    priv->kernel->cu_names[0] = g_strdup (json_string_value (value));
   }
+
+  if (priv->kernel->cu_names)
+    priv->kernel->name = g_strdup (priv->kernel->cu_names[0]);
+  else
+    priv->kernel->name = NULL;
   GST_INFO_OBJECT (self, "Primary kernel name %s", priv->kernel->name);
 
 #ifdef XLNX_PCIe_PLATFORM
@@ -1359,9 +2117,21 @@ gst_ivas_xfilter_start (GstBaseTransform * trans)
     if (!ivas_xfilter_init (self))
       goto error;
 
+    ivas_xfilter_lookup_caps (self);
     priv->do_init = FALSE;
   }
 
+  priv->work_seq = 0;
+  ivas_xfilter_reset_qos (self);
+  priv->processed = priv->dropped = 0;
+  priv->avg_proc_time = 0;
+  priv->batch_flow = GST_FLOW_OK;
+  priv->batch_quit = FALSE;
+  priv->batch_len = 0;
+  if (priv->batch_size > 1 && priv->batch_timeout)
+    priv->batch_thread = g_thread_new ("ivasbatchtimer",
+        ivas_xfilter_batch_timer, self);
+
   if (lib_path)
     g_free (lib_path);
   if (root)
@@ -1382,6 +2152,8 @@ gst_ivas_xfilter_stop (GstBaseTransform * trans)
   GstIvas_XFilter *self = GST_IVAS_XFILTER (trans);
 
   GST_DEBUG_OBJECT (self, "stopping");
+  ivas_xfilter_batch_stop (self);
+  ivas_xfilter_drain_pending (self, 0, FALSE);
   ivas_xfilter_deinit (self);
   return TRUE;
 }
@@ -1434,94 +2206,172 @@ ivas_kernelcap_to_gst_cap (kernelcaps * kcap)
   return cap;
 }
 
-static gboolean
-gst_ivas_xfilter_query (GstBaseTransform * trans,
-    GstPadDirection direction, GstQuery * query)
+/* caps of the kernel's first pad in direction, followed by the template
+ * caps unless the kernel pads are rigid */
+static GstCaps *
+ivas_xfilter_kernel_caps (GstIvas_XFilter * self, GstPadDirection direction)
 {
-  GstIvas_XFilter *self = GST_IVAS_XFILTER (trans);
-  Ivas_XFilter *kernel = self->priv->kernel;
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (self);
+  IVASKernel *ivas_handle = self->priv->kernel->ivas_handle;
   Ivas_XFilterMode element_mode = self->priv->element_mode;
-  IVASKernel *ivas_handle = NULL;
   kernelpads **kernel_pads, *kernel_pad;
   uint8_t nu_pads;              /* number of sink/src pads suported by kenrel */
   uint8_t pad_index;            /* incomming pad index */
   uint8_t nu_caps;              /* number of caps supported by one pad */
   kernelcaps **kcaps;
-  gboolean ret = TRUE;
+  GstCaps *newcap, *allcaps;
   uint8_t i;
 
-  switch (GST_QUERY_TYPE (query)) {
-    case GST_QUERY_CAPS:{
-      GstCaps *newcap, *allcaps;
+  if (element_mode == IVAS_ELEMENT_MODE_PASSTHROUGH
+      || element_mode == IVAS_ELEMENT_MODE_IN_PLACE) {
+    /* Same buffer for sink and src,
+     * so the same caps for sink and src pads
+     * and for all pads
+     */
+    kernel_pads = ivas_handle->padinfo->sinkpads;
+    nu_pads = (direction == GST_PAD_SRC) ?
+        ivas_handle->padinfo->nu_srcpad : ivas_handle->padinfo->nu_sinkpad;
+  } else {
+    kernel_pads = (direction == GST_PAD_SRC) ?
+        ivas_handle->padinfo->srcpads : ivas_handle->padinfo->sinkpads;
+    nu_pads = (direction == GST_PAD_SRC) ?
+        ivas_handle->padinfo->nu_srcpad : ivas_handle->padinfo->nu_sinkpad;
+  }
+  GST_INFO_OBJECT (self, "element_mode %d nu_pads %d %s", element_mode,
+      nu_pads, direction == GST_PAD_SRC ? "SRC" : "SINK");
 
-      if (self->priv->do_init == TRUE)
-        return FALSE;
+  pad_index = 0;                /* TODO: how to get incoming pad number */
+  kernel_pad = (kernel_pads[pad_index]);
+  nu_caps = kernel_pad->nu_caps;
+  kcaps = kernel_pad->kcaps;    /* Base of pad's caps */
+  GST_DEBUG_OBJECT (self, "nu_caps = %d", nu_caps);
 
-      ivas_handle = kernel->ivas_handle;
+  allcaps = gst_caps_new_empty ();
+  /* 0th element has high priority */
+  for (i = 0; i < nu_caps; i++) {
+    kernelcaps *kcap = (kcaps[i]);
 
-      if (!ivas_handle->padinfo ||
-          ivas_handle->padinfo->nature == IVAS_PAD_DEFAULT) {
-        /* Do default handling */
-        GST_DEBUG_OBJECT (self,
-            "padinfo == NULL || nature == IVAS_PAD_DEFAULT, Do default handling");
-        break;
-      }
+    newcap = ivas_kernelcap_to_gst_cap (kcap);
+    gst_caps_append (allcaps, newcap);
+  }
 
-      if (element_mode == IVAS_ELEMENT_MODE_PASSTHROUGH
-          || element_mode == IVAS_ELEMENT_MODE_IN_PLACE) {
-        /* Same buffer for sink and src,
-         * so the same caps for sink and src pads
-         * and for all pads
-         */
-        kernel_pads = ivas_handle->padinfo->sinkpads;
-        nu_pads = (direction == GST_PAD_SRC) ?
-            ivas_handle->padinfo->nu_srcpad : ivas_handle->padinfo->nu_sinkpad;
-      } else {
-        kernel_pads = (direction == GST_PAD_SRC) ?
-            ivas_handle->padinfo->srcpads : ivas_handle->padinfo->sinkpads;
-        nu_pads = (direction == GST_PAD_SRC) ?
-            ivas_handle->padinfo->nu_srcpad : ivas_handle->padinfo->nu_sinkpad;
-      }
-      GST_INFO_OBJECT (self, "element_mode %d nu_pads %d %s", element_mode,
-          nu_pads, direction == GST_PAD_SRC ? "SRC" : "SINK");
+  if ((ivas_handle->padinfo->nature != IVAS_PAD_RIGID)) {
+    GstCaps *padcaps;
+    GST_DEBUG_OBJECT (self, "nature != IVAS_PAD_RIGID");
 
-      pad_index = 0;            /* TODO: how to get incoming pad number */
-      kernel_pad = (kernel_pads[pad_index]);
-      nu_caps = kernel_pad->nu_caps;
-      kcaps = kernel_pad->kcaps;        /* Base of pad's caps */
-      GST_DEBUG_OBJECT (self, "nu_caps = %d", nu_caps);
+    if (direction == GST_PAD_SRC) {
+      padcaps = gst_pad_get_pad_template_caps (trans->srcpad);
+    } else {
+      padcaps = gst_pad_get_pad_template_caps (trans->sinkpad);
+    }
 
+    gst_caps_append (allcaps, padcaps);
+  }
 
-      allcaps = gst_caps_new_empty ();
-      /* 0th element has high priority */
-      for (i = 0; i < nu_caps; i++) {
-        kernelcaps *kcap = (kcaps[i]);
+  GST_INFO_OBJECT (self, "caps from kernel = %" GST_PTR_FORMAT, allcaps);
 
-        newcap = ivas_kernelcap_to_gst_cap (kcap);
-        gst_caps_append (allcaps, newcap);
-      }
+  return allcaps;
+}
 
-      if ((ivas_handle->padinfo->nature != IVAS_PAD_RIGID)) {
-        GstCaps *padcaps;
-        GST_DEBUG_OBJECT (self, "nature != IVAS_PAD_RIGID");
+/* takes the kernel caps from the cache, converting them on first use of a
+ * library and config. Kernels fill padinfo from their config at init */
+static void
+ivas_xfilter_lookup_caps (GstIvas_XFilter * self)
+{
+  static GHashTable *caps_cache;
+  static GMutex caps_cache_lock;
+  GstIvas_XFilterPrivate *priv = self->priv;
+  IVASKernel *ivas_handle = priv->kernel->ivas_handle;
+  Ivas_XFilterCapsEntry *entry;
+  gchar *config, *key;
+
+  config = json_dumps (priv->kernel->config, JSON_SORT_KEYS | JSON_COMPACT);
+  key = g_strdup_printf ("%s:%d:%s", priv->kernel->ivas_lib_path,
+      priv->element_mode, config ? config : "");
+  free (config);
+
+  g_mutex_lock (&caps_cache_lock);
+  if (!caps_cache)
+    caps_cache = g_hash_table_new (g_str_hash, g_str_equal);
+
+  entry = g_hash_table_lookup (caps_cache, key);
+  if (!entry) {
+    entry = g_new0 (Ivas_XFilterCapsEntry, 1);
+    if (ivas_handle->padinfo &&
+        ivas_handle->padinfo->nature != IVAS_PAD_DEFAULT) {
+      entry->sink_caps = ivas_xfilter_kernel_caps (self, GST_PAD_SINK);
+      entry->src_caps = ivas_xfilter_kernel_caps (self, GST_PAD_SRC);
+      GST_MINI_OBJECT_FLAG_SET (entry->sink_caps,
+          GST_MINI_OBJECT_FLAG_MAY_BE_LEAKED);
+      GST_MINI_OBJECT_FLAG_SET (entry->src_caps,
+          GST_MINI_OBJECT_FLAG_MAY_BE_LEAKED);
+    }
+    g_hash_table_insert (caps_cache, key, entry);
+    key = NULL;
+  } else {
+    GST_DEBUG_OBJECT (self, "kernel caps of %s found in cache",
+        priv->kernel->ivas_lib_path);
+  }
+  g_mutex_unlock (&caps_cache_lock);
+  g_free (key);
 
-        if (direction == GST_PAD_SRC) {
-          padcaps = gst_pad_get_pad_template_caps (trans->srcpad);
-        } else {
-          padcaps = gst_pad_get_pad_template_caps (trans->sinkpad);
-        }
+  gst_caps_replace (&priv->sink_caps, entry->sink_caps);
+  gst_caps_replace (&priv->src_caps, entry->src_caps);
+}
 
-        gst_caps_append (allcaps, padcaps);
-      }
+static gboolean
+gst_ivas_xfilter_query (GstBaseTransform * trans,
+    GstPadDirection direction, GstQuery * query)
+{
+  GstIvas_XFilter *self = GST_IVAS_XFILTER (trans);
+  gboolean ret = TRUE;
 
-      {
-        gchar *str = gst_caps_to_string (allcaps);
-        GST_INFO_OBJECT (self, "caps from kernel = %s", str);
-        g_free (str);
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:{
+      GstCaps *caps, *filter, *result;
+
+      if (self->priv->do_init == TRUE)
+        return FALSE;
+
+      caps = (direction == GST_PAD_SRC) ?
+          self->priv->src_caps : self->priv->sink_caps;
+      if (!caps) {
+        /* Do default handling */
+        GST_DEBUG_OBJECT (self,
+            "padinfo == NULL || nature == IVAS_PAD_DEFAULT, Do default handling");
+        break;
       }
 
-      gst_query_set_caps_result (query, allcaps);
-      gst_caps_unref (allcaps);
+      gst_query_parse_caps (query, &filter);
+      if (filter && !gst_caps_is_any (filter))
+        result = gst_caps_intersect_full (filter, caps,
+            GST_CAPS_INTERSECT_FIRST);
+      else
+        result = gst_caps_ref (caps);
+
+      GST_LOG_OBJECT (self, "%s caps %" GST_PTR_FORMAT,
+          direction == GST_PAD_SRC ? "src" : "sink", result);
+
+      gst_query_set_caps_result (query, result);
+      gst_caps_unref (result);
+
+      return TRUE;
+    }
+    case GST_QUERY_LATENCY:{
+      GstClockTime min, max;
+      gboolean live;
+
+      ret = GST_BASE_TRANSFORM_CLASS (parent_class)->query (trans, direction,
+          query);
+      if (!ret || self->priv->batch_size <= 1 || !self->priv->batch_timeout)
+        return ret;
+
+      /* a partial batch may hold a frame back for up to batch-timeout */
+      gst_query_parse_latency (query, &live, &min, &max);
+      min += self->priv->batch_timeout;
+      if (GST_CLOCK_TIME_IS_VALID (max))
+        max += self->priv->batch_timeout;
+      gst_query_set_latency (query, live, min, max);
 
       return TRUE;
     }
@@ -1569,11 +2419,24 @@ gst_ivas_xfilter_transform_caps (GstBaseTransform * trans,
     GstPadDirection direction, GstCaps * caps, GstCaps * filter)
 {
   GstIvas_XFilter *self = GST_IVAS_XFILTER (trans);
+  Ivas_XFilterCapsMemo *memo =
+      &self->priv->caps_memo[direction == GST_PAD_SRC];
   GstCaps *othercaps, *tmp;
-  GstCaps *result;
+  GstCaps *result = NULL;
   guint ncaps, idx;
   GstCapsFeatures *feature;
 
+  /* renegotiation mostly asks again what it asked last time */
+  GST_OBJECT_LOCK (self);
+  if (memo->result && gst_caps_is_strictly_equal (memo->caps, caps) &&
+      (memo->filter == filter || (memo->filter && filter &&
+              gst_caps_is_strictly_equal (memo->filter, filter))))
+    result = gst_caps_ref (memo->result);
+  GST_OBJECT_UNLOCK (self);
+
+  if (result)
+    return result;
+
   othercaps = gst_caps_new_empty ();
 
   ncaps = gst_caps_get_size (caps);
@@ -1611,9 +2474,63 @@ gst_ivas_xfilter_transform_caps (GstBaseTransform * trans,
   GST_DEBUG_OBJECT (trans, "transformed caps from %" GST_PTR_FORMAT " into %"
       GST_PTR_FORMAT, caps, result);
 
+  GST_OBJECT_LOCK (self);
+  gst_caps_replace (&memo->caps, caps);
+  gst_caps_replace (&memo->filter, filter);
+  gst_caps_replace (&memo->result, result);
+  GST_OBJECT_UNLOCK (self);
+
   return result;
 }
 
+static gboolean
+gst_ivas_xfilter_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstIvas_XFilter *self = GST_IVAS_XFILTER (trans);
+
+  /* keep serialized events behind the frames still running on the kernel */
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+    ivas_xfilter_submit_batch (self, FALSE, FALSE);
+    self->priv->batch_flow = GST_FLOW_OK;
+    ivas_xfilter_drain_pending (self, 0, FALSE);
+    ivas_xfilter_reset_qos (self);
+  } else if (GST_EVENT_IS_SERIALIZED (event)) {
+    ivas_xfilter_submit_batch (self, TRUE, FALSE);
+    ivas_xfilter_drain_pending (self, 0, TRUE);
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (trans, event);
+}
+
+static gboolean
+gst_ivas_xfilter_src_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstIvas_XFilter *self = GST_IVAS_XFILTER (trans);
+  GstIvas_XFilterPrivate *priv = self->priv;
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_QOS) {
+    GstQOSType type;
+    GstClockTimeDiff diff;
+    GstClockTime timestamp;
+    gdouble proportion;
+
+    gst_event_parse_qos (event, &type, &proportion, &diff, &timestamp);
+
+    GST_OBJECT_LOCK (self);
+    priv->proportion = proportion;
+    if (!GST_CLOCK_TIME_IS_VALID (timestamp))
+      priv->earliest_time = GST_CLOCK_TIME_NONE;
+    else if (diff > 0)
+      /* we are late, frames we start now also need our processing time */
+      priv->earliest_time = timestamp + 2 * diff + priv->avg_proc_time;
+    else
+      priv->earliest_time = timestamp + diff;
+    GST_OBJECT_UNLOCK (self);
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->src_event (trans, event);
+}
+
 static GstCaps *
 gst_ivas_xfilter_fixate_caps (GstBaseTransform * trans,
     GstPadDirection direction, GstCaps * caps, GstCaps * othercaps)
@@ -1646,6 +2563,8 @@ gst_ivas_xfilter_class_init (GstIvas_XFilterClass * klass)
   transform_class->propose_allocation = gst_ivas_xfilter_propose_allocation;
   transform_class->transform_ip = gst_ivas_xfilter_transform_ip;
   transform_class->transform = gst_ivas_xfilter_transform;
+  transform_class->sink_event = gst_ivas_xfilter_sink_event;
+  transform_class->src_event = gst_ivas_xfilter_src_event;
 
   g_object_class_install_property (gobject_class, PROP_CONFIG_LOCATION,
       g_param_spec_string ("kernels-config",
@@ -1660,6 +2579,69 @@ gst_ivas_xfilter_class_init (GstIvas_XFilterClass * klass)
           "String contains dynamic json configuration of kernel", NULL,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
+  g_object_class_install_property (gobject_class, PROP_QUEUE_DEPTH,
+      g_param_spec_uint ("queue-depth", "Kernel command queue depth",
+          "Maximum number of frames in flight on each kernel CU. Values "
+          "above 1 need a kernel library exporting xlnx_kernel_start_async "
+          "and xlnx_kernel_wait, and transform element mode",
+          1, IVAS_MAX_QUEUE_DEPTH, DEFAULT_QUEUE_DEPTH,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_CU_DISPATCH,
+      g_param_spec_enum ("cu-dispatch", "CU dispatch policy",
+          "How frames are spread when kernel-name selects several CUs. "
+          "Needs a kernel library exporting xlnx_kernel_start_async and "
+          "xlnx_kernel_wait, otherwise only the first CU is used",
+          IVAS_XFILTER_CU_DISPATCH_TYPE, DEFAULT_CU_DISPATCH,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_NUM_WORKERS,
+      g_param_spec_uint ("num-workers", "Number of worker threads",
+          "Number of kernel library instances processing frames in parallel "
+          "on their own threads. Only used with software kernel libraries",
+          1, MAX_WORKERS, DEFAULT_NUM_WORKERS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_DROP_POLICY,
+      g_param_spec_enum ("drop-policy", "QoS drop policy",
+          "Which frames skip the kernel when downstream reports they are "
+          "late. Skipped frames are pushed unprocessed in passthrough and "
+          "inplace modes and replaced by a gap in transform mode",
+          IVAS_XFILTER_DROP_POLICY_TYPE, DEFAULT_DROP_POLICY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_DROP_INTERVAL,
+      g_param_spec_uint ("drop-interval", "QoS drop interval",
+          "With drop-policy every-nth, process one late frame out of this "
+          "many", 2, G_MAXUINT, DEFAULT_DROP_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_BATCH_SIZE,
+      g_param_spec_uint ("batch-size", "Frames per kernel call",
+          "Number of frames handed to the kernel library in one "
+          "xlnx_kernel_start call, as input[0..N-1] and output[0..N-1]",
+          1, MAX_BATCH_SIZE, DEFAULT_BATCH_SIZE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_BATCH_TIMEOUT,
+      g_param_spec_uint ("batch-timeout", "Batch timeout",
+          "Time in milliseconds to wait for a batch to fill before submitting "
+          "a partial one (0 = wait for a full batch)",
+          0, G_MAXUINT, DEFAULT_BATCH_TIMEOUT,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_MEM_BANK,
+      g_param_spec_uint ("mem-bank", "Device memory bank",
+          "Device memory bank the element allocates its buffers from",
+          0, 31, DEFAULT_MEM_BANK,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
 #if defined(XLNX_PCIe_PLATFORM)
 #if defined (MANUAL_SOFTKERNEL_DOWNLOAD)
   g_object_class_install_property (gobject_class, PROP_SK_CURRENT_INDEX,
@@ -1714,12 +2696,31 @@ gst_ivas_xfilter_init (GstIvas_XFilter * self)
 
   self->priv = priv;
   priv->dev_idx = DEFAULT_DEVICE_INDEX;
+  priv->mem_bank = DEFAULT_MEM_BANK;
   priv->ert_cmd_buf = NULL;
   priv->in_vinfo = gst_video_info_new ();
   priv->out_vinfo = gst_video_info_new ();
   priv->element_mode = IVAS_ELEMENT_MODE_NOT_SUPPORTED;
   priv->do_init = TRUE;
   priv->dyn_json_config = NULL;
+  priv->queue_depth = DEFAULT_QUEUE_DEPTH;
+  priv->pending_cmds = g_queue_new ();
+  priv->cu_dispatch = DEFAULT_CU_DISPATCH;
+  priv->max_in_flight = 1;
+  priv->num_workers = DEFAULT_NUM_WORKERS;
+  priv->drop_policy = DEFAULT_DROP_POLICY;
+  priv->drop_interval = DEFAULT_DROP_INTERVAL;
+  priv->earliest_time = GST_CLOCK_TIME_NONE;
+  priv->proportion = 1.0;
+  priv->work_queue = g_async_queue_new ();
+  g_mutex_init (&priv->work_lock);
+  g_mutex_init (&priv->priv_pool_lock);
+  g_cond_init (&priv->work_cond);
+  priv->batch_size = DEFAULT_BATCH_SIZE;
+  priv->batch_timeout = DEFAULT_BATCH_TIMEOUT * GST_MSECOND;
+  priv->batch_flow = GST_FLOW_OK;
+  g_mutex_init (&priv->batch_lock);
+  g_cond_init (&priv->batch_cond);
 }
 
 static void
@@ -1742,12 +2743,53 @@ gst_ivas_xfilter_set_property (GObject * object, guint prop_id,
       }
       self->json_file = g_value_dup_string (value);
       break;
-    case PROP_DYNAMIC_CONFIG:
+    case PROP_DYNAMIC_CONFIG:{
+      json_t *config = NULL;
+      json_error_t error;
+
+      if (self->dyn_config)
+        g_free (self->dyn_config);
       self->dyn_config = g_value_dup_string (value);
-      if (self->priv->dyn_json_config) {
-        json_decref (self->priv->dyn_json_config);
+      if (self->dyn_config) {
+        config = json_loads (self->dyn_config, JSON_DECODE_ANY, &error);
+        if (!config) {
+          GST_WARNING_OBJECT (self, "failed to parse dynamic config, keeping "
+              "previous one. reason %s", error.text);
+          break;
+        }
       }
-      self->priv->dyn_json_config = json_loads (self->dyn_config, JSON_DECODE_ANY, NULL);
+
+      GST_OBJECT_LOCK (self);
+      if (self->priv->dyn_json_pending)
+        json_decref (self->priv->dyn_json_pending);
+      self->priv->dyn_json_pending = config;
+      g_atomic_int_inc (&self->priv->dyn_config_gen);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    }
+    case PROP_QUEUE_DEPTH:
+      self->priv->queue_depth = g_value_get_uint (value);
+      break;
+    case PROP_CU_DISPATCH:
+      self->priv->cu_dispatch = g_value_get_enum (value);
+      break;
+    case PROP_NUM_WORKERS:
+      self->priv->num_workers = g_value_get_uint (value);
+      break;
+    case PROP_DROP_POLICY:
+      self->priv->drop_policy = g_value_get_enum (value);
+      break;
+    case PROP_DROP_INTERVAL:
+      self->priv->drop_interval = g_value_get_uint (value);
+      break;
+    case PROP_BATCH_SIZE:
+      self->priv->batch_size = g_value_get_uint (value);
+      break;
+    case PROP_BATCH_TIMEOUT:
+      self->priv->batch_timeout = g_value_get_uint (value) * GST_MSECOND;
+      break;
+    case PROP_MEM_BANK:
+      self->priv->mem_bank = g_value_get_uint (value);
       break;
 #if defined(XLNX_PCIe_PLATFORM) && defined (MANUAL_SOFTKERNEL_DOWNLOAD)
     case PROP_SK_CURRENT_INDEX:
@@ -1781,6 +2823,30 @@ gst_ivas_xfilter_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_DYNAMIC_CONFIG:
       g_value_set_string (value, self->dyn_config);
       break;
+    case PROP_QUEUE_DEPTH:
+      g_value_set_uint (value, self->priv->queue_depth);
+      break;
+    case PROP_CU_DISPATCH:
+      g_value_set_enum (value, self->priv->cu_dispatch);
+      break;
+    case PROP_NUM_WORKERS:
+      g_value_set_uint (value, self->priv->num_workers);
+      break;
+    case PROP_DROP_POLICY:
+      g_value_set_enum (value, self->priv->drop_policy);
+      break;
+    case PROP_DROP_INTERVAL:
+      g_value_set_uint (value, self->priv->drop_interval);
+      break;
+    case PROP_BATCH_SIZE:
+      g_value_set_uint (value, self->priv->batch_size);
+      break;
+    case PROP_BATCH_TIMEOUT:
+      g_value_set_uint (value, self->priv->batch_timeout / GST_MSECOND);
+      break;
+    case PROP_MEM_BANK:
+      g_value_set_uint (value, self->priv->mem_bank);
+      break;
 #if defined(XLNX_PCIe_PLATFORM) && defined (MANUAL_SOFTKERNEL_DOWNLOAD)
     case PROP_SK_CURRENT_INDEX:
       g_value_set_int (value, self->priv->sk_cur_idx);
@@ -1806,6 +2872,18 @@ gst_ivas_xfilter_finalize (GObject * obj)
   if (self->priv->input_pool)
     gst_object_unref (self->priv->input_pool);
 
+  g_queue_free (self->priv->pending_cmds);
+  ivas_xfilter_clear_caps_memo (self);
+  if (self->priv->dyn_json_config)
+    json_decref (self->priv->dyn_json_config);
+  if (self->priv->dyn_json_pending)
+    json_decref (self->priv->dyn_json_pending);
+  g_async_queue_unref (self->priv->work_queue);
+  g_mutex_clear (&self->priv->work_lock);
+  g_mutex_clear (&self->priv->priv_pool_lock);
+  g_cond_clear (&self->priv->work_cond);
+  g_mutex_clear (&self->priv->batch_lock);
+  g_cond_clear (&self->priv->batch_cond);
   g_free (self->json_file);
 }
 
@@ -1876,9 +2954,43 @@ error:
   return FALSE;
 }
 
+#ifdef XLNX_PCIe_PLATFORM
+/* a software kernel reads only the visible rows, so pull just those from the
+ * device instead of the whole (padded) memory and map without the full sync.
+ * Returns the flags to map the input frame with */
+static GstMapFlags
+ivas_xfilter_sync_input_frame (GstIvas_XFilter * self, GstBuffer * inbuf,
+    GstMapFlags map_flags)
+{
+  GstVideoRectangle rect = { 0, 0,
+    GST_VIDEO_INFO_WIDTH (self->priv->in_vinfo),
+    GST_VIDEO_INFO_HEIGHT (self->priv->in_vinfo)
+  };
+  GstVideoMeta *vmeta;
+  GstMemory *mem;
+  gboolean bret;
+
+  vmeta = gst_buffer_get_video_meta (inbuf);
+  if (!vmeta || gst_buffer_n_memory (inbuf) != 1)
+    return map_flags;
+
+  mem = gst_buffer_peek_memory (inbuf, 0);
+  if (!gst_is_ivas_memory (mem))
+    return map_flags;
+
+  bret = gst_ivas_memory_sync_video_region (mem, vmeta, &rect);
+  if (!bret) {
+    GST_WARNING_OBJECT (self, "partial input sync failed, syncing whole frame");
+    return map_flags;
+  }
+
+  return (GstMapFlags) (map_flags | GST_IVAS_MAP_FLAG_NO_SYNC);
+}
+#endif
+
 static gboolean
 ivas_xfilter_prepare_input_frame (GstIvas_XFilter * self, GstBuffer * inbuf,
-    GstBuffer ** new_inbuf)
+    GstBuffer ** new_inbuf, guint idx)
 {
   GstIvas_XFilterPrivate *priv = self->priv;
   IVASFrame *ivas_frame = NULL;
@@ -1889,7 +3001,7 @@ ivas_xfilter_prepare_input_frame (GstIvas_XFilter * self, GstBuffer * inbuf,
   GstMemory *in_mem = NULL;
   GstMapFlags map_flags;
 
-  ivas_frame = priv->kernel->input[0];
+  ivas_frame = priv->kernel->input[idx];
 
   if (priv->kernel->name || priv->kernel->is_softkernel) { /*HW IP/softkernel */
     in_mem = gst_buffer_get_memory (inbuf, 0);
@@ -1904,36 +3016,11 @@ ivas_xfilter_prepare_input_frame (GstIvas_XFilter * self, GstBuffer * inbuf,
         && gst_ivas_memory_can_avoid_copy (in_mem, priv->dev_idx)) {
       phy_addr = gst_ivas_allocator_get_paddr (in_mem);
     } else if (gst_is_dmabuf_memory (in_mem)) {
-      guint bo = NULLBO;
-      gint dma_fd = -1;
-      struct xclBOProperties p;
-
-      dma_fd = gst_dmabuf_memory_get_fd (in_mem);
-      if (dma_fd < 0) {
-        GST_ERROR_OBJECT (self, "failed to get DMABUF FD");
-        goto error;
-      }
-
-      /* dmabuf but not from ivas allocator */
-      bo = xclImportBO (priv->xcl_handle, dma_fd, 0);
-      if (bo == NULLBO) {
-        GST_WARNING_OBJECT (self,
-            "failed to get XRT BO...fall back to copy input");
-      }
-
-      GST_DEBUG_OBJECT (self, "received dma fd %d and its xrt BO = %u", dma_fd,
-          bo);
-
-      if (!xclGetBOProperties (priv->xcl_handle, bo, &p)) {
-        phy_addr = p.paddr;
-      } else {
+      /* dmabuf but not from ivas allocator, imported once per dmabuf */
+      phy_addr = gst_ivas_dmabuf_import_get_paddr (priv->xcl_handle, in_mem);
+      if (!phy_addr)
         GST_WARNING_OBJECT (self,
             "failed to get physical address...fall back to copy input");
-      }
-
-      if (bo != NULLBO)
-        xclFreeBO(priv->xcl_handle, bo);
-
     }
 
     if (!phy_addr) {
@@ -1974,8 +3061,12 @@ ivas_xfilter_prepare_input_frame (GstIvas_XFilter * self, GstBuffer * inbuf,
 
     if (priv->element_mode == IVAS_ELEMENT_MODE_IN_PLACE)
       map_flags = map_flags | GST_MAP_WRITE;
+#ifdef XLNX_PCIe_PLATFORM
+    else
+      map_flags = ivas_xfilter_sync_input_frame (self, inbuf, map_flags);
+#endif
 
-    if (!gst_video_frame_map (&(priv->kernel->in_vframe), self->priv->in_vinfo,
+    if (!gst_video_frame_map (&(priv->kernel->in_vframe[idx]), self->priv->in_vinfo,
           inbuf, map_flags)) {
       GST_ERROR_OBJECT (self, "failed to map input buffer");
       goto error;
@@ -1984,7 +3075,7 @@ ivas_xfilter_prepare_input_frame (GstIvas_XFilter * self, GstBuffer * inbuf,
     for (plane_id = 0;
         plane_id < GST_VIDEO_INFO_N_PLANES (self->priv->in_vinfo); plane_id++) {
       ivas_frame->vaddr[plane_id] =
-          GST_VIDEO_FRAME_PLANE_DATA (&(priv->kernel->in_vframe), plane_id);
+          GST_VIDEO_FRAME_PLANE_DATA (&(priv->kernel->in_vframe[idx]), plane_id);
       GST_LOG_OBJECT (self, "inbuf plane[%d] : vaddr = %p", plane_id,
           ivas_frame->vaddr[plane_id]);
     }
@@ -2034,7 +3125,8 @@ error:
 }
 
 static gboolean
-ivas_xfilter_prepare_output_frame (GstIvas_XFilter * self, GstBuffer * outbuf)
+ivas_xfilter_prepare_output_frame (GstIvas_XFilter * self, GstBuffer * outbuf,
+    guint idx)
 {
   GstIvas_XFilterPrivate *priv = self->priv;
   IVASFrame *ivas_frame = NULL;
@@ -2052,35 +3144,12 @@ ivas_xfilter_prepare_output_frame (GstIvas_XFilter * self, GstBuffer * outbuf)
   if (gst_is_ivas_memory (out_mem)) {
     phy_addr = gst_ivas_allocator_get_paddr (out_mem);
   } else if (gst_is_dmabuf_memory (out_mem)) {
-    guint bo = NULLBO;
-    gint dma_fd = -1;
-    struct xclBOProperties p;
-
-    dma_fd = gst_dmabuf_memory_get_fd (out_mem);
-    if (dma_fd < 0) {
-      GST_ERROR_OBJECT (self, "failed to get DMABUF FD");
+    /* dmabuf but not from xrt, imported once per dmabuf */
+    phy_addr = gst_ivas_dmabuf_import_get_paddr (priv->xcl_handle, out_mem);
+    if (!phy_addr) {
+      GST_ERROR_OBJECT (self, "failed to get physical address of output");
       goto error;
     }
-
-    /* dmabuf but not from xrt */
-    bo = xclImportBO (self->priv->xcl_handle, dma_fd, 0);
-    if (bo == NULLBO) {
-      GST_WARNING_OBJECT (self,
-        "failed to get XRT BO...fall back to copy input");
-    }
-
-    GST_INFO_OBJECT (self, "received dma fd %d and its xrt BO = %u", dma_fd,
-        bo);
-
-    if (!xclGetBOProperties (self->priv->xcl_handle, bo, &p)) {
-      phy_addr = p.paddr;
-    } else {
-      GST_WARNING_OBJECT (self,
-        "failed to get physical address...fall back to copy input");
-    }
-
-    if (bo != NULLBO)
-      xclFreeBO(self->priv->xcl_handle, bo);
   } else {
     GST_ERROR_OBJECT (self, "Unsupported mem");
     goto error;
@@ -2092,7 +3161,7 @@ ivas_xfilter_prepare_output_frame (GstIvas_XFilter * self, GstBuffer * outbuf)
     goto error;
   }
 
-  ivas_frame = priv->kernel->output[0];
+  ivas_frame = priv->kernel->output[idx];
   ivas_frame->props.width = GST_VIDEO_INFO_WIDTH (self->priv->out_vinfo);
   ivas_frame->props.height = GST_VIDEO_INFO_HEIGHT (self->priv->out_vinfo);
   ivas_frame->props.stride = vmeta->stride[0];
@@ -2103,7 +3172,7 @@ ivas_xfilter_prepare_output_frame (GstIvas_XFilter * self, GstBuffer * outbuf)
 
   if (!(priv->kernel->name || priv->kernel->is_softkernel)) {
     /* software lib mode */
-    if (!gst_video_frame_map (&(priv->kernel->out_vframe), self->priv->out_vinfo,
+    if (!gst_video_frame_map (&(priv->kernel->out_vframe[idx]), self->priv->out_vinfo,
         outbuf, GST_MAP_WRITE)) {
       GST_ERROR_OBJECT (self, "failed to map output buffer");
       goto error;
@@ -2112,7 +3181,7 @@ ivas_xfilter_prepare_output_frame (GstIvas_XFilter * self, GstBuffer * outbuf)
     for (plane_id = 0;
         plane_id < GST_VIDEO_INFO_N_PLANES (self->priv->out_vinfo); plane_id++) {
       ivas_frame->vaddr[plane_id] =
-          GST_VIDEO_FRAME_PLANE_DATA (&(priv->kernel->out_vframe), plane_id);
+          GST_VIDEO_FRAME_PLANE_DATA (&(priv->kernel->out_vframe[idx]), plane_id);
       GST_LOG_OBJECT (self, "outbuf plane[%d] : vaddr = %p", plane_id,
           ivas_frame->vaddr[plane_id]);
     }
@@ -2140,93 +3209,694 @@ error:
   return FALSE;
 }
 
-static GstFlowReturn
-gst_ivas_xfilter_transform_ip (GstBaseTransform * base, GstBuffer * buf)
+#ifdef XLNX_PCIe_PLATFORM
+static gboolean
+ivas_xfilter_mark_output_on_device (GstIvas_XFilter * self, GstBuffer * outbuf)
 {
-  GstIvas_XFilter *self = GST_IVAS_XFILTER (base);
-  Ivas_XFilter *kernel = self->priv->kernel;
-  GstBuffer *new_inbuf = NULL;
-  int ret;
-  gboolean bret = FALSE;
+  GstMemory *outmem = NULL;
 
-  bret = ivas_xfilter_prepare_input_frame (self, buf, &new_inbuf);
-  if (!bret)
-    goto error;
+  outmem = gst_buffer_get_memory (outbuf, 0);
+  if (outmem == NULL) {
+    GST_ERROR_OBJECT (self, "failed to get memory from output buffer");
+    return FALSE;
+  }
+  gst_ivas_memory_set_sync_flag (outmem, IVAS_SYNC_FROM_DEVICE);
+  gst_memory_unref (outmem);
 
-  /* update dynamic json config to kernel */
-  kernel->ivas_handle->kernel_dyn_config = self->priv->dyn_json_config;
+  return TRUE;
+}
+#endif
 
-  ret = kernel->kernel_start_func (kernel->ivas_handle, 0, kernel->input, NULL);
-  if (ret < 0) {
-    GST_ERROR_OBJECT (self, "kernel start failed");
-    goto error;
+static void
+ivas_xfilter_pending_cmd_free (Ivas_XFilterPendingCmd * cmd)
+{
+  if (cmd->inbuf)
+    gst_buffer_unref (cmd->inbuf);
+  if (cmd->new_inbuf)
+    gst_buffer_unref (cmd->new_inbuf);
+  if (cmd->outbuf)
+    gst_buffer_unref (cmd->outbuf);
+  if (cmd->dyn_config)
+    json_decref (cmd->dyn_config);
+  g_slice_free (Ivas_XFilterPendingCmd, cmd);
+}
+
+static GstFlowReturn
+ivas_xfilter_complete_cmd (GstIvas_XFilter * self,
+    Ivas_XFilterPendingCmd * cmd, gboolean push)
+{
+  GstIvas_XFilterPrivate *priv = self->priv;
+  Ivas_XFilter *kernel = priv->kernel;
+  GstFlowReturn fret = GST_FLOW_OK;
+  GstBuffer **buf;
+  int ret;
+
+  if (cmd->cu) {
+    ret = kernel->kernel_wait_func (cmd->cu->ivas_handle, cmd->token,
+        CMD_EXEC_TIMEOUT);
+    cmd->cu->in_flight--;
+  } else {
+    g_mutex_lock (&priv->work_lock);
+    while (!cmd->done)
+      g_cond_wait (&priv->work_cond, &priv->work_lock);
+    ret = cmd->ret;
+    g_mutex_unlock (&priv->work_lock);
+    ivas_xfilter_unmap_frames (self, cmd->slot);
   }
 
-  ret = kernel->kernel_done_func (kernel->ivas_handle);
   if (ret < 0) {
-    GST_ERROR_OBJECT (self, "kernel done failed");
-    goto error;
+    GST_ERROR_OBJECT (self, "kernel wait failed for command %"
+        G_GUINT64_FORMAT, cmd->token);
+    fret = GST_FLOW_ERROR;
+    goto exit;
   }
   g_signal_emit (self, ivas_signals[SIGNAL_IVAS], 0);
+  ivas_xfilter_update_proc_time (self, cmd->start);
+#ifdef XLNX_PCIe_PLATFORM
+  if (cmd->cu && !ivas_xfilter_mark_output_on_device (self, cmd->outbuf)) {
+    fret = GST_FLOW_ERROR;
+    goto exit;
+  }
+#endif
 
-  if (new_inbuf) {
-    GstBufferCopyFlags flags = GST_BUFFER_COPY_FLAGS |
-        GST_BUFFER_COPY_TIMESTAMPS;
+  if (push) {
+    /* workers also run inplace and passthrough frames */
+    buf = cmd->outbuf ? &cmd->outbuf : &cmd->inbuf;
+    GST_LOG_OBJECT (self, "pushing buffer %p of command %" G_GUINT64_FORMAT,
+        *buf, cmd->token);
+    fret = gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (self), *buf);
+    *buf = NULL;
+  }
 
-    if (self->priv->element_mode == IVAS_ELEMENT_MODE_IN_PLACE) {
-      GstMemory *mem = NULL;
-      GstVideoFrame in_vframe, new_vframe;
+exit:
+  ivas_xfilter_pending_cmd_free (cmd);
+  return fret;
+}
+
+/* completes oldest commands until at most max_pending remain in flight */
+static GstFlowReturn
+ivas_xfilter_drain_pending (GstIvas_XFilter * self, guint max_pending,
+    gboolean push)
+{
+  GstFlowReturn fret = GST_FLOW_OK;
 
-      memset (&in_vframe, 0x0, sizeof (GstVideoFrame));
-      memset (&new_vframe, 0x0, sizeof (GstVideoFrame));
+  while (g_queue_get_length (self->priv->pending_cmds) > max_pending) {
+    Ivas_XFilterPendingCmd *cmd = NULL;
+    GstFlowReturn ret;
 
-      flags |= GST_BUFFER_COPY_META;
+    cmd = (Ivas_XFilterPendingCmd *) g_queue_pop_head (self->priv->pending_cmds);
+    /* after a failure remaining commands are only retired, not pushed */
+    ret = ivas_xfilter_complete_cmd (self, cmd, push && fret == GST_FLOW_OK);
+    if (fret == GST_FLOW_OK)
+      fret = ret;
+  }
 
-      mem = gst_buffer_get_memory (new_inbuf, 0);
-      if (mem == NULL) {
-        GST_ERROR_OBJECT (self, "failed to get memory from internal buffer");
-        goto error;
-      }
+  return fret;
+}
+
+static void
+ivas_xfilter_unmap_frames (GstIvas_XFilter * self, guint idx)
+{
+  Ivas_XFilter *kernel = self->priv->kernel;
+
+  if (kernel->name || kernel->is_softkernel)
+    return;
+
+  if (kernel->in_vframe[idx].data[0]) {
+    gst_video_frame_unmap (&(kernel->in_vframe[idx]));
+    memset (&(kernel->in_vframe[idx]), 0x0, sizeof (GstVideoFrame));
+  }
+
+  if (kernel->out_vframe[idx].data[0]) {
+    gst_video_frame_unmap (&(kernel->out_vframe[idx]));
+    memset (&(kernel->out_vframe[idx]), 0x0, sizeof (GstVideoFrame));
+  }
+}
+
+/* copies what the kernel did on the internal copy back to buf */
+static gboolean
+ivas_xfilter_finish_inplace (GstIvas_XFilter * self, GstBuffer * buf,
+    GstBuffer * new_inbuf)
+{
+  GstBufferCopyFlags flags = GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS;
+
+  if (self->priv->element_mode == IVAS_ELEMENT_MODE_IN_PLACE) {
+    GstMemory *mem = NULL;
+    GstVideoFrame in_vframe, new_vframe;
+
+    memset (&in_vframe, 0x0, sizeof (GstVideoFrame));
+    memset (&new_vframe, 0x0, sizeof (GstVideoFrame));
+
+    flags |= GST_BUFFER_COPY_META;
+
+    mem = gst_buffer_get_memory (new_inbuf, 0);
+    if (mem == NULL) {
+      GST_ERROR_OBJECT (self, "failed to get memory from internal buffer");
+      return FALSE;
+    }
 
 #ifdef XLNX_PCIe_PLATFORM
-      /* sync internal buffer buffer data*/
-      gst_ivas_memory_set_sync_flag (mem, IVAS_SYNC_FROM_DEVICE);
-      gst_ivas_memory_sync_with_flags (mem, GST_MAP_READ);
+    /* sync internal buffer buffer data*/
+    gst_ivas_memory_set_sync_flag (mem, IVAS_SYNC_FROM_DEVICE);
+    gst_ivas_memory_sync_with_flags (mem, GST_MAP_READ);
 #endif
 
-      /* map internal buffer in READ mode */
-      if (!gst_video_frame_map (&new_vframe, self->priv->in_vinfo, new_inbuf,
-              GST_MAP_READ)) {
-        GST_ERROR_OBJECT (self, "failed to map internal input buffer");
-        goto error;
+    /* map internal buffer in READ mode */
+    if (!gst_video_frame_map (&new_vframe, self->priv->in_vinfo, new_inbuf,
+            GST_MAP_READ)) {
+      GST_ERROR_OBJECT (self, "failed to map internal input buffer");
+      gst_memory_unref (mem);
+      return FALSE;
+    }
+
+    /* map input buffer in WRITE mode */
+    if (!gst_video_frame_map (&in_vframe, self->priv->in_vinfo, buf,
+            GST_MAP_WRITE)) {
+      GST_ERROR_OBJECT (self, "failed to map input buffer");
+      gst_video_frame_unmap (&new_vframe);
+      gst_memory_unref (mem);
+      return FALSE;
+    }
+
+    GST_CAT_LOG_OBJECT (GST_CAT_PERFORMANCE, self,
+        "slow copy to input buffer");
+
+    /* copy data from internal buffer to input buffer */
+    gst_video_frame_copy (&in_vframe, &new_vframe);
+    gst_video_frame_unmap (&in_vframe);
+    gst_video_frame_unmap (&new_vframe);
+    gst_memory_unref (mem);
+  }
+
+  /* copy back any updates done by ivas kernel lib */
+  gst_buffer_copy_into (buf, new_inbuf, flags, 0, -1);
+
+  return TRUE;
+}
+
+/* Hands the collected batch to the kernel in one call and pushes the results
+ * in arrival order. With push FALSE the batch is only dropped. With keep_last
+ * the last frame is the one being chained and still held by basetransform,
+ * it is pushed here as well so the caller returns DROPPED for every batched
+ * frame and basetransform never flags a DISCONT. Called with the sink pad
+ * stream lock */
+static GstFlowReturn
+ivas_xfilter_submit_batch (GstIvas_XFilter * self, gboolean push,
+    gboolean keep_last)
+{
+  GstIvas_XFilterPrivate *priv = self->priv;
+  Ivas_XFilter *kernel = priv->kernel;
+  GstFlowReturn fret = GST_FLOW_OK;
+  gboolean transform = priv->element_mode == IVAS_ELEMENT_MODE_TRANSFORM;
+  IVASFrame *in_end = NULL, *out_end = NULL;
+  guint len = priv->batch_len;
+  guint i;
+  int ret;
+
+  if (!len)
+    return GST_FLOW_OK;
+
+  if (push) {
+    GST_LOG_OBJECT (self, "submitting batch of %u frames", len);
+
+    /* the frame after the last valid one terminates the batch */
+    if (len < MAX_BATCH_SIZE) {
+      in_end = kernel->input[len];
+      out_end = kernel->output[len];
+      kernel->input[len] = NULL;
+      kernel->output[len] = NULL;
+    }
+
+    ivas_xfilter_apply_dyn_config (self);
+
+    ret = kernel->kernel_start_func (kernel->ivas_handle, 0, kernel->input,
+        transform ? kernel->output : NULL);
+    if (ret < 0) {
+      GST_ERROR_OBJECT (self, "kernel start failed");
+      fret = GST_FLOW_ERROR;
+    } else {
+      ret = kernel->kernel_done_func (kernel->ivas_handle);
+      if (ret < 0) {
+        GST_ERROR_OBJECT (self, "kernel done failed");
+        fret = GST_FLOW_ERROR;
+      } else {
+        g_signal_emit (self, ivas_signals[SIGNAL_IVAS], 0);
       }
+    }
 
-      /* map input buffer in WRITE mode */
-      if (!gst_video_frame_map (&in_vframe, self->priv->in_vinfo, buf,
-              GST_MAP_WRITE)) {
-        GST_ERROR_OBJECT (self, "failed to map input buffer");
-        goto error;
+    if (len < MAX_BATCH_SIZE) {
+      kernel->input[len] = in_end;
+      kernel->output[len] = out_end;
+    }
+
+    /* every frame of the batch waited from its arrival until now */
+    for (i = 0; fret == GST_FLOW_OK && i < len; i++)
+      ivas_xfilter_update_proc_time (self, priv->batch[i]->start);
+  }
+
+  for (i = 0; i < len; i++) {
+    Ivas_XFilterPendingCmd *cmd = priv->batch[i];
+
+    ivas_xfilter_unmap_frames (self, i);
+
+    if (keep_last && i == len - 1) {
+      GstBuffer *inbuf = cmd->inbuf;
+      GstBuffer *outbuf = cmd->outbuf;
+
+      /* drop our refs so basetransform's buffers are writable again, they
+       * stay alive until the caller returns */
+      gst_buffer_unref (cmd->inbuf);
+      cmd->inbuf = NULL;
+      if (cmd->outbuf) {
+        gst_buffer_unref (cmd->outbuf);
+        cmd->outbuf = NULL;
       }
 
-      GST_CAT_LOG_OBJECT (GST_CAT_PERFORMANCE, self,
-          "slow copy to input buffer");
+#ifdef XLNX_PCIe_PLATFORM
+      if (fret == GST_FLOW_OK && transform
+          && !ivas_xfilter_mark_output_on_device (self, outbuf))
+        fret = GST_FLOW_ERROR;
+#endif
 
-      /* copy data from internal buffer to input buffer */
-      gst_video_frame_copy (&in_vframe, &new_vframe);
-      gst_video_frame_unmap (&in_vframe);
-      gst_video_frame_unmap (&new_vframe);
-      gst_memory_unref (mem);
+      if (fret == GST_FLOW_OK && !transform && cmd->new_inbuf
+          && !ivas_xfilter_finish_inplace (self, inbuf, cmd->new_inbuf))
+        fret = GST_FLOW_ERROR;
+
+      if (fret == GST_FLOW_OK)
+        fret = gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (self),
+            gst_buffer_ref (transform ? outbuf : inbuf));
+    } else if (push && fret == GST_FLOW_OK) {
+      /* after a failure remaining frames are only dropped */
+      if (transform) {
+#ifdef XLNX_PCIe_PLATFORM
+        if (!ivas_xfilter_mark_output_on_device (self, cmd->outbuf))
+          fret = GST_FLOW_ERROR;
+#endif
+        if (fret == GST_FLOW_OK) {
+          fret = gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (self), cmd->outbuf);
+          cmd->outbuf = NULL;
+        }
+      } else {
+        if (cmd->new_inbuf
+            && !ivas_xfilter_finish_inplace (self, cmd->inbuf, cmd->new_inbuf))
+          fret = GST_FLOW_ERROR;
+        if (fret == GST_FLOW_OK) {
+          fret = gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (self), cmd->inbuf);
+          cmd->inbuf = NULL;
+        }
+      }
     }
 
-    /* copy back any updates done by ivas kernel lib */
-    gst_buffer_copy_into (buf, new_inbuf, flags, 0, -1);
-    gst_buffer_unref (new_inbuf);
+    ivas_xfilter_pending_cmd_free (cmd);
+    priv->batch[i] = NULL;
   }
 
-  if (!(self->priv->kernel->name || self->priv->kernel->is_softkernel)) {
-    if (kernel->in_vframe.data[0]) {
-      gst_video_frame_unmap (&(kernel->in_vframe));
+  g_mutex_lock (&priv->batch_lock);
+  priv->batch_len = 0;
+  g_mutex_unlock (&priv->batch_lock);
+
+  return fret;
+}
+
+/* flushes a partial batch once its first frame waited batch_timeout */
+static gpointer
+ivas_xfilter_batch_timer (gpointer data)
+{
+  GstIvas_XFilter *self = GST_IVAS_XFILTER (data);
+  GstIvas_XFilterPrivate *priv = self->priv;
+  GstPad *sinkpad = GST_BASE_TRANSFORM_SINK_PAD (self);
+  GstFlowReturn fret;
+
+  g_mutex_lock (&priv->batch_lock);
+  while (!priv->batch_quit) {
+    if (!priv->batch_len) {
+      g_cond_wait (&priv->batch_cond, &priv->batch_lock);
+      continue;
     }
+
+    if (g_get_monotonic_time () < priv->batch_deadline) {
+      g_cond_wait_until (&priv->batch_cond, &priv->batch_lock,
+          priv->batch_deadline);
+      continue;
+    }
+    g_mutex_unlock (&priv->batch_lock);
+
+    /* batch is only touched with the stream lock held */
+    GST_PAD_STREAM_LOCK (sinkpad);
+    if (priv->batch_len && g_get_monotonic_time () >= priv->batch_deadline) {
+      GST_DEBUG_OBJECT (self, "batch timeout with %u of %u frames",
+          priv->batch_len, priv->batch_size);
+      fret = ivas_xfilter_submit_batch (self, TRUE, FALSE);
+      if (fret != GST_FLOW_OK)
+        priv->batch_flow = fret;
+    }
+    GST_PAD_STREAM_UNLOCK (sinkpad);
+
+    g_mutex_lock (&priv->batch_lock);
+  }
+  g_mutex_unlock (&priv->batch_lock);
+
+  return NULL;
+}
+
+static void
+ivas_xfilter_batch_stop (GstIvas_XFilter * self)
+{
+  GstIvas_XFilterPrivate *priv = self->priv;
+
+  if (priv->batch_thread) {
+    g_mutex_lock (&priv->batch_lock);
+    priv->batch_quit = TRUE;
+    g_cond_signal (&priv->batch_cond);
+    g_mutex_unlock (&priv->batch_lock);
+
+    g_thread_join (priv->batch_thread);
+    priv->batch_thread = NULL;
+  }
+
+  if (priv->kernel)
+    ivas_xfilter_submit_batch (self, FALSE, FALSE);
+}
+
+/* adds a frame to the current batch, outbuf is NULL in inplace and
+ * passthrough modes */
+static GstFlowReturn
+ivas_xfilter_batch_add (GstIvas_XFilter * self, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  GstIvas_XFilterPrivate *priv = self->priv;
+  Ivas_XFilterPendingCmd *cmd = NULL;
+  GstBuffer *new_inbuf = NULL;
+  guint idx = priv->batch_len;
+  GstFlowReturn fret;
+
+  /* a push from the batch timer failed */
+  if (priv->batch_flow != GST_FLOW_OK)
+    return priv->batch_flow;
+
+  if (!ivas_xfilter_prepare_input_frame (self, inbuf, &new_inbuf, idx))
+    goto error;
+
+  if (outbuf && !ivas_xfilter_prepare_output_frame (self, outbuf, idx))
+    goto error;
+
+  cmd = g_slice_new0 (Ivas_XFilterPendingCmd);
+  cmd->start = gst_util_get_timestamp ();
+  cmd->inbuf = gst_buffer_ref (inbuf);
+  cmd->new_inbuf = new_inbuf;
+  if (outbuf)
+    cmd->outbuf = gst_buffer_ref (outbuf);
+
+  g_mutex_lock (&priv->batch_lock);
+  priv->batch[idx] = cmd;
+  priv->batch_len++;
+  if (idx == 0) {
+    priv->batch_deadline = g_get_monotonic_time () +
+        priv->batch_timeout / GST_USECOND;
+    g_cond_signal (&priv->batch_cond);
+  }
+  g_mutex_unlock (&priv->batch_lock);
+
+  GST_LOG_OBJECT (self, "added buffer %p to batch, %u of %u", inbuf,
+      priv->batch_len, priv->batch_size);
+
+  /* all frames of the batch, this one included, are pushed by
+   * ivas_xfilter_submit_batch */
+  if (priv->batch_len == priv->batch_size) {
+    fret = ivas_xfilter_submit_batch (self, TRUE, TRUE);
+    if (fret != GST_FLOW_OK)
+      return fret;
+  }
+
+  return GST_BASE_TRANSFORM_FLOW_DROPPED;
+
+error:
+  ivas_xfilter_unmap_frames (self, idx);
+  if (new_inbuf)
+    gst_buffer_unref (new_inbuf);
+
+  return GST_FLOW_ERROR;
+}
+
+/* hands a frame to the worker pool, outbuf is NULL in inplace and
+ * passthrough modes. Frames are pushed in order by
+ * ivas_xfilter_drain_pending */
+static GstFlowReturn
+ivas_xfilter_worker_submit (GstIvas_XFilter * self, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  GstIvas_XFilterPrivate *priv = self->priv;
+  Ivas_XFilterPendingCmd *cmd = NULL;
+  GstBuffer *new_inbuf = NULL;
+  GstFlowReturn fret;
+  guint slot;
+
+  /* at most n_workers - 1 frames are pending, so the slot of the frame
+   * n_workers back is free again */
+  slot = priv->work_seq % priv->kernel->n_workers;
+
+  if (!ivas_xfilter_prepare_input_frame (self, inbuf, &new_inbuf, slot))
+    goto error;
+
+  if (outbuf && !ivas_xfilter_prepare_output_frame (self, outbuf, slot))
+    goto error;
+
+  cmd = g_slice_new0 (Ivas_XFilterPendingCmd);
+  cmd->start = gst_util_get_timestamp ();
+  cmd->slot = slot;
+  cmd->token = priv->work_seq++;
+  ivas_xfilter_apply_dyn_config (self);
+  cmd->dyn_config = json_incref (priv->dyn_json_config);
+  cmd->dyn_config_gen = priv->dyn_config_applied;
+  cmd->inbuf = gst_buffer_ref (inbuf);
+  cmd->new_inbuf = new_inbuf;
+  if (outbuf)
+    cmd->outbuf = gst_buffer_ref (outbuf);
+
+  g_queue_push_tail (priv->pending_cmds, cmd);
+  g_async_queue_push (priv->work_queue, cmd);
+
+  GST_LOG_OBJECT (self, "queued command %" G_GUINT64_FORMAT " in slot %u, "
+      "%u in flight", cmd->token, slot,
+      g_queue_get_length (priv->pending_cmds));
+
+  fret = ivas_xfilter_drain_pending (self, priv->kernel->n_workers - 1, TRUE);
+  if (fret != GST_FLOW_OK)
+    return fret;
+
+  return GST_BASE_TRANSFORM_FLOW_DROPPED;
+
+error:
+  ivas_xfilter_unmap_frames (self, slot);
+  if (new_inbuf)
+    gst_buffer_unref (new_inbuf);
+
+  return GST_FLOW_ERROR;
+}
+
+/* chooses the CU for the next frame. At most max_in_flight - 1 frames are
+ * pending when called, so one CU always has a free command slot. Frames
+ * complete in submission order, so in_flight of a CU drops only once all
+ * frames before its oldest are done */
+static Ivas_XFilterCu *
+ivas_xfilter_pick_cu (GstIvas_XFilter * self)
+{
+  Ivas_XFilter *kernel = self->priv->kernel;
+  guint depth = kernel->ivas_handle->queue_depth;
+  Ivas_XFilterCu *cu = NULL;
+  guint i;
+
+  if (self->priv->cu_dispatch == IVAS_XFILTER_DISPATCH_LEAST_LOADED) {
+    for (i = 0; i < kernel->n_cus; i++) {
+      if (!cu || kernel->cus[i].in_flight < cu->in_flight)
+        cu = &kernel->cus[i];
+    }
+    return cu;
+  }
+
+  for (i = 0; i < kernel->n_cus; i++) {
+    cu = &kernel->cus[kernel->next_cu];
+    kernel->next_cu = (kernel->next_cu + 1) % kernel->n_cus;
+    if (cu->in_flight < depth)
+      break;
+  }
+
+  return cu;
+}
+
+/* whether buf should bypass the kernel as downstream would get it too late
+ * anyway, as decided by drop-policy */
+static gboolean
+ivas_xfilter_qos_skip (GstIvas_XFilter * self, GstBuffer * buf)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (self);
+  GstIvas_XFilterPrivate *priv = self->priv;
+  GstClockTime running_time, stream_time, earliest_time;
+  GstMessage *qos_msg;
+  gdouble proportion;
+
+  if (priv->drop_policy == IVAS_XFILTER_DROP_NEVER ||
+      trans->segment.format != GST_FORMAT_TIME ||
+      !GST_BUFFER_PTS_IS_VALID (buf))
+    return FALSE;
+
+  running_time = gst_segment_to_running_time (&trans->segment,
+      GST_FORMAT_TIME, GST_BUFFER_PTS (buf));
+
+  GST_OBJECT_LOCK (self);
+  earliest_time = priv->earliest_time;
+  proportion = priv->proportion;
+  GST_OBJECT_UNLOCK (self);
+
+  if (!GST_CLOCK_TIME_IS_VALID (running_time) ||
+      !GST_CLOCK_TIME_IS_VALID (earliest_time) ||
+      running_time > earliest_time) {
+    priv->late_count = 0;
+    return FALSE;
+  }
+
+  if (priv->drop_policy == IVAS_XFILTER_DROP_EVERY_NTH &&
+      priv->late_count++ % priv->drop_interval == 0)
+    return FALSE;
+
+  priv->dropped++;
+  GST_DEBUG_OBJECT (self, "skipping late frame with running time %"
+      GST_TIME_FORMAT ", earliest %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (running_time), GST_TIME_ARGS (earliest_time));
+
+  stream_time = gst_segment_to_stream_time (&trans->segment, GST_FORMAT_TIME,
+      GST_BUFFER_PTS (buf));
+  qos_msg = gst_message_new_qos (GST_OBJECT_CAST (self), FALSE, running_time,
+      stream_time, GST_BUFFER_PTS (buf), GST_BUFFER_DURATION (buf));
+  gst_message_set_qos_values (qos_msg,
+      GST_CLOCK_DIFF (running_time, earliest_time), proportion, 1000000);
+  gst_message_set_qos_stats (qos_msg, GST_FORMAT_BUFFERS, priv->processed,
+      priv->dropped);
+  gst_element_post_message (GST_ELEMENT_CAST (self), qos_msg);
+
+  return TRUE;
+}
+
+/* whether frames are pushed by the element itself after the kernel is done
+ * rather than by basetransform on return from transform */
+static gboolean
+ivas_xfilter_defers_output (GstIvas_XFilter * self)
+{
+  GstIvas_XFilterPrivate *priv = self->priv;
+
+  return priv->batch_size > 1 || priv->kernel->n_workers > 1
+      || priv->max_in_flight > 1;
+}
+
+/* pushes a frame that skipped the kernel. Once frames are pushed by the
+ * element, basetransform has seen DROPPED and would flag a DISCONT on a
+ * buffer it pushes, so push it here too and return DROPPED */
+static GstFlowReturn
+ivas_xfilter_push_skipped (GstIvas_XFilter * self, GstBuffer * buf)
+{
+  GstFlowReturn fret;
+
+  if (!ivas_xfilter_defers_output (self))
+    return GST_FLOW_OK;
+
+  fret = gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (self),
+      gst_buffer_ref (buf));
+  if (fret != GST_FLOW_OK)
+    return fret;
+
+  return GST_BASE_TRANSFORM_FLOW_DROPPED;
+}
+
+/* copies what downstream metadata consumers need from a skipped inbuf. The
+ * flags, timestamps and untagged metas were already copied by basetransform,
+ * the rest is added unless outbuf has a meta of that API already */
+static gboolean
+ivas_xfilter_copy_skipped_meta (GstBuffer * inbuf, GstMeta ** meta,
+    gpointer user_data)
+{
+  GstBuffer *outbuf = GST_BUFFER_CAST (user_data);
+  const GstMetaInfo *info = (*meta)->info;
+  GstMetaTransformCopy copy_data = { FALSE, 0, -1 };
+
+  if (info->api == GST_VIDEO_META_API_TYPE
+      || gst_buffer_get_meta (outbuf, info->api) || !info->transform_func)
+    return TRUE;
+
+  info->transform_func (outbuf, *meta, inbuf,
+      _gst_meta_transform_copy, &copy_data);
+
+  return TRUE;
+}
+
+/* pushes the frames still with the kernel so a skipped one stays in order */
+static GstFlowReturn
+ivas_xfilter_flush_in_flight (GstIvas_XFilter * self)
+{
+  GstFlowReturn fret;
+
+  fret = ivas_xfilter_submit_batch (self, TRUE, FALSE);
+  if (fret != GST_FLOW_OK)
+    return fret;
+
+  return ivas_xfilter_drain_pending (self, 0, TRUE);
+}
+
+static void
+ivas_xfilter_update_proc_time (GstIvas_XFilter * self, GstClockTime start)
+{
+  GstIvas_XFilterPrivate *priv = self->priv;
+  GstClockTime elapsed = gst_util_get_timestamp () - start;
+
+  /* running average over roughly the last 8 frames */
+  GST_OBJECT_LOCK (self);
+  if (priv->avg_proc_time)
+    priv->avg_proc_time = (7 * priv->avg_proc_time + elapsed) / 8;
+  else
+    priv->avg_proc_time = elapsed;
+  GST_OBJECT_UNLOCK (self);
+
+  priv->processed++;
+}
+
+static GstFlowReturn
+ivas_xfilter_process_ip (GstIvas_XFilter * self, GstBuffer * buf)
+{
+  Ivas_XFilter *kernel = self->priv->kernel;
+  GstBuffer *new_inbuf = NULL;
+  int ret;
+  gboolean bret = FALSE;
+
+  if (self->priv->batch_size > 1)
+    return ivas_xfilter_batch_add (self, buf, NULL);
+
+  if (kernel->n_workers > 1)
+    return ivas_xfilter_worker_submit (self, buf, NULL);
+
+  bret = ivas_xfilter_prepare_input_frame (self, buf, &new_inbuf, 0);
+  if (!bret)
+    goto error;
+
+  ivas_xfilter_apply_dyn_config (self);
+
+  ret = kernel->kernel_start_func (kernel->ivas_handle, 0, kernel->input, NULL);
+  if (ret < 0) {
+    GST_ERROR_OBJECT (self, "kernel start failed");
+    goto error;
+  }
+
+  ret = kernel->kernel_done_func (kernel->ivas_handle);
+  if (ret < 0) {
+    GST_ERROR_OBJECT (self, "kernel done failed");
+    goto error;
+  }
+  g_signal_emit (self, ivas_signals[SIGNAL_IVAS], 0);
+
+  ivas_xfilter_unmap_frames (self, 0);
+
+  if (new_inbuf) {
+    if (!ivas_xfilter_finish_inplace (self, buf, new_inbuf))
+      goto error;
+    gst_buffer_unref (new_inbuf);
   }
 
   GST_LOG_OBJECT (self, "processed buffer %p", buf);
@@ -2234,6 +3904,7 @@ gst_ivas_xfilter_transform_ip (GstBaseTransform * base, GstBuffer * buf)
   return GST_FLOW_OK;
 
 error:
+  ivas_xfilter_unmap_frames (self, 0);
 
   if (new_inbuf)
     gst_buffer_unref (new_inbuf);
@@ -2242,25 +3913,63 @@ error:
 }
 
 static GstFlowReturn
-gst_ivas_xfilter_transform (GstBaseTransform * base, GstBuffer * inbuf,
+ivas_xfilter_process (GstIvas_XFilter * self, GstBuffer * inbuf,
     GstBuffer * outbuf)
 {
-  GstIvas_XFilter *self = GST_IVAS_XFILTER (base);
   Ivas_XFilter *kernel = self->priv->kernel;
   GstBuffer *new_inbuf = NULL;
   int ret;
   gboolean bret = FALSE;
 
-  bret = ivas_xfilter_prepare_input_frame (self, inbuf, &new_inbuf);
+  if (self->priv->batch_size > 1)
+    return ivas_xfilter_batch_add (self, inbuf, outbuf);
+
+  if (kernel->n_workers > 1)
+    return ivas_xfilter_worker_submit (self, inbuf, outbuf);
+
+  bret = ivas_xfilter_prepare_input_frame (self, inbuf, &new_inbuf, 0);
   if (!bret)
     goto error;
 
-  bret = ivas_xfilter_prepare_output_frame (self, outbuf);
+  bret = ivas_xfilter_prepare_output_frame (self, outbuf, 0);
   if (!bret)
     goto error;
 
-  /* update dynamic json config to kernel */
-  kernel->ivas_handle->kernel_dyn_config = self->priv->dyn_json_config;
+  ivas_xfilter_apply_dyn_config (self);
+
+  if (self->priv->max_in_flight > 1) {
+    Ivas_XFilterPendingCmd *cmd = NULL;
+    GstFlowReturn fret;
+
+    cmd = g_slice_new0 (Ivas_XFilterPendingCmd);
+    cmd->start = gst_util_get_timestamp ();
+    cmd->cu = ivas_xfilter_pick_cu (self);
+    ret = kernel->kernel_start_async_func (cmd->cu->ivas_handle, 0,
+        kernel->input, kernel->output, &cmd->token);
+    if (ret < 0) {
+      GST_ERROR_OBJECT (self, "kernel async start failed");
+      g_slice_free (Ivas_XFilterPendingCmd, cmd);
+      goto error;
+    }
+    cmd->cu->in_flight++;
+
+    cmd->inbuf = gst_buffer_ref (inbuf);
+    cmd->new_inbuf = new_inbuf;
+    cmd->outbuf = gst_buffer_ref (outbuf);
+    g_queue_push_tail (self->priv->pending_cmds, cmd);
+
+    GST_LOG_OBJECT (self, "submitted command %" G_GUINT64_FORMAT
+        " to cu %d, %u in flight", cmd->token, cmd->cu->cu_idx,
+        g_queue_get_length (self->priv->pending_cmds));
+
+    fret = ivas_xfilter_drain_pending (self, self->priv->max_in_flight - 1,
+        TRUE);
+    if (fret != GST_FLOW_OK)
+      return fret;
+
+    /* outbuf is pushed by ivas_xfilter_drain_pending once it is complete */
+    return GST_BASE_TRANSFORM_FLOW_DROPPED;
+  }
 
   ret =
       kernel->kernel_start_func (kernel->ivas_handle, 0, kernel->input,
@@ -2277,27 +3986,11 @@ gst_ivas_xfilter_transform (GstBaseTransform * base, GstBuffer * inbuf,
   }
   g_signal_emit (self, ivas_signals[SIGNAL_IVAS], 0);
 #ifdef XLNX_PCIe_PLATFORM
-  {
-    GstMemory *outmem = NULL;
-    outmem = gst_buffer_get_memory (outbuf, 0);
-    if (outmem == NULL) {
-      GST_ERROR_OBJECT (self, "failed to get memory from output buffer");
-      goto error;
-    }
-    gst_ivas_memory_set_sync_flag (outmem, IVAS_SYNC_FROM_DEVICE);
-    gst_memory_unref (outmem);
-  }
+  if (!ivas_xfilter_mark_output_on_device (self, outbuf))
+    goto error;
 #endif
 
-  if (!(self->priv->kernel->name || self->priv->kernel->is_softkernel)) {
-    if (kernel->in_vframe.data[0]) {
-      gst_video_frame_unmap (&(kernel->in_vframe));
-    }
-
-    if (kernel->out_vframe.data[0]) {
-      gst_video_frame_unmap (&(kernel->out_vframe));
-    }
-  }
+  ivas_xfilter_unmap_frames (self, 0);
 
   if (new_inbuf)
     gst_buffer_unref (new_inbuf);
@@ -2305,6 +3998,7 @@ gst_ivas_xfilter_transform (GstBaseTransform * base, GstBuffer * inbuf,
   return GST_FLOW_OK;
 
 error:
+  ivas_xfilter_unmap_frames (self, 0);
 
   if (new_inbuf)
     gst_buffer_unref (new_inbuf);
@@ -2312,9 +4006,72 @@ error:
   return GST_FLOW_ERROR;
 }
 
+static GstFlowReturn
+gst_ivas_xfilter_transform_ip (GstBaseTransform * base, GstBuffer * buf)
+{
+  GstIvas_XFilter *self = GST_IVAS_XFILTER (base);
+  GstClockTime start;
+  GstFlowReturn fret;
+
+  /* a skipped frame goes downstream as is, keeping its metadata */
+  if (ivas_xfilter_qos_skip (self, buf)) {
+    fret = ivas_xfilter_flush_in_flight (self);
+    if (fret != GST_FLOW_OK)
+      return fret;
+
+    return ivas_xfilter_push_skipped (self, buf);
+  }
+
+  start = gst_util_get_timestamp ();
+  fret = ivas_xfilter_process_ip (self, buf);
+  /* deferred frames are accounted for when the kernel completes them */
+  if (fret == GST_FLOW_OK)
+    ivas_xfilter_update_proc_time (self, start);
+
+  return fret;
+}
+
+static GstFlowReturn
+gst_ivas_xfilter_transform (GstBaseTransform * base, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  GstIvas_XFilter *self = GST_IVAS_XFILTER (base);
+  GstClockTime start;
+  GstFlowReturn fret;
+
+  /* outbuf holds no picture, it goes downstream flagged GAP so metadata
+   * consumers still get every frame */
+  if (ivas_xfilter_qos_skip (self, inbuf)) {
+    fret = ivas_xfilter_flush_in_flight (self);
+    if (fret != GST_FLOW_OK)
+      return fret;
+
+    gst_buffer_copy_into (outbuf, inbuf,
+        GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+    gst_buffer_foreach_meta (inbuf, ivas_xfilter_copy_skipped_meta, outbuf);
+    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_GAP);
+
+    return ivas_xfilter_push_skipped (self, outbuf);
+  }
+
+  start = gst_util_get_timestamp ();
+  fret = ivas_xfilter_process (self, inbuf, outbuf);
+  /* deferred frames are accounted for when the kernel completes them */
+  if (fret == GST_FLOW_OK)
+    ivas_xfilter_update_proc_time (self, start);
+
+  return fret;
+}
+
 static gboolean
 plugin_init (GstPlugin * ivas_xfilter)
 {
+  const gchar *route_logs = g_getenv ("IVAS_LOG_GST");
+
+  /* kernel library logs go to stdout unless asked for otherwise */
+  if (route_logs && atoi (route_logs))
+    gst_ivas_utils_route_logs_to_gst ();
+
   return gst_element_register (ivas_xfilter, "ivas_xfilter", GST_RANK_NONE,
       GST_TYPE_IVAS_XFILTER);
 }
@@ -53,6 +53,9 @@
 #include <dlfcn.h>
 #include <jansson.h>
 #include "gstivas_xmultisrc.h"
+#include <gst/ivas/gstivasbufferpool.h>
+#include <gst/ivas/gstivasvideoformat.h>
+#include <gst/ivas/gstivasutils.h>
 extern "C"
 {
 #include "ivas/xrt_utils.h"
@@ -66,18 +69,15 @@ extern "C"
 
 #define MIN_POOL_BUFFERS 3
 #define MAX_KERNELS	10
-int f_num = 0;
-int fps = 0;
 #define PROFILING 1
-struct timespec start, end;
 
-pthread_mutex_t count_mutex;
 GST_DEBUG_CATEGORY_STATIC (gst_ivas_xmultisrc_debug);
 #define GST_CAT_DEFAULT gst_ivas_xmultisrc_debug
 
 #define REPO_PATH	"/usr/lib"
 
 #define DEFAULT_DEVICE_INDEX 0
+#define DEFAULT_MEM_BANK 0
 
 static const int ERT_CMD_SIZE = 4096;
 
@@ -86,6 +86,7 @@ enum
   PROP_0,
   PROP_XCLBIN_LOCATION,
   PROP_CONFIG_LOCATION,
+  PROP_MEM_BANK,
 };
 
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
@@ -191,6 +192,17 @@ struct _GstIvasXMSRCPrivate
   IVASFrame *output[MAX_CHANNELS];
   GstIvasXMSRCKernel kernels[MAX_KERNELS];
   IVASKernelDoneFunc kernel_done_func;
+  /* CUs used by the kernels, sorted and without duplicates. They are held
+   * from the first kernel start to kernel done */
+  GstIvasCuLock *cu_locks[MAX_KERNELS];
+  guint n_cu_locks;
+  guint64 frames;
+  guint64 contended;            /* frames which waited for another instance */
+  GstClockTime wait_time;
+#if PROFILING
+  int f_num;
+  struct timespec start;
+#endif
 };
 
 #define gst_ivas_xmultisrc_parent_class parent_class
@@ -231,27 +243,28 @@ error:
 static inline IVASVideoFormat
 get_kernellib_format (GstVideoFormat gst_fmt)
 {
-  switch (gst_fmt) {
-    case GST_VIDEO_FORMAT_GRAY8:
-      return IVAS_VFMT_Y8;
-    case GST_VIDEO_FORMAT_NV12:
-      return IVAS_VFMT_Y_UV8_420;
-    case GST_VIDEO_FORMAT_BGR:
-      return IVAS_VFMT_BGR8;
-    case GST_VIDEO_FORMAT_RGB:
-      return IVAS_VFMT_RGB8;
-    case GST_VIDEO_FORMAT_YUY2:
-      return IVAS_VFMT_YUYV8;
-    case GST_VIDEO_FORMAT_r210:
-      return IVAS_VFMT_RGBX10;
-    case GST_VIDEO_FORMAT_v308:
-      return IVAS_VFMT_YUV8;
-    case GST_VIDEO_FORMAT_GRAY10_LE32:
-      return IVAS_VFMT_Y10;
-    default:
-      GST_ERROR ("Not supporting %s yet", gst_video_format_to_string (gst_fmt));
-      return IVAS_VMFT_UNKNOWN;
+  IVASVideoFormat kernel_fmt = gst_ivas_video_format_to_kernel (gst_fmt);
+
+  if (kernel_fmt == IVAS_VMFT_UNKNOWN)
+    GST_ERROR ("Not supporting %s yet", gst_video_format_to_string (gst_fmt));
+
+  return kernel_fmt;
+}
+
+/* kernels without a name do not run on a CU of their own, they are
+ * serialized with the other nameless kernels of the device */
+static void
+ivas_xmultisrc_add_cu_lock (GstIvasXMSRC * self, gint cu_idx)
+{
+  GstIvasXMSRCPrivate *priv = self->priv;
+  GstIvasCuLock *cu_lock = gst_ivas_cu_lock_get (DEFAULT_DEVICE_INDEX, cu_idx);
+  guint i;
+
+  for (i = 0; i < priv->n_cu_locks; i++) {
+    if (priv->cu_locks[i] == cu_lock)
+      return;
   }
+  priv->cu_locks[priv->n_cu_locks++] = cu_lock;
 }
 
 static gboolean
@@ -349,6 +362,8 @@ ivas_xmultisrc_open (GstIvasXMSRC * self)
           "kernel name is not available, kernel lib is non-XRT based one");
     }
     ivas_handle->cu_idx = cu_index;
+    ivas_xmultisrc_add_cu_lock (self, json_is_string (value) ?
+        (gint) cu_index : GST_IVAS_CU_LOCK_DEVICE);
 
     if (xclOpenContext (priv->xcl_handle, priv->xclbinId, cu_index, true)) {
       GST_ERROR_OBJECT (self, "failed to do xclOpenContext...");
@@ -398,6 +413,14 @@ ivas_xmultisrc_open (GstIvasXMSRC * self)
   }
   json_decref (root);
 
+  qsort (priv->cu_locks, priv->n_cu_locks, sizeof (priv->cu_locks[0]),
+      gst_ivas_cu_lock_compare);
+  priv->frames = priv->contended = 0;
+  priv->wait_time = 0;
+#if PROFILING
+  priv->f_num = 0;
+#endif
+
   for (i = 0; i < priv->kernel_count; i++) {
 
     priv->kernels[i].lib_fd = dlopen (priv->kernels[i].lib_path, RTLD_LAZY);
@@ -465,7 +488,8 @@ ivas_xmultisrc_allocate_internal_pool (GstIvasXMSRC * self)
   pool = gst_video_buffer_pool_new ();
   GST_LOG_OBJECT (self, "allocated internal sink pool %p", pool);
 
-  allocator = gst_ivas_allocator_new (DEFAULT_DEVICE_INDEX, TRUE);
+  allocator = gst_ivas_allocator_new_with_bank (DEFAULT_DEVICE_INDEX,
+      TRUE, self->mem_bank);
   gst_allocation_params_init (&alloc_params);
   alloc_params.flags = GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
 
@@ -525,35 +549,14 @@ ivas_xmultisrc_write_input_registers (GstIvasXMSRC * self, GstBuffer ** inbuf)
 #endif
 
   } else if (gst_is_dmabuf_memory (in_mem)) {
-    guint bo = NULLBO;
-    gint dma_fd = -1;
-    struct xclBOProperties p;
-
-    dma_fd = gst_dmabuf_memory_get_fd (in_mem);
-    if (dma_fd < 0) {
-      GST_ERROR_OBJECT (self, "failed to get DMABUF FD");
-      goto error;
-    }
-    /* dmabuf but not from xrt */
-    bo = xclImportBO (self->priv->xcl_handle, dma_fd, 0);
-    if (bo == NULLBO) {
-      GST_WARNING_OBJECT (self,
-          "failed to get XRT BO...fall back to copy input");
-    }
-
-    GST_DEBUG_OBJECT (self, "received dma fd %d and its xrt BO = %u", dma_fd,
-        bo);
-
-    if (!xclGetBOProperties (self->priv->xcl_handle, bo, &p)) {
-      phy_addr = p.paddr;
-    } else {
+    /* dmabuf but not from xrt, imported once per dmabuf */
+    phy_addr =
+        gst_ivas_dmabuf_import_get_paddr (self->priv->xcl_handle, in_mem);
+    if (!phy_addr) {
       GST_WARNING_OBJECT (self,
           "failed to get physical address...fall back to copy input");
       use_inpool = TRUE;
     }
-
-    if (bo != NULLBO)
-      xclFreeBO(self->priv->xcl_handle, bo);
   } else {
     use_inpool = TRUE;
   }
@@ -714,35 +717,13 @@ ivas_xmultisrc_write_output_registers (GstIvasXMSRC * self)
       phy_addr = gst_ivas_allocator_get_paddr (mem);
 
     } else if (gst_is_dmabuf_memory (mem)) {
-      guint bo = NULLBO;
-      gint dma_fd = -1;
-      struct xclBOProperties p;
-
-      dma_fd = gst_dmabuf_memory_get_fd (mem);
-      if (dma_fd < 0) {
-        GST_ERROR_OBJECT (self, "failed to get DMABUF FD");
+      /* dmabuf but not from xrt, imported once per dmabuf */
+      phy_addr =
+          gst_ivas_dmabuf_import_get_paddr (self->priv->xcl_handle, mem);
+      if (!phy_addr) {
+        GST_ERROR_OBJECT (self, "failed to get physical address of output");
         goto error;
       }
-
-      /* dmabuf but not from xrt */
-      bo = xclImportBO (self->priv->xcl_handle, dma_fd, 0);
-      if (bo == NULLBO) {
-        GST_WARNING_OBJECT (self,
-            "failed to get XRT BO...fall back to copy input");
-      }
-
-      GST_INFO_OBJECT (self, "received dma fd %d and its xrt BO = %u", dma_fd,
-          bo);
-
-      if (!xclGetBOProperties (self->priv->xcl_handle, bo, &p)) {
-        phy_addr = p.paddr;
-      } else {
-        GST_WARNING_OBJECT (self,
-            "failed to get physical address...fall back to copy input");
-      }
-
-      if (bo != NULLBO)
-        xclFreeBO(self->priv->xcl_handle, bo);
     }
     if (phy_addr == (uint64_t) - 1) {
       phy_addr = gst_ivas_allocator_get_paddr (mem);
@@ -796,6 +777,18 @@ ivas_xmultisrc_process (GstIvasXMSRC * self)
 {
   size_t i, ret, start = 0x1;
   GstIvasXMSRCPrivate *priv = self->priv;
+  GstClockTime wait = 0;
+  gboolean bret = FALSE;
+
+  /* only instances sharing a CU wait for each other */
+  for (i = 0; i < priv->n_cu_locks; i++)
+    wait += gst_ivas_cu_lock_acquire (priv->cu_locks[i]);
+
+  priv->frames++;
+  if (wait) {
+    priv->contended++;
+    priv->wait_time += wait;
+  }
 
   for (i = 0; i < priv->kernel_count; i++) {
     ret =
@@ -803,16 +796,22 @@ ivas_xmultisrc_process (GstIvasXMSRC * self)
         ivas_handle, start, &(self->priv->input), self->priv->output);
     if (ret < 0) {
       GST_ERROR_OBJECT (self, "kernel start failed");
-      return FALSE;
+      goto out;
     }
   }
 
   ret = self->priv->kernel_done_func (self->priv->kernels[0].ivas_handle);
   if (ret < 0) {
     GST_ERROR_OBJECT (self, "kernel done failed");
-    return FALSE;
+    goto out;
   }
-  return TRUE;
+  bret = TRUE;
+
+out:
+  for (i = priv->n_cu_locks; i > 0; i--)
+    gst_ivas_cu_lock_release (priv->cu_locks[i - 1]);
+
+  return bret;
 }
 
 static void
@@ -822,12 +821,31 @@ ivas_xmultisrc_close (GstIvasXMSRC * self)
   GST_DEBUG_OBJECT (self, "Closing");
   size_t i;
 
+  if (priv->frames)
+    GST_INFO_OBJECT (self, "%" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT
+        " frames waited for a busy CU, %" GST_TIME_FORMAT " in total",
+        priv->contended, priv->frames, GST_TIME_ARGS (priv->wait_time));
+
+  for (i = 0; i < priv->n_cu_locks; i++) {
+    guint64 acquired, contended;
+    GstClockTime wait_time;
+
+    gst_ivas_cu_lock_get_stats (priv->cu_locks[i], &acquired, &contended,
+        &wait_time);
+    GST_DEBUG_OBJECT (self, "CU lock %" G_GSIZE_FORMAT " over all instances: "
+        "%" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " acquisitions "
+        "contended, %" GST_TIME_FORMAT " waited", i, contended, acquired,
+        GST_TIME_ARGS (wait_time));
+  }
+  priv->n_cu_locks = 0;
+
   for (i = 0; i < priv->kernel_count; i++) {
     if (self->priv->kernels[i].kernel_deinit_func)
       self->priv->kernels[i].kernel_deinit_func (self->priv->kernels[i].
           ivas_handle);
     if (priv->kernels[i].lib_fd)
       dlclose (priv->kernels[i].lib_fd);
+    ivas_kernel_release_stats (priv->kernels[i].ivas_handle);
     if (priv->kernels[i].ivas_handle->ert_cmd_buf) {
       free_xrt_buffer (priv->xcl_handle,
           priv->kernels[i].ivas_handle->ert_cmd_buf);
@@ -838,6 +856,8 @@ ivas_xmultisrc_close (GstIvasXMSRC * self)
     xclCloseContext (priv->xcl_handle, priv->xclbinId,
         priv->kernels[i].ivas_handle->cu_idx);
   }
+  gst_ivas_dmabuf_import_release (priv->xcl_handle);
+  ivas_buffer_cache_release (priv->xcl_handle);
   xclClose (priv->xcl_handle);
 }
 
@@ -892,6 +912,13 @@ gst_ivas_xmultisrc_class_init (GstIvasXMSRCClass * klass)
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
               GST_PARAM_MUTABLE_READY)));
 
+  g_object_class_install_property (gobject_class, PROP_MEM_BANK,
+      g_param_spec_uint ("mem-bank", "Device memory bank",
+          "Device memory bank the element allocates its buffers from",
+          0, 31, DEFAULT_MEM_BANK,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
 }
 
 static void
@@ -909,6 +936,7 @@ gst_ivas_xmultisrc_init (GstIvasXMSRC * self)
   gst_element_add_pad (GST_ELEMENT (self), self->sinkpad);
 
   self->num_request_pads = 0;
+  self->mem_bank = DEFAULT_MEM_BANK;
   self->pad_indexes = g_hash_table_new (NULL, NULL);
   self->srcpads = NULL;
   self->priv->in_vinfo = gst_video_info_new ();
@@ -1042,6 +1070,9 @@ gst_ivas_xmultisrc_set_property (GObject * object, guint prop_id,
       }
       self->config_file = g_value_dup_string (value);
       break;
+    case PROP_MEM_BANK:
+      self->mem_bank = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1058,6 +1089,9 @@ gst_ivas_xmultisrc_get_property (GObject * object, guint prop_id,
     case PROP_CONFIG_LOCATION:
       g_value_set_string (value, self->config_file);
       break;
+    case PROP_MEM_BANK:
+      g_value_set_uint (value, self->mem_bank);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1775,14 +1809,40 @@ error_cleanup:
   }
 }
 
+/* plane layout every kernel in the chain can write, 1 when none asked */
+static void
+ivas_xmultisrc_kernel_align (GstIvasXMSRC * self, guint * stride_align,
+    guint * elevation_align)
+{
+  GstIvasXMSRCPrivate *priv = self->priv;
+  guint i;
+
+  *stride_align = 1;
+  *elevation_align = 1;
+
+  for (i = 0; i < priv->kernel_count; i++) {
+    IVASKernel *handle = priv->kernels[i].ivas_handle;
+
+    if (!handle)
+      continue;
+
+    *stride_align = gst_ivas_buffer_pool_lcm_align (*stride_align,
+        MAX (ivas_caps_get_stride_align (handle, SRC), 1));
+    *elevation_align = gst_ivas_buffer_pool_lcm_align (*elevation_align,
+        MAX (ivas_caps_get_height_align (handle, SRC), 1));
+  }
+}
+
 static gboolean
-ivas_xmultisrc_decide_allocation (GstIvasXMSRCPad * srcpad, GstQuery * query,
-    GstCaps * outcaps)
+ivas_xmultisrc_decide_allocation (GstIvasXMSRC * self,
+    GstIvasXMSRCPad * srcpad, GstQuery * query, GstCaps * outcaps)
 {
   GstAllocator *allocator = NULL;
   GstAllocationParams params;
   GstBufferPool *pool = NULL;
+  GstBufferPool *proposed = NULL;
   guint size, min, max;
+  guint stride_align, elevation_align;
   gboolean update_allocator, update_pool, bret;
   GstStructure *config = NULL;
 
@@ -1819,6 +1879,14 @@ ivas_xmultisrc_decide_allocation (GstIvasXMSRCPad * srcpad, GstQuery * query,
     update_pool = FALSE;
   }
 
+  /* an IVAS pool from downstream is shared only when its layout also suits
+   * the kernels, gst_ivas_buffer_pool_negotiate() decides below */
+  if (pool && GST_IS_IVAS_BUFFER_POOL (pool)) {
+    proposed = pool;
+    pool = NULL;
+  }
+  ivas_xmultisrc_kernel_align (self, &stride_align, &elevation_align);
+
   if (pool) {
     GstStructure *config = gst_buffer_pool_get_config (pool);
 
@@ -1847,7 +1915,8 @@ ivas_xmultisrc_decide_allocation (GstIvasXMSRCPad * srcpad, GstQuery * query,
 
   if (!allocator) {
     /* making sdx allocator for the HW mode without dmabuf */
-    allocator = gst_ivas_allocator_new (DEFAULT_DEVICE_INDEX, TRUE);
+    allocator = gst_ivas_allocator_new_with_bank (DEFAULT_DEVICE_INDEX,
+        TRUE, self->mem_bank);
     params.flags = GST_MEMORY_FLAG_PHYSICALLY_CONTIGUOUS;
     GST_INFO_OBJECT (srcpad, "creating new xrt allocator %" GST_PTR_FORMAT,
         allocator);
@@ -1861,7 +1930,10 @@ next:
 
   if (pool == NULL) {
     GST_DEBUG_OBJECT (srcpad, "no pool, making new pool");
-    pool = gst_video_buffer_pool_new ();
+    /* lays buffers out for the kernels and whatever IVAS elements
+     * downstream asked for, sharing downstream's pool when it already does */
+    pool = gst_ivas_buffer_pool_negotiate (query, proposed, stride_align,
+        elevation_align);
   }
 
   config = gst_buffer_pool_get_config (pool);
@@ -1869,6 +1941,25 @@ next:
   gst_buffer_pool_config_set_allocator (config, allocator, &params);
   gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
   bret = gst_buffer_pool_set_config (pool, config);
+  if (!bret && proposed && pool == proposed) {
+    /* downstream's pool is already in use with another configuration */
+    GST_DEBUG_OBJECT (srcpad, "shared pool rejected config, making own pool");
+    gst_object_unref (pool);
+    pool = gst_ivas_buffer_pool_negotiate (query, NULL, stride_align,
+        elevation_align);
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, outcaps, size, min, max);
+    gst_buffer_pool_config_set_allocator (config, allocator, &params);
+    gst_buffer_pool_config_add_option (config,
+        GST_BUFFER_POOL_OPTION_VIDEO_META);
+    bret = gst_buffer_pool_set_config (pool, config);
+  }
+
+  if (proposed) {
+    gst_object_unref (proposed);
+    proposed = NULL;
+  }
+
   if (!bret) {
     GST_ERROR_OBJECT (srcpad, "failed configure pool");
     goto error;
@@ -1893,6 +1984,8 @@ error:
     gst_object_unref (allocator);
   if (pool)
     gst_object_unref (pool);
+  if (proposed)
+    gst_object_unref (proposed);
   return FALSE;
 }
 
@@ -1954,7 +2047,7 @@ gst_ivas_xmultisrc_sink_setcaps (GstIvasXMSRC * self, GstPad * sinkpad,
         GST_DEBUG_OBJECT (self, "peer ALLOCATION query failed");
       }
 
-      bret = ivas_xmultisrc_decide_allocation (srcpad, query, outcaps);
+      bret = ivas_xmultisrc_decide_allocation (self, srcpad, query, outcaps);
       if (!bret)
         goto failed_configure;
 
@@ -2057,7 +2150,8 @@ ivas_xmultisrc_propose_allocation (GstIvasXMSRC * self, GstQuery * query)
     if (gst_query_get_n_allocation_params (query) > 0) {
       gst_query_parse_nth_allocation_param (query, 0, &allocator, &params);
     } else {
-      allocator = gst_ivas_allocator_new (DEFAULT_DEVICE_INDEX, TRUE);
+      allocator = gst_ivas_allocator_new_with_bank (DEFAULT_DEVICE_INDEX,
+          TRUE, self->mem_bank);
       gst_query_add_allocation_param (query, allocator, &params);
     }
 
@@ -2189,27 +2283,26 @@ gst_ivas_xmultisrc_chain (GstPad * pad, GstObject * parent, GstBuffer * inbuf)
   if (!bret)
     goto error;
 
-  pthread_mutex_lock (&count_mutex);    /* lock for TDM */
 #if PROFILING
-  f_num++;
-  if (f_num == 1)
-    clock_gettime (CLOCK_MONOTONIC_RAW, &start);
-  if (f_num == 1000) {
+  self->priv->f_num++;
+  if (self->priv->f_num == 1)
+    clock_gettime (CLOCK_MONOTONIC_RAW, &self->priv->start);
+  if (self->priv->f_num == 1000) {
+    struct timespec end;
+
     clock_gettime (CLOCK_MONOTONIC_RAW, &end);
     delta_us =
-        (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec -
-        start.tv_nsec) / 1000;
-    GST_INFO_OBJECT (self, "IVAS MSRC %d fps %ld\n", f_num,
+        (end.tv_sec - self->priv->start.tv_sec) * 1000000 + (end.tv_nsec -
+        self->priv->start.tv_nsec) / 1000;
+    GST_INFO_OBJECT (self, "IVAS MSRC %d fps %ld\n", self->priv->f_num,
         1000000 / (delta_us / 1000));
-    f_num = 0;
+    self->priv->f_num = 0;
   }
 #endif
   bret = ivas_xmultisrc_process (self);
   if (!bret)
     goto error;
 
-  pthread_mutex_unlock (&count_mutex);
-
   /* pad push of each output buffer to respective srcpad */
   for (chan_id = 0; chan_id < self->num_request_pads; chan_id++) {
     GstBuffer *outbuf = self->priv->outbufs[chan_id];
@@ -2229,7 +2322,7 @@ gst_ivas_xmultisrc_chain (GstPad * pad, GstObject * parent, GstBuffer * inbuf)
     if (G_UNLIKELY (fret != GST_FLOW_OK)) {
       GST_ERROR_OBJECT (self, "failed with reason : %s",
           gst_flow_get_name (fret));
-      goto error2;
+      goto error;
     }
   }
   if (self->priv->input) {
@@ -2244,8 +2337,6 @@ gst_ivas_xmultisrc_chain (GstPad * pad, GstObject * parent, GstBuffer * inbuf)
   return fret;
 
 error:
-  pthread_mutex_unlock (&count_mutex);
-error2:
   gst_buffer_unref (inbuf);
   return fret;
 }
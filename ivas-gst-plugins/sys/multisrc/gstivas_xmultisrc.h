@@ -25,7 +25,10 @@
 
 #include <gst/gst.h>
 #include <gst/ivas/gstivasallocator.h>
+extern "C"
+{
 #include <ivas/ivas_kernel.h>
+}
 
 G_BEGIN_DECLS
 #define GST_TYPE_IVAS_XMSRC (gst_ivas_xmultisrc_get_type())
@@ -51,6 +54,7 @@ struct _GstIvasXMSRC
 
   gchar *xclbin_path;
   gchar *config_file;
+  guint mem_bank;
 
 };
 
@@ -30,6 +30,10 @@
 #define MAX_NUM_OBJECT 512
 #define MAX_EXEC_WAIT_RETRY_CNT 10
 #define VIDEO_MAX_PLANES 4
+#define IVAS_DEFAULT_QUEUE_DEPTH 1
+#define IVAS_MAX_QUEUE_DEPTH 8
+#define IVAS_MAX_CMD_SLOTS IVAS_MAX_QUEUE_DEPTH
+#define IVAS_BUFFER_CACHE_DEFAULT_HIGH_WATER (64 * 1024 * 1024)
 
 typedef enum
 {
@@ -88,6 +92,30 @@ typedef int32_t (*IVASKernelStartFunc) (IVASKernel * handle, int32_t start,
     IVASFrame * input[MAX_NUM_OBJECT], IVASFrame * output[MAX_NUM_OBJECT]);
 typedef int32_t (*IVASKernelDoneFunc) (IVASKernel * handle);
 
+/* Optional asynchronous kernel entry points (xlnx_kernel_start_async and
+ * xlnx_kernel_wait). start_async submits a frame and returns a completion
+ * token without waiting for the kernel to finish; wait blocks until the
+ * command identified by token is complete. Tokens increase monotonically,
+ * so completing a token implies all earlier tokens are complete.
+ * Libraries exporting only xlnx_kernel_start/xlnx_kernel_done keep working
+ * with queue_depth 1 */
+typedef uint64_t IVASKernelToken;
+typedef int32_t (*IVASKernelStartAsyncFunc) (IVASKernel * handle,
+    int32_t start, IVASFrame * input[MAX_NUM_OBJECT],
+    IVASFrame * output[MAX_NUM_OBJECT], IVASKernelToken * token);
+typedef int32_t (*IVASKernelWaitFunc) (IVASKernel * handle,
+    IVASKernelToken token, int32_t timeout);
+
+/* Dynamic configuration is parsed once by the app when it changes and
+ * published in kernel_dyn_config along with a new dyn_config_gen, so
+ * kernels only need to read it again when the generation differs from the
+ * one they last saw. Libraries may also export xlnx_kernel_dyn_config,
+ * which is called with the new configuration before the next
+ * xlnx_kernel_start on that handle, to convert it to their own parameters
+ * once. A negative return keeps the frame going with the old parameters */
+typedef int32_t (*IVASKernelDynConfigFunc) (IVASKernel * handle,
+    json_t * dyn_config);
+
 struct _ivas_frame_props
 {
   uint32_t width;
@@ -155,6 +183,15 @@ typedef struct ivaspads
   kernelpads **srcpads;
 } ivaspads;
 
+/* one 32-bit register of a batch, offset is in bytes from the CU base */
+typedef struct reg_entry
+{
+  uint32_t offset;
+  uint32_t value;
+} IVASRegEntry;
+
+#define IVAS_REG(off, val) { (uint32_t) (off), (uint32_t) (val) }
+
 typedef struct buffer
 {
   unsigned int bo;
@@ -163,6 +200,21 @@ typedef struct buffer
   unsigned int size;
 } xrt_buffer;
 
+typedef enum
+{
+  IVAS_CMD_SLOT_FREE,
+  IVAS_CMD_SLOT_PROGRAMMING,    /* registers being written by host */
+  IVAS_CMD_SLOT_SUBMITTED,      /* owned by scheduler */
+} IVASCmdSlotState;
+
+typedef struct cmd_slot
+{
+  xrt_buffer *buf;
+  IVASCmdSlotState state;
+  IVASKernelToken token;
+  uint64_t submit_ts;           /* usec, for kernel statistics */
+} IVASCmdSlot;
+
 struct _ivas_kernel
 {
   void *xcl_handle;
@@ -181,6 +233,15 @@ struct _ivas_kernel
   uint32_t is_softkernel;
 #endif
   uint8_t is_multiprocess;
+  uint32_t queue_depth;         /* max commands in flight, set by app */
+  IVASKernelToken submit_token; /* token of last submitted command */
+  IVASKernelToken done_token;   /* token of last completed command */
+  IVASCmdSlot cmd_slots[IVAS_MAX_CMD_SLOTS];    /* slot 0 is ert_cmd_buf */
+  uint32_t num_cmd_slots;
+  uint32_t cur_slot;            /* slot receiving register writes */
+  uint32_t last_slot;           /* slot submitted most recently */
+  void *stats;                  /* private, see ivas_kernel_get_stats */
+  uint32_t dyn_config_gen;      /* changes whenever kernel_dyn_config does */
 };
 
 
@@ -191,8 +252,64 @@ void ivas_register_write (IVASKernel * handle, void *src, size_t size,
     size_t offset);
 void ivas_register_read (IVASKernel * handle, void *src, size_t size,
     size_t offset);
+/* writes all registers of a frame in one pass. In multiprocess mode the
+ * command payload already holds the previous frame's values, so only the
+ * registers which changed are stored. Returns number of registers written
+ * or -1 on failure */
+int32_t ivas_register_write_batch (IVASKernel * handle,
+    const IVASRegEntry * regs, uint32_t num_regs);
 int32_t ivas_kernel_start (IVASKernel * handle);
 int32_t ivas_kernel_done (IVASKernel * handle, int32_t timeout);
+int32_t ivas_kernel_start_async (IVASKernel * handle, IVASKernelToken * token);
+int32_t ivas_kernel_wait (IVASKernel * handle, IVASKernelToken token,
+    int32_t timeout);
+int32_t ivas_kernel_alloc_cmd_ring (IVASKernel * handle, uint32_t num_slots);
+void ivas_kernel_free_cmd_ring (IVASKernel * handle);
+
+/* Per kernel handle (i.e. per CU instance) execution statistics. Latencies
+ * are measured from ivas_kernel_start to completion seen by the waiter and
+ * percentiles are resolved to 25% of their value. Collected only when
+ * ivas-utils is built with kernel_stats option, otherwise
+ * ivas_kernel_get_stats returns -1 */
+typedef struct kernel_stats
+{
+  uint32_t cu_idx;
+  uint64_t submitted;
+  uint64_t completed;
+  uint64_t errors;
+  uint64_t retries;             /* exec wait timeouts which were retried */
+  uint64_t timeouts;            /* commands given up after max retries */
+  uint64_t latency_min_us;
+  uint64_t latency_max_us;
+  uint64_t latency_avg_us;
+  uint64_t latency_p50_us;
+  uint64_t latency_p99_us;
+} IVASKernelStats;
+
+int32_t ivas_kernel_get_stats (IVASKernel * handle, IVASKernelStats * stats);
+uint64_t ivas_kernel_get_latency_percentile (IVASKernel * handle,
+    double percentile);
+void ivas_kernel_reset_stats (IVASKernel * handle);
+/* logs statistics and frees them, call before freeing handle */
+void ivas_kernel_release_stats (IVASKernel * handle);
+
+/* IVAS_INTERNAL_MEMORY buffers released by ivas_free_buffer are kept mapped
+ * in a per device cache and handed out again for requests of the same size
+ * class. Contents of a reused buffer are not cleared. App must call
+ * ivas_buffer_cache_release before closing the device handle */
+typedef struct buffer_cache_stats
+{
+  uint64_t hits;
+  uint64_t misses;
+  uint32_t cached_count;
+  size_t cached_bytes;
+  size_t high_water;
+} IVASBufferCacheStats;
+
+void ivas_buffer_cache_set_high_water (IVASKernel * handle, size_t bytes);
+void ivas_buffer_cache_get_stats (IVASKernel * handle,
+    IVASBufferCacheStats * stats);
+void ivas_buffer_cache_release (void *xcl_handle);
 
 #ifdef XLNX_PCIe_PLATFORM
 
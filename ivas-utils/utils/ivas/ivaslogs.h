@@ -20,6 +20,12 @@
 
 /* Update of this file by the user is not encouraged */
 #include <stdio.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
 
 enum
 {
@@ -31,25 +37,39 @@ enum
 
 #define NOT_FOUND -1
 
+/* Longest message kept per log record, longer messages are truncated */
+#define IVAS_LOG_MSG_SIZE 256
+
+/* Optional sink for log records (e.g. GStreamer debug system). Invoked
+ * from the log flusher thread, msg is not valid after the call returns */
+typedef void (*IVASLogFunc) (int level, const char *file, const char *func,
+    int line, const char *msg, void *user_data);
+
+#if defined(__GNUC__)
+#define IVAS_LOG_PRINTF_FORMAT(f, a) __attribute__ ((format (printf, f, a)))
+#else
+#define IVAS_LOG_PRINTF_FORMAT(f, a)
+#endif
+
+/* Formats the message on the calling thread into its private ring, the
+ * actual write to stdout (or to the installed sink) is done by a
+ * background flusher thread. Set IVAS_LOG_SYNC=1 in the environment to
+ * write synchronously instead */
+void ivas_log_write (int level, const char *file, const char *func, int line,
+    const char *format, ...) IVAS_LOG_PRINTF_FORMAT (5, 6);
+/* Writes out everything queued so far from all threads */
+void ivas_log_flush (void);
+/* Routes log records to func instead of stdout, NULL restores stdout */
+void ivas_log_set_handler (IVASLogFunc func, void *user_data);
+
 #define __FILENAME__ (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
-#define LOG_MESSAGE(level, set_level, ...) {\
-  do {\
-    char *str; \
-    if (level == LOG_LEVEL_ERROR)\
-      str = (char*)"ERROR";\
-    else if (level == LOG_LEVEL_WARNING)\
-      str = (char*)"WARNING";\
-    else if (level == LOG_LEVEL_INFO)\
-      str = (char*)"INFO";\
-    else if (level == LOG_LEVEL_DEBUG)\
-      str = (char*)"DEBUG";\
-    if (level <= set_level) {\
-      printf("[%s %s:%d] %s: ",__FILENAME__, __func__, __LINE__, str);\
-      printf(__VA_ARGS__);\
-      printf("\n");\
-    }\
-  } while (0); \
-}
+
+/* Level is checked before any argument is evaluated, so disabled log
+ * statements cost a single compare */
+#define LOG_MESSAGE(level, set_level, ...) do {\
+    if ((level) <= (set_level))\
+      ivas_log_write ((level), __FILENAME__, __func__, __LINE__, __VA_ARGS__);\
+  } while (0)
 
 #if 0
 static void
@@ -65,4 +85,8 @@ LOG_DUMP (int level, char *ptr, int num)
 }
 #endif
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -16,6 +16,7 @@
 
 /* Update of this file by the user is not encouraged */
 #include <ivas/ivas_kernel.h>
+#include <ivas/ivaslogs.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -30,39 +31,244 @@
 #endif
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/mman.h>
 
 #undef DUMP_REG                 // dump reg_map just before sending ert cmd
+#define CMD_BUF_WAIT_TIMEOUT 1000       // 1 sec
+#define BUFFER_CACHE_MIN_SIZE 4096
 
-enum
+static int log_level = LOG_LEVEL_WARNING;
+
+typedef struct _cached_bo CachedBO;
+typedef struct _buffer_cache BufferCache;
+
+struct _cached_bo
 {
-  LOG_LEVEL_ERROR,
-  LOG_LEVEL_WARNING,
-  LOG_LEVEL_INFO,
-  LOG_LEVEL_DEBUG
+  unsigned int bo;
+  void *vaddr;
+  uint64_t paddr;
+  size_t size;                  /* size class, BO is allocated with it */
+  CachedBO *next;
 };
 
-static int log_level = LOG_LEVEL_WARNING;
+struct _buffer_cache
+{
+  xclDeviceHandle handle;
+  CachedBO *free_list;          /* most recently freed first */
+  IVASBufferCacheStats stats;
+  BufferCache *next;
+};
+
+static BufferCache *buffer_caches = NULL;
+static pthread_mutex_t buffer_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* size classes are 4 steps per power of two, so at most 25% is wasted */
+static size_t
+buffer_cache_class_size (size_t size)
+{
+  size_t pow = BUFFER_CACHE_MIN_SIZE;
+  size_t step;
+
+  if (size <= pow)
+    return pow;
+
+  while ((pow << 1) < size)
+    pow <<= 1;
+  step = pow >> 2;
+
+  return (size + step - 1) / step * step;
+}
+
+/* must be called with buffer_cache_lock held */
+static BufferCache *
+buffer_cache_lookup (xclDeviceHandle handle, bool create)
+{
+  BufferCache *cache;
+
+  for (cache = buffer_caches; cache; cache = cache->next) {
+    if (cache->handle == handle)
+      return cache;
+  }
+
+  if (!create)
+    return NULL;
+
+  cache = (BufferCache *) calloc (1, sizeof (BufferCache));
+  if (!cache) {
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "failed to allocate buffer cache");
+    return NULL;
+  }
+  cache->handle = handle;
+  cache->stats.high_water = IVAS_BUFFER_CACHE_DEFAULT_HIGH_WATER;
+  cache->next = buffer_caches;
+  buffer_caches = cache;
+
+  return cache;
+}
+
+static void
+buffer_cache_free_bo (xclDeviceHandle handle, CachedBO * cbo)
+{
+  munmap (cbo->vaddr, cbo->size);
+  xclFreeBO (handle, cbo->bo);
+  free (cbo);
+}
+
+/* frees least recently cached BOs until cached_bytes <= limit.
+ * must be called with buffer_cache_lock held */
+static void
+buffer_cache_trim (BufferCache * cache, size_t limit)
+{
+  CachedBO **link;
+  CachedBO *cbo;
+
+  while (cache->stats.cached_bytes > limit && cache->free_list) {
+    link = &cache->free_list;
+    while ((*link)->next)
+      link = &(*link)->next;
+
+    cbo = *link;
+    *link = NULL;
+    cache->stats.cached_bytes -= cbo->size;
+    cache->stats.cached_count--;
+    buffer_cache_free_bo (cache->handle, cbo);
+  }
+}
+
+static bool
+buffer_cache_get (xclDeviceHandle handle, IVASFrame * frame)
+{
+  size_t class_size = buffer_cache_class_size (frame->size[0]);
+  BufferCache *cache;
+  CachedBO **link;
+  CachedBO *cbo = NULL;
+
+  pthread_mutex_lock (&buffer_cache_lock);
+  cache = buffer_cache_lookup (handle, true);
+  if (cache) {
+    for (link = &cache->free_list; *link; link = &(*link)->next) {
+      if ((*link)->size == class_size) {
+        cbo = *link;
+        *link = cbo->next;
+        cache->stats.cached_bytes -= cbo->size;
+        cache->stats.cached_count--;
+        break;
+      }
+    }
+
+    if (cbo)
+      cache->stats.hits++;
+    else
+      cache->stats.misses++;
+  }
+  pthread_mutex_unlock (&buffer_cache_lock);
 
-#define LOG_MESSAGE(level, ...) {\
-  do {\
-    char *str; \
-    if (level == LOG_LEVEL_ERROR)\
-      str = (char*)"ERROR";\
-    else if (level == LOG_LEVEL_WARNING)\
-      str = (char*)"WARNING";\
-    else if (level == LOG_LEVEL_INFO)\
-      str = (char*)"INFO";\
-    else if (level == LOG_LEVEL_DEBUG)\
-      str = (char*)"DEBUG";\
-    if (level <= log_level) {\
-      printf("[%s:%d] %s: ", __func__, __LINE__, str);\
-      printf(__VA_ARGS__);\
-      printf("\n");\
-    }\
-  } while (0); \
+  if (!cbo)
+    return false;
+
+  frame->bo[0] = cbo->bo;
+  frame->vaddr[0] = cbo->vaddr;
+  frame->paddr[0] = cbo->paddr;
+  frame->meta_data = NULL;
+  frame->app_priv = NULL;
+  frame->n_planes = 1;
+  free (cbo);
+
+  LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+      "reused cached xrt buffer : bo = %d, size = %d",
+      frame->bo[0], frame->size[0]);
+
+  return true;
+}
+
+static bool
+buffer_cache_put (xclDeviceHandle handle, IVASFrame * frame)
+{
+  BufferCache *cache;
+  CachedBO *cbo;
+
+  cbo = (CachedBO *) calloc (1, sizeof (CachedBO));
+  if (!cbo)
+    return false;
+
+  cbo->bo = frame->bo[0];
+  cbo->vaddr = frame->vaddr[0];
+  cbo->paddr = frame->paddr[0];
+  cbo->size = buffer_cache_class_size (frame->size[0]);
+
+  pthread_mutex_lock (&buffer_cache_lock);
+  cache = buffer_cache_lookup (handle, true);
+  if (!cache || cbo->size > cache->stats.high_water) {
+    pthread_mutex_unlock (&buffer_cache_lock);
+    free (cbo);
+    return false;
+  }
+
+  cbo->next = cache->free_list;
+  cache->free_list = cbo;
+  cache->stats.cached_bytes += cbo->size;
+  cache->stats.cached_count++;
+  buffer_cache_trim (cache, cache->stats.high_water);
+  pthread_mutex_unlock (&buffer_cache_lock);
+
+  return true;
 }
 
+void
+ivas_buffer_cache_set_high_water (IVASKernel * handle, size_t bytes)
+{
+  BufferCache *cache;
+
+  pthread_mutex_lock (&buffer_cache_lock);
+  cache = buffer_cache_lookup (handle->xcl_handle, true);
+  if (cache) {
+    cache->stats.high_water = bytes;
+    buffer_cache_trim (cache, bytes);
+  }
+  pthread_mutex_unlock (&buffer_cache_lock);
+}
+
+void
+ivas_buffer_cache_get_stats (IVASKernel * handle, IVASBufferCacheStats * stats)
+{
+  BufferCache *cache;
+
+  memset (stats, 0x0, sizeof (IVASBufferCacheStats));
+
+  pthread_mutex_lock (&buffer_cache_lock);
+  cache = buffer_cache_lookup (handle->xcl_handle, false);
+  if (cache)
+    memcpy (stats, &cache->stats, sizeof (IVASBufferCacheStats));
+  pthread_mutex_unlock (&buffer_cache_lock);
+}
+
+void
+ivas_buffer_cache_release (void *xcl_handle)
+{
+  BufferCache **link;
+  BufferCache *cache = NULL;
+
+  pthread_mutex_lock (&buffer_cache_lock);
+  for (link = &buffer_caches; *link; link = &(*link)->next) {
+    if ((*link)->handle == xcl_handle) {
+      cache = *link;
+      *link = cache->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock (&buffer_cache_lock);
+
+  if (!cache)
+    return;
+
+  LOG_MESSAGE (LOG_LEVEL_INFO, log_level, "buffer cache hits %lu, misses %lu",
+      (unsigned long) cache->stats.hits, (unsigned long) cache->stats.misses);
+
+  buffer_cache_trim (cache, 0);
+  free (cache);
+}
 
 static int
 alloc_xrt_buffer (xclDeviceHandle handle, IVASFrame * frame,
@@ -70,13 +276,13 @@ alloc_xrt_buffer (xclDeviceHandle handle, IVASFrame * frame,
 {
   frame->bo[0] = xclAllocBO (handle, frame->size[0], bo_kind, flags);
   if (frame->bo[0] == NULLBO) {
-    LOG_MESSAGE (LOG_LEVEL_ERROR, "failed to allocate Device BO...");
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "failed to allocate Device BO...");
     return -1;
   }
 
   frame->vaddr[0] = xclMapBO (handle, frame->bo[0], true);
   if (frame->vaddr[0] == NULL) {
-    LOG_MESSAGE (LOG_LEVEL_ERROR, "failed to map BO...");
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "failed to map BO...");
     xclFreeBO (handle, frame->bo[0]);
     return -1;
   }
@@ -84,7 +290,8 @@ alloc_xrt_buffer (xclDeviceHandle handle, IVASFrame * frame,
   if (bo_kind != XCL_BO_SHARED_VIRTUAL) {
     struct xclBOProperties p;
     if (xclGetBOProperties (handle, frame->bo[0], &p)) {
-      LOG_MESSAGE (LOG_LEVEL_ERROR, "failed to get physical address...");
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+          "failed to get physical address...");
       munmap (frame->vaddr[0], frame->size[0]);
       xclFreeBO (handle, frame->bo[0]);
       return -1;
@@ -96,7 +303,7 @@ alloc_xrt_buffer (xclDeviceHandle handle, IVASFrame * frame,
   frame->app_priv = NULL;
   frame->n_planes = 1;
 
-  LOG_MESSAGE (LOG_LEVEL_DEBUG,
+  LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
       "allocated xrt buffer : bo = %d, paddr = %p, vaddr = %p and size = %d",
       frame->bo[0], (void *) frame->paddr[0], frame->vaddr[0], frame->size[0]);
 
@@ -107,7 +314,8 @@ static void
 free_xrt_buffer (xclDeviceHandle handle, IVASFrame * frame)
 {
   if (!handle || !frame) {
-    LOG_MESSAGE (LOG_LEVEL_ERROR, "invalid arguments : handle %p, frame %p",
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+        "invalid arguments : handle %p, frame %p",
         handle, frame);
     return;
   }
@@ -126,13 +334,14 @@ ivas_alloc_buffer (IVASKernel * handle, uint32_t size, IVASMemoryType mem_type,
   int iret = -1;
 
   if (!handle) {
-    LOG_MESSAGE (LOG_LEVEL_ERROR, "invalid arguments : handle %p", handle);
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+        "invalid arguments : handle %p", handle);
     goto error;
   }
 
   frame = (IVASFrame *) calloc (1, sizeof (IVASFrame));
   if (!frame) {
-    LOG_MESSAGE (LOG_LEVEL_ERROR, "failed to allocate ivas_frame");
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "failed to allocate ivas_frame");
     goto error;
   }
   frame->mem_type = mem_type;
@@ -140,28 +349,39 @@ ivas_alloc_buffer (IVASKernel * handle, uint32_t size, IVASMemoryType mem_type,
   if (mem_type == IVAS_INTERNAL_MEMORY) {
     frame->size[0] = size;
 
+    if (buffer_cache_get (handle->xcl_handle, frame))
+      return frame;
+
+    /* BO is allocated with size of its class, so that it can be cached */
+    frame->size[0] = buffer_cache_class_size (size);
     iret = alloc_xrt_buffer (handle->xcl_handle, frame, XCL_BO_DEVICE_RAM, 0);
+    frame->size[0] = size;
     if (iret < 0) {
-      LOG_MESSAGE (LOG_LEVEL_ERROR, "failed to allocate internal memory");
-      goto error;
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+          "failed to allocate internal memory");
+      /* nothing to release, BO is already freed on failure */
+      free (frame);
+      return NULL;
     }
   } else {
     if (!props || !props->width || !props->height
         || (props->fmt == IVAS_VMFT_UNKNOWN)) {
-      LOG_MESSAGE (LOG_LEVEL_ERROR, "invalid arguments for properties");
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+          "invalid arguments for properties");
       goto error;
     }
 
     memcpy (&(frame->props), props, sizeof (IVASFrameProps));
     if (!handle->alloc_func) {
-      LOG_MESSAGE (LOG_LEVEL_ERROR,
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
           "app did not set alloc_func callback function");
       goto error;
     }
 
     iret = handle->alloc_func (handle, frame, handle->cb_user_data);
     if (iret < 0) {
-      LOG_MESSAGE (LOG_LEVEL_ERROR, "failed to allocate frame memory");
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+          "failed to allocate frame memory");
       goto error;
     }
   }
@@ -179,10 +399,16 @@ void
 ivas_free_buffer (IVASKernel * handle, IVASFrame * ivas_frame)
 {
   if (ivas_frame->mem_type == IVAS_INTERNAL_MEMORY) {
-    free_xrt_buffer (handle, ivas_frame);
+    if (ivas_frame->bo[0] > 0
+        && buffer_cache_put (handle->xcl_handle, ivas_frame)) {
+      free (ivas_frame);
+      return;
+    }
+    ivas_frame->size[0] = buffer_cache_class_size (ivas_frame->size[0]);
+    free_xrt_buffer (handle->xcl_handle, ivas_frame);
   } else {
     if (!handle->free_func) {
-      LOG_MESSAGE (LOG_LEVEL_ERROR,
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
           "app did not set free_func callback function");
     } else {
       handle->free_func (handle, ivas_frame, handle->cb_user_data);
@@ -191,12 +417,459 @@ ivas_free_buffer (IVASKernel * handle, IVASFrame * ivas_frame)
   free (ivas_frame);
 }
 
+/***************** ivas kernel statistics ********************/
+#ifdef ENABLE_IVAS_KERNEL_STATS
+/* latency histogram : values below 8 usec get a bucket each, above that
+ * every power of two is split in 4 buckets */
+#define STATS_LINEAR_BUCKETS 8
+#define STATS_NUM_BUCKETS (STATS_LINEAR_BUCKETS + 29 * 4)
+
+typedef struct
+{
+  uint64_t submitted;
+  uint64_t completed;
+  uint64_t errors;
+  uint64_t retries;
+  uint64_t timeouts;
+  uint64_t latency_sum_us;
+  uint64_t latency_min_us;
+  uint64_t latency_max_us;
+  uint64_t buckets[STATS_NUM_BUCKETS];
+} KernelStats;
+
+#define STATS_ADD(var, val) __atomic_fetch_add (&(var), (val), __ATOMIC_RELAXED)
+#define STATS_LOAD(var) __atomic_load_n (&(var), __ATOMIC_RELAXED)
+#define STATS_STORE(var, val) __atomic_store_n (&(var), (val), __ATOMIC_RELAXED)
+
+static uint64_t
+stats_now_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t
+stats_bucket_index (uint64_t us)
+{
+  uint32_t msb;
+  uint32_t idx;
+
+  if (us < STATS_LINEAR_BUCKETS)
+    return us;
+
+  msb = 63 - __builtin_clzll (us);
+  idx = STATS_LINEAR_BUCKETS + (msb - 3) * 4 + ((us >> (msb - 2)) & 3);
+
+  return idx < STATS_NUM_BUCKETS ? idx : STATS_NUM_BUCKETS - 1;
+}
+
+static uint64_t
+stats_bucket_upper (uint32_t idx)
+{
+  uint32_t msb;
+  uint32_t sub;
+
+  if (idx < STATS_LINEAR_BUCKETS)
+    return idx;
+
+  msb = (idx - STATS_LINEAR_BUCKETS) / 4 + 3;
+  sub = (idx - STATS_LINEAR_BUCKETS) % 4;
+
+  return ((uint64_t) (5 + sub) << (msb - 2)) - 1;
+}
+
+static KernelStats *
+stats_get (IVASKernel * handle)
+{
+  KernelStats *stats = (KernelStats *) __atomic_load_n (&handle->stats,
+      __ATOMIC_ACQUIRE);
+  void *expected = NULL;
+
+  if (stats)
+    return stats;
+
+  stats = (KernelStats *) calloc (1, sizeof (KernelStats));
+  if (!stats)
+    return NULL;
+  stats->latency_min_us = UINT64_MAX;
+
+  if (!__atomic_compare_exchange_n (&handle->stats, &expected, stats, false,
+          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    free (stats);
+    stats = (KernelStats *) expected;
+  }
+  return stats;
+}
+
+#define STATS_INC(handle, field) do { \
+    KernelStats *_stats = stats_get (handle); \
+    if (_stats) \
+      STATS_ADD (_stats->field, 1); \
+  } while (0)
+
+static void
+stats_record_latency (IVASKernel * handle, uint64_t submit_ts)
+{
+  KernelStats *stats = stats_get (handle);
+  uint64_t lat;
+  uint64_t cur;
+
+  if (!stats)
+    return;
+
+  STATS_ADD (stats->completed, 1);
+  if (!submit_ts)
+    return;
+
+  lat = stats_now_us () - submit_ts;
+  STATS_ADD (stats->latency_sum_us, lat);
+  STATS_ADD (stats->buckets[stats_bucket_index (lat)], 1);
+
+  cur = STATS_LOAD (stats->latency_min_us);
+  while (lat < cur && !__atomic_compare_exchange_n (&stats->latency_min_us,
+          &cur, lat, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  cur = STATS_LOAD (stats->latency_max_us);
+  while (lat > cur && !__atomic_compare_exchange_n (&stats->latency_max_us,
+          &cur, lat, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static uint64_t
+stats_percentile (KernelStats * stats, double percentile)
+{
+  uint64_t total = 0;
+  uint64_t target;
+  uint64_t seen = 0;
+  uint32_t i;
+
+  for (i = 0; i < STATS_NUM_BUCKETS; i++)
+    total += STATS_LOAD (stats->buckets[i]);
+
+  if (!total)
+    return 0;
+
+  target = (uint64_t) (total * percentile / 100.0);
+  if (target < 1)
+    target = 1;
+
+  for (i = 0; i < STATS_NUM_BUCKETS; i++) {
+    seen += STATS_LOAD (stats->buckets[i]);
+    if (seen >= target)
+      break;
+  }
+
+  if (i == STATS_NUM_BUCKETS || stats_bucket_upper (i) > stats->latency_max_us)
+    return STATS_LOAD (stats->latency_max_us);
+  return stats_bucket_upper (i);
+}
+#else
+#define STATS_INC(handle, field) do { } while (0)
+#define stats_now_us() 0
+#define stats_record_latency(handle, submit_ts) do { } while (0)
+#endif /* ENABLE_IVAS_KERNEL_STATS */
+
+int32_t
+ivas_kernel_get_stats (IVASKernel * handle, IVASKernelStats * stats)
+{
+#ifdef ENABLE_IVAS_KERNEL_STATS
+  KernelStats *kstats;
+  uint64_t lat_count = 0;
+  uint32_t i;
+
+  if (!handle || !stats)
+    return -1;
+
+  memset (stats, 0x0, sizeof (IVASKernelStats));
+  stats->cu_idx = handle->cu_idx;
+
+  kstats = (KernelStats *) __atomic_load_n (&handle->stats, __ATOMIC_ACQUIRE);
+  if (!kstats)
+    return 0;
+
+  for (i = 0; i < STATS_NUM_BUCKETS; i++)
+    lat_count += STATS_LOAD (kstats->buckets[i]);
+
+  stats->submitted = STATS_LOAD (kstats->submitted);
+  stats->completed = STATS_LOAD (kstats->completed);
+  stats->errors = STATS_LOAD (kstats->errors);
+  stats->retries = STATS_LOAD (kstats->retries);
+  stats->timeouts = STATS_LOAD (kstats->timeouts);
+  if (lat_count) {
+    stats->latency_min_us = STATS_LOAD (kstats->latency_min_us);
+    stats->latency_max_us = STATS_LOAD (kstats->latency_max_us);
+    stats->latency_avg_us = STATS_LOAD (kstats->latency_sum_us) / lat_count;
+    stats->latency_p50_us = stats_percentile (kstats, 50.0);
+    stats->latency_p99_us = stats_percentile (kstats, 99.0);
+  }
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+uint64_t
+ivas_kernel_get_latency_percentile (IVASKernel * handle, double percentile)
+{
+#ifdef ENABLE_IVAS_KERNEL_STATS
+  KernelStats *kstats;
+
+  if (!handle || percentile < 0.0 || percentile > 100.0)
+    return 0;
+
+  kstats = (KernelStats *) __atomic_load_n (&handle->stats, __ATOMIC_ACQUIRE);
+  return kstats ? stats_percentile (kstats, percentile) : 0;
+#else
+  return 0;
+#endif
+}
+
+void
+ivas_kernel_reset_stats (IVASKernel * handle)
+{
+#ifdef ENABLE_IVAS_KERNEL_STATS
+  KernelStats *kstats;
+
+  if (!handle)
+    return;
+
+  kstats = (KernelStats *) __atomic_load_n (&handle->stats, __ATOMIC_ACQUIRE);
+  if (kstats) {
+    uint32_t i;
+
+    /* commands may complete meanwhile, so counter by counter like updates */
+    STATS_STORE (kstats->submitted, 0);
+    STATS_STORE (kstats->completed, 0);
+    STATS_STORE (kstats->errors, 0);
+    STATS_STORE (kstats->retries, 0);
+    STATS_STORE (kstats->timeouts, 0);
+    STATS_STORE (kstats->latency_sum_us, 0);
+    STATS_STORE (kstats->latency_min_us, UINT64_MAX);
+    STATS_STORE (kstats->latency_max_us, 0);
+    for (i = 0; i < STATS_NUM_BUCKETS; i++)
+      STATS_STORE (kstats->buckets[i], 0);
+  }
+#endif
+}
+
+void
+ivas_kernel_release_stats (IVASKernel * handle)
+{
+#ifdef ENABLE_IVAS_KERNEL_STATS
+  IVASKernelStats stats;
+
+  if (!handle || !handle->stats)
+    return;
+
+  if (!ivas_kernel_get_stats (handle, &stats)) {
+    LOG_MESSAGE (LOG_LEVEL_INFO, log_level,
+        "cu %u : submitted %lu, completed %lu, "
+        "errors %lu, retries %lu, timeouts %lu, latency usec min %lu, "
+        "avg %lu, p50 %lu, p99 %lu, max %lu", stats.cu_idx,
+        (unsigned long) stats.submitted, (unsigned long) stats.completed,
+        (unsigned long) stats.errors, (unsigned long) stats.retries,
+        (unsigned long) stats.timeouts, (unsigned long) stats.latency_min_us,
+        (unsigned long) stats.latency_avg_us,
+        (unsigned long) stats.latency_p50_us,
+        (unsigned long) stats.latency_p99_us,
+        (unsigned long) stats.latency_max_us);
+  }
+
+  free (handle->stats);
+  handle->stats = NULL;
+#endif
+}
+
+/* without ivas_kernel_alloc_cmd_ring() the app provided ert_cmd_buf is
+ * used as a ring of one slot */
+static void
+ivas_kernel_init_cmd_slots (IVASKernel * handle)
+{
+  if (handle->num_cmd_slots)
+    return;
+
+  memset (handle->cmd_slots, 0x0, sizeof (handle->cmd_slots));
+  handle->cmd_slots[0].buf = handle->ert_cmd_buf;
+  handle->num_cmd_slots = 1;
+  handle->cur_slot = 0;
+  handle->last_slot = 0;
+}
+
+static int32_t
+ivas_kernel_wait_cmd_buf (IVASKernel * handle, xrt_buffer * cmd_buf,
+    int32_t timeout)
+{
+  struct ert_start_kernel_cmd *ert_cmd =
+      (struct ert_start_kernel_cmd *) (cmd_buf->user_ptr);
+  int ret;
+  int retry_count = MAX_EXEC_WAIT_RETRY_CNT;
+
+  while (ert_cmd->state != ERT_CMD_STATE_COMPLETED) {
+    if (ert_cmd->state == ERT_CMD_STATE_ERROR
+        || ert_cmd->state == ERT_CMD_STATE_ABORT) {
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+          "kernel command failed with state %d",
+          ert_cmd->state);
+      STATS_INC (handle, errors);
+      return -1;
+    }
+
+    ret = xclExecWait (handle->xcl_handle, timeout);
+    if (ret < 0) {
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+          "ExecWait ret = %d. reason : %s", ret,
+          strerror (errno));
+      STATS_INC (handle, errors);
+      return -1;
+    } else if (!ret) {
+      LOG_MESSAGE (LOG_LEVEL_WARNING, log_level, "timeout...retry execwait");
+      if (retry_count-- <= 0) {
+        LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+            "max retry count %d reached..returning error",
+            MAX_EXEC_WAIT_RETRY_CNT);
+        STATS_INC (handle, timeouts);
+        return -1;
+      }
+      STATS_INC (handle, retries);
+    }
+  }
+
+  return 0;
+}
+
+/* returns the slot receiving register writes for the next command. When a
+ * slot is recycled, payload of the previously submitted command is carried
+ * over, as kernel libraries may only rewrite registers that changed */
+static IVASCmdSlot *
+ivas_kernel_get_cmd_slot (IVASKernel * handle)
+{
+  IVASCmdSlot *slot = NULL;
+  IVASCmdSlot *prev = NULL;
+  size_t len;
+
+  ivas_kernel_init_cmd_slots (handle);
+
+  slot = &handle->cmd_slots[handle->cur_slot];
+  if (slot->state == IVAS_CMD_SLOT_PROGRAMMING)
+    return slot;
+
+  if (slot->state == IVAS_CMD_SLOT_SUBMITTED) {
+    LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level, "slot %u still in flight, waiting",
+        handle->cur_slot);
+    if (ivas_kernel_wait (handle, slot->token, CMD_BUF_WAIT_TIMEOUT) < 0)
+      return NULL;
+  }
+
+  prev = &handle->cmd_slots[handle->last_slot];
+  if (prev != slot) {
+    len = sizeof (struct ert_start_kernel_cmd) + handle->max_offset +
+        sizeof (uint32_t);
+    if (len > slot->buf->size)
+      len = slot->buf->size;
+    memcpy (slot->buf->user_ptr, prev->buf->user_ptr, len);
+  }
+
+  slot->state = IVAS_CMD_SLOT_PROGRAMMING;
+  return slot;
+}
+
+int32_t
+ivas_kernel_alloc_cmd_ring (IVASKernel * handle, uint32_t num_slots)
+{
+  xrt_buffer *buf = NULL;
+  uint32_t i;
+
+  if (!handle || !handle->ert_cmd_buf || !handle->ert_cmd_buf->size
+      || !num_slots || num_slots > IVAS_MAX_CMD_SLOTS) {
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+        "invalid arguments : handle %p, slots %u",
+        handle, num_slots);
+    return -1;
+  }
+
+  if (handle->num_cmd_slots > 1) {
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "command ring already allocated");
+    return -1;
+  }
+
+  ivas_kernel_init_cmd_slots (handle);
+
+  /* slot 0 is ert_cmd_buf owned by app */
+  for (i = 1; i < num_slots; i++) {
+    buf = (xrt_buffer *) calloc (1, sizeof (xrt_buffer));
+    if (!buf) {
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+          "failed to allocate command slot");
+      goto error;
+    }
+    handle->cmd_slots[i].buf = buf;
+
+    buf->size = handle->ert_cmd_buf->size;
+    buf->bo = xclAllocBO (handle->xcl_handle, buf->size,
+        XCL_BO_SHARED_VIRTUAL, XCL_BO_FLAGS_EXECBUF);
+    if (buf->bo == NULLBO) {
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "failed to allocate command BO");
+      goto error;
+    }
+
+    buf->user_ptr = xclMapBO (handle->xcl_handle, buf->bo, true);
+    if (buf->user_ptr == NULL) {
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "failed to map command BO");
+      goto error;
+    }
+    memset (buf->user_ptr, 0x0, buf->size);
+    handle->num_cmd_slots++;
+  }
+
+  LOG_MESSAGE (LOG_LEVEL_INFO, log_level,
+      "allocated command ring with %u slots",
+      handle->num_cmd_slots);
+  return 0;
+
+error:
+  ivas_kernel_free_cmd_ring (handle);
+  return -1;
+}
+
+void
+ivas_kernel_free_cmd_ring (IVASKernel * handle)
+{
+  xrt_buffer *buf = NULL;
+  uint32_t i;
+
+  if (!handle || !handle->num_cmd_slots)
+    return;
+
+  if (ivas_kernel_wait (handle, handle->submit_token, CMD_BUF_WAIT_TIMEOUT) < 0)
+    LOG_MESSAGE (LOG_LEVEL_WARNING, log_level,
+        "freeing command ring with commands "
+        "in flight");
+
+  for (i = 1; i < IVAS_MAX_CMD_SLOTS; i++) {
+    buf = handle->cmd_slots[i].buf;
+    if (!buf)
+      continue;
+
+    if (buf->user_ptr)
+      munmap (buf->user_ptr, buf->size);
+    if (buf->bo != NULLBO && buf->bo > 0)
+      xclFreeBO (handle->xcl_handle, buf->bo);
+    free (buf);
+  }
+
+  memset (handle->cmd_slots, 0x0, sizeof (handle->cmd_slots));
+  handle->num_cmd_slots = 0;
+  handle->cur_slot = 0;
+  handle->last_slot = 0;
+}
+
 void
 ivas_register_write (IVASKernel * handle, void *src, size_t size, size_t offset)
 {
   if (handle->is_multiprocess) {
-    struct ert_start_kernel_cmd *ert_cmd =
-        (struct ert_start_kernel_cmd *) (handle->ert_cmd_buf->user_ptr);
+    IVASCmdSlot *slot = ivas_kernel_get_cmd_slot (handle);
+    struct ert_start_kernel_cmd *ert_cmd = NULL;
     uint32_t *src_array = (uint32_t *) src;
     size_t cur_min = offset;
     size_t cur_max = offset + size;
@@ -204,6 +877,12 @@ ivas_register_write (IVASKernel * handle, void *src, size_t size, size_t offset)
     int32_t start = offset / sizeof (uint32_t);
     int32_t i;
 
+    if (!slot) {
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "no free command slot");
+      return;
+    }
+    ert_cmd = (struct ert_start_kernel_cmd *) (slot->buf->user_ptr);
+
     for (i = 0; i < entries; i++)
       ert_cmd->data[start + i] = src_array[i];
 
@@ -220,6 +899,77 @@ ivas_register_write (IVASKernel * handle, void *src, size_t size, size_t offset)
   return;
 }
 
+int32_t
+ivas_register_write_batch (IVASKernel * handle, const IVASRegEntry * regs,
+    uint32_t num_regs)
+{
+  IVASCmdSlot *slot = NULL;
+  struct ert_start_kernel_cmd *ert_cmd = NULL;
+  size_t max_data;
+  size_t cur_min = (size_t) -1;
+  size_t cur_max = 0;
+  int32_t written = 0;
+  uint32_t idx;
+  uint32_t i;
+
+  if (!handle || (!regs && num_regs)) {
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+        "invalid arguments : handle %p, regs %p",
+        handle, regs);
+    return -1;
+  }
+
+  if (!handle->is_multiprocess) {
+    for (i = 0; i < num_regs; i++)
+      xclRegWrite ((xclDeviceHandle) handle->xcl_handle, handle->cu_idx,
+          regs[i].offset, regs[i].value);
+    return num_regs;
+  }
+
+  slot = ivas_kernel_get_cmd_slot (handle);
+  if (!slot) {
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "no free command slot");
+    return -1;
+  }
+  ert_cmd = (struct ert_start_kernel_cmd *) (slot->buf->user_ptr);
+  max_data = slot->buf->size - sizeof (struct ert_start_kernel_cmd);
+
+  for (i = 0; i < num_regs; i++) {
+    if (regs[i].offset + sizeof (uint32_t) > max_data) {
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+          "register offset 0x%x out of payload",
+          regs[i].offset);
+      return -1;
+    }
+
+    if (regs[i].offset < cur_min)
+      cur_min = regs[i].offset;
+    if (regs[i].offset + sizeof (uint32_t) > cur_max)
+      cur_max = regs[i].offset + sizeof (uint32_t);
+
+    idx = regs[i].offset / sizeof (uint32_t);
+    if (ert_cmd->data[idx] == regs[i].value)
+      continue;
+
+    ert_cmd->data[idx] = regs[i].value;
+    written++;
+  }
+
+  if (num_regs) {
+    if (cur_max > handle->max_offset)
+      handle->max_offset = cur_max;
+
+    if (cur_min < handle->min_offset)
+      handle->min_offset = cur_min;
+  }
+
+  LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+      "%d of %u registers changed", written,
+      num_regs);
+
+  return written;
+}
+
 void
 ivas_register_read (IVASKernel * handle, void *src, size_t size, size_t offset)
 {
@@ -231,8 +981,14 @@ ivas_register_read (IVASKernel * handle, void *src, size_t size, size_t offset)
 int32_t
 ivas_kernel_start (IVASKernel * handle)
 {
-  struct ert_start_kernel_cmd *ert_cmd =
-      (struct ert_start_kernel_cmd *) (handle->ert_cmd_buf->user_ptr);
+  IVASCmdSlot *slot = ivas_kernel_get_cmd_slot (handle);
+  struct ert_start_kernel_cmd *ert_cmd = NULL;
+
+  if (!slot) {
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "no free command slot");
+    return -1;
+  }
+  ert_cmd = (struct ert_start_kernel_cmd *) (slot->buf->user_ptr);
 
   ert_cmd->state = ERT_CMD_STATE_NEW;
 
@@ -252,11 +1008,19 @@ ivas_kernel_start (IVASKernel * handle)
   }
 #endif
 
-  if (xclExecBuf (handle->xcl_handle, handle->ert_cmd_buf->bo)) {
-    LOG_MESSAGE (LOG_LEVEL_ERROR, "failed to issue XRT command");
+  if (xclExecBuf (handle->xcl_handle, slot->buf->bo)) {
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "failed to issue XRT command");
     return -1;
   }
-  LOG_MESSAGE (LOG_LEVEL_DEBUG, "Submitted command to kernel");
+  slot->token = ++handle->submit_token;
+  slot->state = IVAS_CMD_SLOT_SUBMITTED;
+  slot->submit_ts = stats_now_us ();
+  STATS_INC (handle, submitted);
+  handle->last_slot = handle->cur_slot;
+  handle->cur_slot = (handle->cur_slot + 1) % handle->num_cmd_slots;
+
+  LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level, "Submitted command %lu to kernel",
+      (unsigned long) slot->token);
 
   return 0;
 }
@@ -264,31 +1028,72 @@ ivas_kernel_start (IVASKernel * handle)
 int32_t
 ivas_kernel_done (IVASKernel * handle, int32_t timeout)
 {
-  struct ert_start_kernel_cmd *ert_cmd =
-      (struct ert_start_kernel_cmd *) (handle->ert_cmd_buf->user_ptr);
-  int ret;
-  int retry_count = MAX_EXEC_WAIT_RETRY_CNT;
-
-  LOG_MESSAGE (LOG_LEVEL_DEBUG, "Going to wait for kernel command to finish");
+  LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+      "Going to wait for kernel command to finish");
 
-  do {
-    ret = xclExecWait (handle->xcl_handle, timeout);
-    if (ret < 0) {
-      LOG_MESSAGE (LOG_LEVEL_ERROR, "ExecWait ret = %d. reason : %s", ret,
-          strerror (errno));
+  /* nothing submitted through ivas_kernel_start, wait on ert_cmd_buf */
+  if (handle->submit_token == handle->done_token) {
+    if (ivas_kernel_wait_cmd_buf (handle, handle->ert_cmd_buf, timeout) < 0)
       return -1;
-    } else if (!ret) {
-      LOG_MESSAGE (LOG_LEVEL_WARNING, "timeout...retry execwait");
-      if (retry_count-- <= 0) {
-        LOG_MESSAGE (LOG_LEVEL_ERROR,
-            "max retry count %d reached..returning error",
-            MAX_EXEC_WAIT_RETRY_CNT);
+    stats_record_latency (handle, 0);
+  } else if (ivas_kernel_wait (handle, handle->submit_token, timeout) < 0) {
+    return -1;
+  }
+
+  LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+      "successfully completed kernel command");
+
+  return 0;
+}
+
+int32_t
+ivas_kernel_start_async (IVASKernel * handle, IVASKernelToken * token)
+{
+  if (ivas_kernel_start (handle) < 0)
+    return -1;
+
+  if (token)
+    *token = handle->submit_token;
+
+  return 0;
+}
+
+int32_t
+ivas_kernel_wait (IVASKernel * handle, IVASKernelToken token, int32_t timeout)
+{
+  IVASKernelToken cur;
+  IVASCmdSlot *slot = NULL;
+  uint32_t i;
+
+  if (token <= handle->done_token)
+    return 0;
+
+  if (token > handle->submit_token) {
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+        "invalid token %lu, last submitted %lu",
+        (unsigned long) token, (unsigned long) handle->submit_token);
+    return -1;
+  }
+
+  /* retire commands in submission order, so that done_token also covers
+   * every command submitted before it */
+  for (cur = handle->done_token + 1; cur <= token; cur++) {
+    for (i = 0; i < handle->num_cmd_slots; i++) {
+      slot = &handle->cmd_slots[i];
+      if (slot->state != IVAS_CMD_SLOT_SUBMITTED || slot->token != cur)
+        continue;
+
+      if (ivas_kernel_wait_cmd_buf (handle, slot->buf, timeout) < 0) {
+        LOG_MESSAGE (LOG_LEVEL_ERROR, log_level, "command %lu did not complete",
+            (unsigned long) cur);
         return -1;
       }
+      slot->state = IVAS_CMD_SLOT_FREE;
+      stats_record_latency (handle, slot->submit_ts);
+      break;
     }
-  } while (ert_cmd->state != ERT_CMD_STATE_COMPLETED);
-
-  LOG_MESSAGE (LOG_LEVEL_DEBUG, "successfully completed kernel command");
+    handle->done_token = cur;
+  }
 
   return 0;
 }
@@ -304,7 +1109,8 @@ ivas_sync_data (IVASKernel * handle, IVASSyncDataFlag flag, IVASFrame * frame)
       IVAS_SYNC_DATA_FROM_DEVICE;
 
   for (plane_id = 0; plane_id < frame->n_planes; plane_id++) {
-    LOG_MESSAGE (LOG_LEVEL_DEBUG, "plane %d syncing %s : bo = %d, size = %d",
+    LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+        "plane %d syncing %s : bo = %d, size = %d",
         plane_id,
         sync_flag == XCL_BO_SYNC_BO_TO_DEVICE ? "to device" : "from device",
         frame->bo[plane_id], frame->size[plane_id]);
@@ -313,7 +1119,8 @@ ivas_sync_data (IVASKernel * handle, IVASSyncDataFlag flag, IVASFrame * frame)
         xclSyncBO (handle->xcl_handle, frame->bo[plane_id], sync_flag,
         frame->size[plane_id], 0);
     if (iret != 0) {
-      LOG_MESSAGE (LOG_LEVEL_ERROR, "xclSyncBO failed %d, reason : %s", iret,
+      LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+          "xclSyncBO failed %d, reason : %s", iret,
           strerror (errno));
       return iret;
     }
@@ -481,7 +1288,7 @@ ivas_caps_new (uint8_t range_height, uint32_t lower_height,
   kernelcaps *kcaps;
 
   if (lower_height == 0 && lower_width == 0) {
-    LOG_MESSAGE (LOG_LEVEL_ERROR,
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
         "Wrong parameter lower_width = %d, lower_width = %d\n", lower_height,
         lower_width);
     return NULL;
@@ -491,11 +1298,12 @@ ivas_caps_new (uint8_t range_height, uint32_t lower_height,
       (range_width == true && (upper_width == 0 || lower_width == 0)) &&
       (lower_height == 0 && lower_width == 0)) {
 
-    LOG_MESSAGE (LOG_LEVEL_ERROR, "ivas_caps_new: Wrong parameters:");
-    LOG_MESSAGE (LOG_LEVEL_ERROR,
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+        "ivas_caps_new: Wrong parameters:");
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
         "range_height = %d, lower_height = %d upper_height = %d, ",
         range_height, lower_height, upper_height);
-    LOG_MESSAGE (LOG_LEVEL_ERROR,
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
         "range_width = %d, lower_width = %d upper_width = %d, ", range_height,
         lower_height, upper_height);
     return NULL;
@@ -516,7 +1324,8 @@ ivas_caps_new (uint8_t range_height, uint32_t lower_height,
   va_end (valist);
 
   if (!num_fmt) {
-    LOG_MESSAGE (LOG_LEVEL_ERROR, "ivas_caps_new: No format provided\n");
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
+        "ivas_caps_new: No format provided\n");
     free (kcaps);
     return NULL;
   }
@@ -540,7 +1349,7 @@ ivas_caps_add (IVASKernel * handle, kernelcaps * kcaps, paddir dir,
   kernelpads **pads;
 
   if (sinkpad_num != 0) {
-    LOG_MESSAGE (LOG_LEVEL_ERROR,
+    LOG_MESSAGE (LOG_LEVEL_ERROR, log_level,
         "ivas_caps_add_to_sink: only one pad supported yet\n");
     return false;
   }
@@ -671,44 +1480,51 @@ ivas_caps_print (IVASKernel * handle)
     return;
 
   pads = handle->padinfo->sinkpads;
-  LOG_MESSAGE (LOG_LEVEL_DEBUG, "total sinkpad %d",
+  LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level, "total sinkpad %d",
       handle->padinfo->nu_sinkpad);
   if (pads) {
     for (i = 0; i < handle->padinfo->nu_sinkpad; i++) {
-      LOG_MESSAGE (LOG_LEVEL_DEBUG, "nu of caps for sinkpad[%d] = %d", i,
+      LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+          "nu of caps for sinkpad[%d] = %d", i,
           pads[i]->nu_caps);
-      LOG_MESSAGE (LOG_LEVEL_DEBUG, "value are");
-      LOG_MESSAGE (LOG_LEVEL_DEBUG,
+      LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level, "value are");
+      LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
           "range_height\tlower_height\tupper_height\trange_width\tlower_width\tupper_width\tfmt...");
       for (j = 0; j < pads[i]->nu_caps; j++) {
 
-        LOG_MESSAGE (LOG_LEVEL_DEBUG, "%d\t\t%d\t\t%d\t\t%d\t\t%d\t\t%d\t\t ",
+        LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+            "%d\t\t%d\t\t%d\t\t%d\t\t%d\t\t%d\t\t ",
             pads[i]->kcaps[j]->range_height, pads[i]->kcaps[j]->lower_height,
             pads[i]->kcaps[j]->upper_height, pads[i]->kcaps[j]->range_width,
             pads[i]->kcaps[j]->lower_width, pads[i]->kcaps[j]->upper_width);
         for (k = 0; k < pads[i]->kcaps[j]->num_fmt; k++)
-          LOG_MESSAGE (LOG_LEVEL_DEBUG, "%d ", pads[i]->kcaps[j]->fmt[k]);
+          LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+              "%d ", pads[i]->kcaps[j]->fmt[k]);
       }
     }
   }
 
   pads = handle->padinfo->srcpads;
-  LOG_MESSAGE (LOG_LEVEL_DEBUG, "total srcpad %d", handle->padinfo->nu_srcpad);
+  LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+      "total srcpad %d", handle->padinfo->nu_srcpad);
   if (pads) {
     for (i = 0; i < handle->padinfo->nu_srcpad; i++) {
-      LOG_MESSAGE (LOG_LEVEL_DEBUG, "nu of caps for srcpad[%d] = %d", i,
+      LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+          "nu of caps for srcpad[%d] = %d", i,
           pads[i]->nu_caps);
-      LOG_MESSAGE (LOG_LEVEL_DEBUG, "value are");
-      LOG_MESSAGE (LOG_LEVEL_DEBUG,
+      LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level, "value are");
+      LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
           "range_height\tlower_height\tupper_height\trange_width\tlower_width\tupper_width\tfmt...");
       for (j = 0; j < pads[i]->nu_caps; j++) {
 
-        LOG_MESSAGE (LOG_LEVEL_DEBUG, "%d\t\t%d\t\t%d\t\t%d\t\t%d\t\t%d\t\t ",
+        LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+            "%d\t\t%d\t\t%d\t\t%d\t\t%d\t\t%d\t\t ",
             pads[i]->kcaps[j]->range_height, pads[i]->kcaps[j]->lower_height,
             pads[i]->kcaps[j]->upper_height, pads[i]->kcaps[j]->range_width,
             pads[i]->kcaps[j]->lower_width, pads[i]->kcaps[j]->upper_width);
         for (k = 0; k < pads[i]->kcaps[j]->num_fmt; k++)
-          LOG_MESSAGE (LOG_LEVEL_DEBUG, "%d ", pads[i]->kcaps[j]->fmt[k]);
+          LOG_MESSAGE (LOG_LEVEL_DEBUG, log_level,
+              "%d ", pads[i]->kcaps[j]->fmt[k]);
       }
     }
   }
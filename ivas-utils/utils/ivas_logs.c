@@ -0,0 +1,300 @@
+/*
+ * Copyright 2020 Xilinx, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Shared logger for IVAS utils and kernel libraries. Messages are
+ * formatted on the calling thread into a per-thread ring of records and
+ * written out by a background flusher thread, so kernel libraries don't
+ * pay for stdout writes in their processing path.
+ */
+
+#include <ivas/ivaslogs.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#define LOG_RING_SIZE 64        /* records per thread, power of 2 */
+#define LOG_FLUSH_INTERVAL_MS 100
+#define LOG_FILE_SIZE 128
+#define LOG_FUNC_SIZE 64
+
+typedef struct _log_record LogRecord;
+typedef struct _log_ring LogRing;
+
+/* file and func are copied, callers may be in a kernel library that is
+ * unloaded before the flusher gets to the record */
+struct _log_record
+{
+  int level;
+  int line;
+  char file[LOG_FILE_SIZE];
+  char func[LOG_FUNC_SIZE];
+  char msg[IVAS_LOG_MSG_SIZE];
+};
+
+struct _log_ring
+{
+  LogRecord records[LOG_RING_SIZE];
+  unsigned int head;            /* only written by the owner thread */
+  unsigned int tail;            /* only written with log_lock held */
+  int dead;                     /* owner thread exited */
+  LogRing *next;
+};
+
+static const char *level_names[] = { "ERROR", "WARNING", "INFO", "DEBUG" };
+
+/* guards the ring list, the handler and every consumer of the rings */
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_key_t log_key;
+static sem_t log_wakeup;
+static LogRing *log_rings;
+static int log_sync;
+static IVASLogFunc log_func;
+static void *log_user_data;
+static __thread LogRing *log_ring;
+
+/* truncates to size, keeping the end of src with keep_tail as the end of
+ * a long path names the file */
+static void
+log_copy_str (char *dest, size_t size, const char *src, int keep_tail)
+{
+  size_t len;
+
+  if (!src)
+    src = "";
+
+  len = strlen (src);
+  if (len >= size) {
+    if (keep_tail)
+      src += len - (size - 1);
+    len = size - 1;
+  }
+
+  memcpy (dest, src, len);
+  dest[len] = '\0';
+}
+
+/* Called with log_lock held */
+static void
+log_emit (const LogRecord * rec)
+{
+  const char *name = "UNKNOWN";
+
+  if (rec->level >= LOG_LEVEL_ERROR && rec->level <= LOG_LEVEL_DEBUG)
+    name = level_names[rec->level];
+
+  if (log_func)
+    log_func (rec->level, rec->file, rec->func, rec->line, rec->msg,
+        log_user_data);
+  else
+    printf ("[%s %s:%d] %s: %s\n", rec->file, rec->func, rec->line, name,
+        rec->msg);
+}
+
+/* Called with log_lock held */
+static void
+log_drain_ring (LogRing * ring)
+{
+  unsigned int tail = ring->tail;
+  unsigned int head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+
+  while (tail != head) {
+    log_emit (&ring->records[tail & (LOG_RING_SIZE - 1)]);
+    tail++;
+  }
+  __atomic_store_n (&ring->tail, tail, __ATOMIC_RELEASE);
+}
+
+static void
+log_ring_release (void *data)
+{
+  LogRing *ring = (LogRing *) data;
+
+  /* freed by the next flush once its records are written out */
+  __atomic_store_n (&ring->dead, 1, __ATOMIC_RELEASE);
+  sem_post (&log_wakeup);
+}
+
+static void *
+log_flusher (void *data)
+{
+  struct timespec ts;
+
+  (void) data;
+  while (1) {
+    clock_gettime (CLOCK_REALTIME, &ts);
+    ts.tv_nsec += LOG_FLUSH_INTERVAL_MS * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+    if (sem_timedwait (&log_wakeup, &ts) < 0 && errno != ETIMEDOUT
+        && errno != EINTR)
+      break;
+    ivas_log_flush ();
+  }
+
+  return NULL;
+}
+
+static void
+log_init (void)
+{
+  const char *env = getenv ("IVAS_LOG_SYNC");
+  pthread_attr_t attr;
+  pthread_t thread;
+
+  log_sync = env && atoi (env);
+  if (log_sync)
+    return;
+
+  if (sem_init (&log_wakeup, 0, 0) < 0) {
+    log_sync = 1;
+    return;
+  }
+
+  if (pthread_key_create (&log_key, log_ring_release)) {
+    log_sync = 1;
+    return;
+  }
+
+  pthread_attr_init (&attr);
+  pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create (&thread, &attr, log_flusher, NULL))
+    log_sync = 1;
+  pthread_attr_destroy (&attr);
+
+  if (!log_sync)
+    atexit (ivas_log_flush);
+}
+
+static LogRing *
+log_get_ring (void)
+{
+  LogRing *ring = log_ring;
+
+  if (ring)
+    return ring;
+
+  ring = (LogRing *) calloc (1, sizeof (LogRing));
+  if (!ring)
+    return NULL;
+
+  pthread_setspecific (log_key, ring);
+
+  pthread_mutex_lock (&log_lock);
+  ring->next = log_rings;
+  log_rings = ring;
+  pthread_mutex_unlock (&log_lock);
+
+  log_ring = ring;
+  return ring;
+}
+
+void
+ivas_log_write (int level, const char *file, const char *func, int line,
+    const char *format, ...)
+{
+  LogRing *ring = NULL;
+  LogRecord *rec;
+  LogRecord local;
+  unsigned int head, tail;
+  va_list args;
+
+  pthread_once (&log_once, log_init);
+
+  if (!log_sync)
+    ring = log_get_ring ();
+
+  if (!ring) {
+    /* synchronous mode, or no memory for a ring */
+    local.level = level;
+    local.line = line;
+    log_copy_str (local.file, sizeof (local.file), file, 1);
+    log_copy_str (local.func, sizeof (local.func), func, 0);
+    va_start (args, format);
+    vsnprintf (local.msg, sizeof (local.msg), format, args);
+    va_end (args);
+
+    pthread_mutex_lock (&log_lock);
+    log_emit (&local);
+    pthread_mutex_unlock (&log_lock);
+    fflush (stdout);
+    return;
+  }
+
+  head = ring->head;
+  tail = __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE);
+  if (head - tail >= LOG_RING_SIZE) {
+    /* flusher fell behind, drain our own ring instead of dropping */
+    pthread_mutex_lock (&log_lock);
+    log_drain_ring (ring);
+    pthread_mutex_unlock (&log_lock);
+    tail = head;
+  }
+
+  rec = &ring->records[head & (LOG_RING_SIZE - 1)];
+  rec->level = level;
+  rec->line = line;
+  log_copy_str (rec->file, sizeof (rec->file), file, 1);
+  log_copy_str (rec->func, sizeof (rec->func), func, 0);
+  va_start (args, format);
+  vsnprintf (rec->msg, sizeof (rec->msg), format, args);
+  va_end (args);
+
+  __atomic_store_n (&ring->head, head + 1, __ATOMIC_RELEASE);
+
+  /* errors and a filling ring are worth waking the flusher for, the rest
+   * waits for the next flush interval */
+  if (level == LOG_LEVEL_ERROR || head + 1 - tail >= LOG_RING_SIZE / 2)
+    sem_post (&log_wakeup);
+}
+
+void
+ivas_log_flush (void)
+{
+  LogRing **prev;
+  LogRing *ring;
+
+  pthread_mutex_lock (&log_lock);
+  prev = &log_rings;
+  while ((ring = *prev) != NULL) {
+    log_drain_ring (ring);
+    if (__atomic_load_n (&ring->dead, __ATOMIC_ACQUIRE)) {
+      *prev = ring->next;
+      free (ring);
+      continue;
+    }
+    prev = &ring->next;
+  }
+  pthread_mutex_unlock (&log_lock);
+
+  fflush (stdout);
+}
+
+void
+ivas_log_set_handler (IVASLogFunc func, void *user_data)
+{
+  pthread_mutex_lock (&log_lock);
+  log_func = func;
+  log_user_data = user_data;
+  pthread_mutex_unlock (&log_lock);
+}
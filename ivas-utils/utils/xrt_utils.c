@@ -16,6 +16,8 @@
 
 /* Update of this file by the user is not encouraged */
 #include <assert.h>
+#include <fnmatch.h>
+#include <pthread.h>
 #include "xrt_utils.h"
 
 #define ERROR_PRINT(...) {\
@@ -121,20 +123,256 @@ get_axlf_section2 (const struct axlf *top, enum axlf_section_kind kind)
   return NULL;
 }
 
+/* xclbin files are mapped once per process and kept mapped, the parsed
+ * header and looked up sections are cached along with the mapping */
+#define MAX_CACHED_SECTION_KIND 64
+
+typedef struct _xclbin_cache XclbinCache;
+struct _xclbin_cache
+{
+  char *path;
+  dev_t file_dev;
+  ino_t file_ino;
+  off_t file_size;
+  time_t file_mtime;
+  char *data;
+  const struct axlf *top;
+  const struct axlf_section_header *sections[MAX_CACHED_SECTION_KIND];
+  bool section_valid[MAX_CACHED_SECTION_KIND];
+  XclbinCache *next;
+};
+
+typedef struct
+{
+  xclDeviceHandle handle;
+  unsigned int ref_count;
+} SharedDevice;
+
+static pthread_mutex_t xrt_utils_lock = PTHREAD_MUTEX_INITIALIZER;
+static XclbinCache *xclbin_caches = NULL;
+static SharedDevice shared_devices[MAX_DEVICES];
+
+/* must be called with xrt_utils_lock held */
+static const struct axlf_section_header *
+xclbin_cache_get_section (XclbinCache * cache, enum axlf_section_kind kind)
+{
+  if (kind >= MAX_CACHED_SECTION_KIND)
+    return get_axlf_section2 (cache->top, kind);
+
+  if (!cache->section_valid[kind]) {
+    cache->sections[kind] = get_axlf_section2 (cache->top, kind);
+    cache->section_valid[kind] = true;
+  }
+  return cache->sections[kind];
+}
+
+/* must be called with xrt_utils_lock held */
+static XclbinCache *
+xclbin_cache_get (const char *bit)
+{
+  XclbinCache **link;
+  XclbinCache *cache = NULL;
+  struct stat st;
+  int fd;
+
+  fd = open (bit, O_RDONLY);
+  if (fd < 0) {
+    ERROR_PRINT ("open() with %s failed due to %s", bit, strerror (errno));
+    return NULL;
+  }
+
+  if (fstat (fd, &st)) {
+    ERROR_PRINT ("fstat() failed with %s", strerror (errno));
+    goto error;
+  }
+
+  for (link = &xclbin_caches; *link; link = &(*link)->next) {
+    if (strcmp ((*link)->path, bit))
+      continue;
+
+    cache = *link;
+    if (cache->file_dev == st.st_dev && cache->file_ino == st.st_ino
+        && cache->file_size == st.st_size
+        && cache->file_mtime == st.st_mtime) {
+      DEBUG_PRINT ("using cached xclbin %s", bit);
+      close (fd);
+      return cache;
+    }
+
+    /* file got replaced, drop stale mapping */
+    DEBUG_PRINT ("xclbin %s changed on disk, mapping again", bit);
+    *link = cache->next;
+    munmap (cache->data, cache->file_size);
+    free (cache->path);
+    free (cache);
+    cache = NULL;
+    break;
+  }
+
+  if ((size_t) st.st_size < sizeof (struct axlf)) {
+    ERROR_PRINT ("xclbin %s is too small", bit);
+    goto error;
+  }
+
+  cache = (XclbinCache *) calloc (1, sizeof (XclbinCache));
+  if (cache == NULL) {
+    ERROR_PRINT ("failed to allocate memory");
+    goto error;
+  }
+
+  cache->data = (char *) mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd,
+      0);
+  if (cache->data == MAP_FAILED) {
+    ERROR_PRINT ("mmap() failed with %s", strerror (errno));
+    cache->data = NULL;
+    goto error;
+  }
+
+  if (strncmp (cache->data, "xclbin2", 8)) {
+    ERROR_PRINT ("Invalid bitstream xclbin2 tag not present");
+    goto error;
+  }
+
+  cache->path = strdup (bit);
+  if (cache->path == NULL) {
+    ERROR_PRINT ("failed to allocate memory");
+    goto error;
+  }
+
+  cache->file_dev = st.st_dev;
+  cache->file_ino = st.st_ino;
+  cache->file_size = st.st_size;
+  cache->file_mtime = st.st_mtime;
+  cache->top = (const struct axlf *) cache->data;
+  cache->next = xclbin_caches;
+  xclbin_caches = cache;
+
+  close (fd);
+  return cache;
+
+error:
+  if (cache) {
+    if (cache->data)
+      munmap (cache->data, st.st_size);
+    free (cache);
+  }
+  close (fd);
+  return NULL;
+}
+
 int
-download_xclbin (const char *bit, unsigned deviceIndex, const char *halLog,
-    xclDeviceHandle * handle, uuid_t * xclbinId)
+load_xclbin (xclDeviceHandle handle, unsigned deviceIndex, const char *bit,
+    uuid_t * xclbinId)
 {
-  struct xclDeviceInfo2 deviceInfo;
-  FILE *fptr = NULL;
-  size_t size = 0;
-  char *header = NULL;
-  const xclBin *blob = NULL;
-  const struct axlf *top = NULL;
+  XclbinCache *cache = NULL;
   const struct axlf_section_header *ip = NULL;
   struct ip_layout *layout = NULL;
   int i;
 
+  if (handle == NULL || bit == NULL || !strlen (bit)
+      || deviceIndex >= MAX_DEVICES) {
+    ERROR_PRINT ("invalid arguments");
+    return -1;
+  }
+
+  pthread_mutex_lock (&xrt_utils_lock);
+
+  cache = xclbin_cache_get (bit);
+  if (cache == NULL)
+    goto error;
+
+  /* what is on the device can change behind this process (other processes,
+   * xbutil), so always let XRT decide. It skips the download itself when the
+   * device already holds this xclbin */
+  if (xclLoadXclBin (handle, (const xclBin *) cache->data)) {
+    ERROR_PRINT ("Bitstream download failed");
+    goto error;
+  }
+  DEBUG_PRINT ("Finished downloading bitstream %s on device %u", bit,
+      deviceIndex);
+
+  ip = xclbin_cache_get_section (cache, IP_LAYOUT);
+  if (ip) {
+    layout = (struct ip_layout *) (cache->data + ip->m_sectionOffset);
+    for (i = 0; i < layout->m_count; ++i) {
+      if (layout->m_ip_data[i].m_type != IP_KERNEL)
+        continue;
+      DEBUG_PRINT ("index = %d, kernel name = %s, base_addr = %lx", i,
+          layout->m_ip_data[i].m_name, layout->m_ip_data[i].m_base_address);
+    }
+  }
+
+  uuid_copy (*xclbinId, cache->top->m_header.uuid);
+  pthread_mutex_unlock (&xrt_utils_lock);
+  return 0;
+
+error:
+  pthread_mutex_unlock (&xrt_utils_lock);
+  return -1;
+}
+
+int
+find_xclbin_kernels (const uuid_t xclbinId, const char *pattern, char **names,
+    int max_names)
+{
+  XclbinCache *cache = NULL;
+  const struct axlf_section_header *ip = NULL;
+  struct ip_layout *layout = NULL;
+  int i, count = 0;
+
+  if (pattern == NULL || names == NULL || max_names <= 0) {
+    ERROR_PRINT ("invalid arguments");
+    return -1;
+  }
+
+  pthread_mutex_lock (&xrt_utils_lock);
+
+  for (cache = xclbin_caches; cache; cache = cache->next) {
+    if (!uuid_compare (cache->top->m_header.uuid, xclbinId))
+      break;
+  }
+
+  if (cache == NULL) {
+    ERROR_PRINT ("xclbin is not loaded through load_xclbin");
+    goto error;
+  }
+
+  ip = xclbin_cache_get_section (cache, IP_LAYOUT);
+  if (ip == NULL)
+    goto error;
+
+  layout = (struct ip_layout *) (cache->data + ip->m_sectionOffset);
+  for (i = 0; i < layout->m_count && count < max_names; ++i) {
+    const char *name = (const char *) layout->m_ip_data[i].m_name;
+
+    if (layout->m_ip_data[i].m_type != IP_KERNEL || fnmatch (pattern, name, 0))
+      continue;
+
+    names[count] = strdup (name);
+    if (names[count] == NULL) {
+      ERROR_PRINT ("failed to allocate memory");
+      goto error;
+    }
+    DEBUG_PRINT ("kernel %s matches %s", name, pattern);
+    count++;
+  }
+
+  pthread_mutex_unlock (&xrt_utils_lock);
+  return count;
+
+error:
+  pthread_mutex_unlock (&xrt_utils_lock);
+  while (count > 0)
+    free (names[--count]);
+  return -1;
+}
+
+int
+download_xclbin (const char *bit, unsigned deviceIndex, const char *halLog,
+    xclDeviceHandle * handle, uuid_t * xclbinId)
+{
+  struct xclDeviceInfo2 deviceInfo;
+
   if (deviceIndex >= xclProbe ()) {
     ERROR_PRINT ("Device index not found");
     return -1;
@@ -164,75 +402,68 @@ download_xclbin (const char *bit, unsigned deviceIndex, const char *halLog,
   if (!bit || !strlen (bit))
     return 0;
 
-  fptr = fopen (bit, "rb");
-  if (!fptr) {
-    ERROR_PRINT ("fopen() with %s failed due to %s", bit, strerror (errno));
+  if (load_xclbin (*handle, deviceIndex, bit, xclbinId))
     goto error;
-  }
 
-  if (fseek (fptr, 0, SEEK_END) != 0) {
-    ERROR_PRINT ("fseek() failed to SEEK_END with %s", strerror (errno));
-    goto error;
-  }
+  return 0;
 
-  size = ftell (fptr);
-  if (size == (size_t) (-1)) {
-    ERROR_PRINT ("ftell failed with %s", strerror (errno));
-    goto error;
-  }
+error:
+  xclClose (*handle);
+  *handle = NULL;
+  return -1;
+}
 
-  if (fseek (fptr, 0, SEEK_SET) != 0) {
-    ERROR_PRINT ("fseek() failed to SEEK_SET with %s", strerror (errno));
-    goto error;
-  }
+xclDeviceHandle
+open_shared_xrt_device (unsigned deviceIndex)
+{
+  SharedDevice *dev = NULL;
+  xclDeviceHandle handle = NULL;
 
-  header = (char *) calloc (1, size);
-  if (header == NULL) {
-    ERROR_PRINT ("failed to allocate memory");
-    return -1;
+  if (deviceIndex >= MAX_DEVICES || deviceIndex >= xclProbe ()) {
+    ERROR_PRINT ("Device index %u not found", deviceIndex);
+    return NULL;
   }
 
-  if (fread (header, sizeof (char), size, fptr) != size) {
-    ERROR_PRINT ("fread failed with %s", strerror (errno));
-    goto error;
+  pthread_mutex_lock (&xrt_utils_lock);
+  dev = &shared_devices[deviceIndex];
+  if (!dev->handle) {
+    dev->handle = xclOpen (deviceIndex, NULL, XCL_INFO);
+    if (!dev->handle) {
+      ERROR_PRINT ("failed to open device index %u", deviceIndex);
+      goto exit;
+    }
   }
+  dev->ref_count++;
+  handle = dev->handle;
 
-  if (strncmp (header, "xclbin2", 8)) {
-    ERROR_PRINT ("Invalid bitstream xclbin2 tag not present");
-    goto error;
-  }
+exit:
+  pthread_mutex_unlock (&xrt_utils_lock);
+  return handle;
+}
 
-  blob = (const xclBin *) header;
-  if (xclLoadXclBin (*handle, blob)) {
-    ERROR_PRINT ("Bitstream download failed");
-    goto error;
-  }
-  DEBUG_PRINT ("Finished downloading bitstream %s ", bit);
+void
+close_shared_xrt_device (xclDeviceHandle handle)
+{
+  int i;
 
-  top = (const struct axlf *) header;
-  ip = get_axlf_section2 (top, IP_LAYOUT);
-  layout = (struct ip_layout *) (header + ip->m_sectionOffset);
+  if (handle == NULL)
+    return;
 
-  for (i = 0; i < layout->m_count; ++i) {
-    if (layout->m_ip_data[i].m_type != IP_KERNEL)
+  pthread_mutex_lock (&xrt_utils_lock);
+  for (i = 0; i < MAX_DEVICES; i++) {
+    if (shared_devices[i].handle != handle)
       continue;
-    DEBUG_PRINT ("index = %d, kernel name = %s, base_addr = %lx", i,
-        layout->m_ip_data[i].m_name, layout->m_ip_data[i].m_base_address);
-  }
 
-  uuid_copy (*xclbinId, top->m_header.uuid);
-  free (header);
-  fclose (fptr);
-  return 0;
+    if (--shared_devices[i].ref_count == 0) {
+      xclClose (handle);
+      shared_devices[i].handle = NULL;
+    }
+    break;
+  }
+  pthread_mutex_unlock (&xrt_utils_lock);
 
-error:
-  if (header)
-    free (header);
-  if (fptr)
-    fclose (fptr);
-  xclClose (*handle);
-  *handle = NULL;
-  return -1;
+  if (i == MAX_DEVICES)
+    ERROR_PRINT ("handle %p is not a shared device handle", handle);
 }
 
 int
@@ -47,5 +47,15 @@
 int alloc_xrt_buffer (xclDeviceHandle handle, unsigned int size, enum xclBOKind bo_kind, unsigned flags, xrt_buffer *buffer);
 void free_xrt_buffer (xclDeviceHandle handle, xrt_buffer *buffer);
 int download_xclbin ( const char *bit, unsigned deviceIndex, const char* halLog, xclDeviceHandle *handle, uuid_t *xclbinId);
+int load_xclbin (xclDeviceHandle handle, unsigned deviceIndex, const char *bit, uuid_t *xclbinId);
+/* names of the kernel CUs of an xclbin loaded by load_xclbin matching the
+ * fnmatch pattern, in IP layout order. names are strdup'ed and must be
+ * freed by caller. Returns number of names or -1 */
+int find_xclbin_kernels (const uuid_t xclbinId, const char *pattern, char **names, int max_names);
+/* one handle per device shared within the process. Teardown that releases
+ * everything on a handle must not be run on it, elements doing such
+ * teardown open their own handle */
+xclDeviceHandle open_shared_xrt_device (unsigned deviceIndex);
+void close_shared_xrt_device (xclDeviceHandle handle);
 int send_softkernel_command (xclDeviceHandle handle, xrt_buffer *sk_buf, unsigned int *payload, unsigned int num_idx, unsigned int cu_mask, int timeout);
 #endif